@@ -0,0 +1,68 @@
+/*
+ *  coherence.c
+ *  MSI snooping bus between the per-core L1 data caches
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "coherence.h"
+
+void bus_init(struct Bus* b, int latency){
+  memset(b,0,sizeof(*b));
+  b->latency = latency;
+}
+
+int bus_attach(struct Bus* b, struct Cache* l1){   //  CORE NUMBER ON THE BUS, -1 WHEN FULL
+  if(b->cores == MAX_CORES)
+    return -1;
+  b->l1[b->cores] = l1;
+  return b->cores++;
+}
+
+/*
+ * Core accesses byte address at cycle now through its L1D. Hits in a state
+ * that allows the access go straight to the cache, anything else first wins
+ * the bus and snoops the other caches. Returns like cache_access.
+ */
+long bus_access(struct Bus* b, int core, int address, bool write, unsigned long now){
+  struct Cache* own = b->l1[core];
+  bool dirty = false;
+  bool present = cache_probe(own,address,&dirty);
+  if(present && (!write || dirty))
+    return cache_access(own,address,write,now);
+
+  unsigned long start = now > b->free ? now : b->free;
+  b->wait += start - now;
+  b->free = start + b->latency;
+  if(!write)
+    b->reads[core]++;
+  else if(present)
+    b->upgrades[core]++;
+  else
+    b->read_excl[core]++;
+
+  for(int o=0;o<b->cores;o++){
+    bool other_dirty;
+    if(o == core || !cache_probe(b->l1[o],address,&other_dirty))
+      continue;
+    if(write){
+      cache_snoop(b->l1[o],address,true,start);
+      b->invalidated[o]++;
+    }
+    else if(other_dirty)
+      cache_snoop(b->l1[o],address,false,start);
+    if(other_dirty)
+      b->flushes[o]++;
+  }
+  return cache_access(own,address,write,start + b->latency);
+}
+
+void bus_print_stats(struct Bus* b, int core){
+  printf("=======COHERENCE (CORE %d)========\n",core);
+  printf(" | BusRd       | %lu |\n",b->reads[core]);
+  printf(" | BusRdX      | %lu |\n",b->read_excl[core]);
+  printf(" | BusUpgr     | %lu |\n",b->upgrades[core]);
+  printf(" | Invalidated | %lu |\n",b->invalidated[core]);
+  printf(" | Flushes     | %lu |\n",b->flushes[core]);
+}
@@ -0,0 +1,39 @@
+#ifndef _APEX_COHERENCE_H_
+#define _APEX_COHERENCE_H_
+/**
+ *  coherence.h
+ *  MSI snooping bus keeping the private L1 data caches coherent
+ *
+ *  Every core's L1D is attached to one bus. A read that misses broadcasts
+ *  BusRd, a Modified copy elsewhere is flushed and drops to Shared. A write
+ *  to a line that is not Modified broadcasts BusRdX (miss) or BusUpgr
+ *  (Shared hit) and every other copy is invalidated. Transactions are
+ *  serialised, each holds the bus for a fixed number of cycles.
+ */
+#include <stdbool.h>
+
+#include "cache.h"
+
+#define MAX_CORES 8
+
+struct Bus{
+  struct Cache* l1[MAX_CORES];
+  int cores;
+  int latency;                  // Cycles one transaction holds the bus
+  unsigned long free;           // Cycle the bus takes the next transaction
+  unsigned long wait;           // Cycles requests spent waiting for the bus
+  /* Per core, counted on the requesting side */
+  unsigned long reads[MAX_CORES];
+  unsigned long read_excl[MAX_CORES];
+  unsigned long upgrades[MAX_CORES];
+  /* Per core, counted on the snooping side */
+  unsigned long invalidated[MAX_CORES];  // Lines lost to another core's write
+  unsigned long flushes[MAX_CORES];      // Modified lines supplied to another core
+};
+
+void bus_init(struct Bus*, int);
+int bus_attach(struct Bus*, struct Cache*);
+long bus_access(struct Bus*, int, int, bool, unsigned long);
+void bus_print_stats(struct Bus*, int);
+
+#endif
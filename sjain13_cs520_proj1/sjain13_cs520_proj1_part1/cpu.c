@@ -11,12 +11,27 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "multicore.h"
 
 /* Set this flag to 1 to enable debug messages */
 #define ENABLE_DEBUG_MESSAGES 1
-int mul_count = 0;
-int halt=0;
-int hck = 0;
+
+/* Per-stage trace, off when the cores run on host threads since their lines would interleave */
+#define TRACE(cpu) (ENABLE_DEBUG_MESSAGES && !(cpu)->quantum)
+
+/* Set this flag to 1 to model the L1 data cache, memory is otherwise always a hit */
+#define ENABLE_L1D_CACHE 0
+#define L1D_SETS 64
+#define L1D_WAYS 4
+#define L1D_LINE_SIZE 16		// Bytes, four words
+#define L1D_REPLACEMENT CACHE_LRU
+#define L1D_HIT_LATENCY 1		// Cycles, 1 fits in the MEM stage
+#define L1D_MISS_LATENCY 10
+#define L1D_MSHRS 4
+
+/* Extra cycles MEM is held by a FADD/SWAP read-modify-write and by a FENCE */
+#define ATOMIC_LATENCY 2
+#define FENCE_LATENCY 1
 
 /*
  * This function creates and initializes APEX cpu.
@@ -32,7 +47,7 @@ APEX_cpu_init(const char* filename)
     		return NULL;
   	}
 
-	APEX_CPU* cpu = malloc(sizeof(*cpu));
+	APEX_CPU* cpu = calloc(1, sizeof(*cpu));
   	if (!cpu)
 	{
     		return NULL;
@@ -43,7 +58,9 @@ APEX_cpu_init(const char* filename)
   	memset(cpu->regs, 0, sizeof(int) * 32);
   	memset(cpu->regs_valid, 1, sizeof(int) * 32);
 	memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-  	memset(cpu->data_memory, 0, sizeof(int) * 4000);
+  	dm_init(&cpu->private_memory);
+	cpu->data_memory = &cpu->private_memory;
+	cpu->id = -1;
 
   	/* Parse input file and create code memory */
   	cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
@@ -54,6 +71,18 @@ APEX_cpu_init(const char* filename)
     		return NULL;
   	}
 
+	if (ENABLE_L1D_CACHE)
+	{
+		struct CacheConfig cfg = { "L1D", L1D_SETS, L1D_WAYS, L1D_LINE_SIZE, L1D_REPLACEMENT,
+					   L1D_HIT_LATENCY, L1D_MISS_LATENCY, L1D_MSHRS };
+		if (!cache_init(&cpu->l1d, &cfg))
+		{
+			free(cpu->code_memory);
+			free(cpu);
+			return NULL;
+		}
+	}
+
   	if (ENABLE_DEBUG_MESSAGES)
 	{
     		fprintf(stderr,"APEX_CPU : Initialized APEX CPU, loaded %d instructions\n",cpu->code_memory_size);
@@ -88,6 +117,9 @@ APEX_cpu_init(const char* filename)
 void
 APEX_cpu_stop(APEX_CPU* cpu)
 {
+	if (ENABLE_L1D_CACHE)
+		cache_free(&cpu->l1d);
+	dm_free(&cpu->private_memory);
   	free(cpu->code_memory);
   	free(cpu);
 }
@@ -159,6 +191,14 @@ print_instruction(CPU_Stage* stage)
 	{
     		printf("%s,R%d,#%d", stage->opcode,stage->rs1,stage->imm);
   	}
+	if (strcmp(stage->opcode, "FADD") == 0 || strcmp(stage->opcode, "SWAP") == 0)
+	{
+   		printf("%s,R%d,R%d,R%d",stage->opcode,stage->rd,stage->rs1,stage->rs2);
+  	}
+	if (strcmp(stage->opcode, "FENCE") == 0)
+	{
+		printf("FENCE");
+	}
 }
 
 /* Debug function which dumps the cpu stage
@@ -203,7 +243,7 @@ fetch(APEX_CPU* cpu)
         stage->rs2 = current_ins->rs2;
         stage->imm = current_ins->imm;
     }*/
-  	if (!stage->busy && !stage->stalled && halt!=1)
+  	if (!stage->busy && !stage->stalled && cpu->halt!=1)
 	{
     		/* Store current PC in fetch latch */
     		stage->pc = cpu->pc;
@@ -217,7 +257,7 @@ fetch(APEX_CPU* cpu)
             if(cpu->stage[DRF].stalled==1)
             {
                 //printf("\nDecode is stalled\n");
-    			if (ENABLE_DEBUG_MESSAGES)
+    			if (TRACE(cpu))
                 {
      				print_stage_content("Fetch", stage);
                 }
@@ -230,18 +270,132 @@ fetch(APEX_CPU* cpu)
 
 		/* Copy data from fetch latch to decode latch*/
     		cpu->stage[DRF] = cpu->stage[F];
-            if (ENABLE_DEBUG_MESSAGES)
+            if (TRACE(cpu))
             {
                 print_stage_content("Fetch", stage);
             }
   	} else {
-		if(ENABLE_DEBUG_MESSAGES) {
+		if (TRACE(cpu)) {
 			print_stage_content("Fetch", stage);
 		}
 	}
 	return 0;
 }
 
+static int
+is_atomic(const char* opcode)
+{
+	return strcmp(opcode, "FADD") == 0 || strcmp(opcode, "SWAP") == 0;
+}
+
+static int
+writes_rd(const char* opcode)
+{
+	return strcmp(opcode, "MOVC") == 0 || strcmp(opcode, "ADD") == 0 || strcmp(opcode, "SUB") == 0 ||
+	       strcmp(opcode, "MUL") == 0 || strcmp(opcode, "AND") == 0 || strcmp(opcode, "OR") == 0 ||
+	       strcmp(opcode, "XOR") == 0 || strcmp(opcode, "LOAD") == 0 || is_atomic(opcode);
+}
+
+static int
+sets_zflag(const char* opcode)
+{
+	return strcmp(opcode, "ADD") == 0 || strcmp(opcode, "SUB") == 0 || strcmp(opcode, "MUL") == 0;
+}
+
+static int
+reads_rs1(const char* opcode)
+{
+	return (writes_rd(opcode) && strcmp(opcode, "MOVC") != 0) || strcmp(opcode, "STORE") == 0 ||
+	       strcmp(opcode, "JUMP") == 0;
+}
+
+static int
+reads_rs2(const char* opcode)
+{
+	return reads_rs1(opcode) && strcmp(opcode, "LOAD") != 0 && strcmp(opcode, "JUMP") != 0;
+}
+
+/* Registers the instruction reads, as scoreboard bits */
+static unsigned int
+source_mask(CPU_Stage* stage)
+{
+	unsigned int mask = 0;
+	if (reads_rs1(stage->opcode))
+	{
+		mask |= 1u << stage->rs1;
+	}
+	if (reads_rs2(stage->opcode))
+	{
+		mask |= 1u << stage->rs2;
+	}
+	return mask;
+}
+
+/* Called when an issued instruction writes back or is squashed */
+static void
+scoreboard_release(APEX_CPU* cpu, CPU_Stage* stage)
+{
+	if (writes_rd(stage->opcode) && cpu->producer[stage->rd] == stage->pc)
+	{
+		cpu->pending_writes &= ~(1u << stage->rd);
+	}
+	if (sets_zflag(stage->opcode) && cpu->zflag_producer == stage->pc)
+	{
+		cpu->zflag_producer = 0;
+	}
+}
+
+/* A taken branch in MEM is older than everything in the MUL pipeline */
+static void
+squash_mul_pipe(APEX_CPU* cpu)
+{
+	for (int i = 0; i < MUL_LATENCY; i++)
+	{
+		if (strcmp(cpu->mul_pipe[i].opcode, "") != 0)
+		{
+			scoreboard_release(cpu, &cpu->mul_pipe[i]);
+			strcpy(cpu->mul_pipe[i].opcode, "");
+		}
+	}
+}
+
+/*
+ * Writeback arbiter: EX and the last MUL stage share the path into MEM, the
+ * older of the two goes so instructions still complete in program order.
+ * Then the MUL pipeline moves up into free slots. Returns 1 when the MUL
+ * took MEM and EX has to hold this cycle.
+ */
+static int
+mul_pipe_step(APEX_CPU* cpu)
+{
+	CPU_Stage* ex = &cpu->stage[EX];
+	CPU_Stage* last = &cpu->mul_pipe[MUL_LATENCY - 1];
+	int ex_valid = !ex->busy && !ex->stalled && strcmp(ex->opcode, "") != 0;
+	int retired = 0;
+
+	if (strcmp(last->opcode, "") != 0 && (!ex_valid || last->seq < ex->seq))
+	{
+		last->buffer = (last->rs1_value) * (last->rs2_value);
+		cpu->stage[MEM] = *last;
+		strcpy(last->opcode, "");
+		retired = 1;
+		if (TRACE(cpu))
+		{
+			print_stage_content("Mul", &cpu->stage[MEM]);
+		}
+	}
+	for (int i = MUL_LATENCY - 1; i > 0; i--)
+	{
+		if (strcmp(cpu->mul_pipe[i].opcode, "") == 0 && strcmp(cpu->mul_pipe[i - 1].opcode, "") != 0)
+		{
+			cpu->mul_pipe[i] = cpu->mul_pipe[i - 1];
+			strcpy(cpu->mul_pipe[i - 1].opcode, "");
+		}
+	}
+	cpu->ex_hold = retired && ex_valid;
+	return retired;
+}
+
 /*
  *  Decode Stage of APEX Pipeline
  *
@@ -252,230 +406,54 @@ int
 decode(APEX_CPU* cpu)
 {
   	CPU_Stage* stage = &cpu->stage[DRF];
-	//printf("\nDecode opcode: %s\n",stage->opcode);
-	/*if((cpu->regs_valid[stage->rs1]==1) || (cpu->regs_valid[stage->rs2]==1))
-	{
-		stage->stalled=1;
-	}
-	else
-	stage->stalled=0;*/
-	
-		if(cpu->stage[EX].busy==1 && strcmp(cpu->stage[EX].opcode, "MUL") == 0)
+	if(cpu->ex_hold)
 	{
   		stage->stalled=1;
-  		if (ENABLE_DEBUG_MESSAGES)
+  		if (TRACE(cpu))
 		{
   			print_stage_content("Decode", stage);
   		}
   		return 0;
   	}
-	if(mul_count == 0)
-		stage->stalled = 0;
-	/*if(cpu->regs_valid[stage->rd]==0)
-	{
-		cpu->stage[F].stalled=1;
-  		cpu->stage[DRF].stalled=1;
-	}
-	else
-	{
-		cpu->stage[F].stalled=0;
-  		cpu->stage[DRF].stalled=0;
-	}*/
 	if(stage->stalled==1)
 	{
      		stage->stalled=0;
    	}
   	if (!stage->busy && !stage->stalled)
 	{
+		int branch = strcmp(stage->opcode, "BZ") == 0 || strcmp(stage->opcode, "BNZ") == 0;
+		int mul = strcmp(stage->opcode, "MUL") == 0;
 
-        if(strcmp(stage->opcode, "BZ")==0 || strcmp(stage->opcode, "BNZ")==0)
-        {
-            if(strcmp(cpu->stage[MEM].opcode, "ADD")==0 || strcmp(cpu->stage[WB].opcode, "ADD")==0 || strcmp(stage[MEM].opcode, "SUB")==0 || strcmp(stage[WB].opcode,"SUB")==0 || strcmp(stage[MEM].opcode,"MUL")==0 || strcmp(stage[WB].opcode,"MUL")==0)
-            {
-                cpu->stage[DRF].stalled=1;
-                //cpu->stage[F].stalled=1;
-            } else {
-                cpu->stage[DRF].stalled=0;
-                cpu->stage[F].stalled=0;
-            }
-        }
-		/*if(strcmp(stage->opcode, "HALT")==0){halt=1;
-			strcpy(cpu->stage[F].opcode, "");
-		}*/
-		/* Read data from register file for store */
-        if (strcmp(stage->opcode, "STORE") == 0)
+		/* RAW on a source register, a BZ/BNZ whose flag is not written yet or M1 still full */
+		if ((cpu->pending_writes & source_mask(stage)) != 0 || (branch && cpu->zflag_producer != 0) ||
+		    (mul && strcmp(cpu->mul_pipe[0].opcode, "") != 0))
 		{
-            if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-			{
-                stage->stalled=1;
-            }
-      		else
-            {
-                stage->rs1_value=cpu->regs[stage->rs1];
-      			stage->rs2_value=cpu->regs[stage->rs2];
-      			stage->stalled=0;
-      			//stage->stage_stalled=0;
-      		}
-        }
-
-		/* Read data from register file for load */
-     		if (strcmp(stage->opcode, "LOAD") == 0)
-            {
-                
-     			if(cpu->regs_valid[stage->rs1] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->stalled=0;
-      				//stage->stage_stalled=0;
-				cpu->regs_valid[stage->rd] = 1;
-    			}
-            }
-
-   	 	/* No Register file read needed for MOVC*/
-    		if (strcmp(stage->opcode, "MOVC") == 0)
+			stage->stalled=1;
+		}
+		else
 		{
-			cpu->regs_valid[stage->rd]=1;
+			stage->rs1_value=cpu->regs[stage->rs1];
+			stage->rs2_value=cpu->regs[stage->rs2];
+			if (writes_rd(stage->opcode))
+			{
+				cpu->pending_writes |= 1u << stage->rd;
+				cpu->producer[stage->rd] = stage->pc;
+			}
+			if (sets_zflag(stage->opcode))
+			{
+				cpu->zflag_producer = stage->pc;
+			}
+			stage->seq = ++cpu->issue_count;
 		}
 
-  		/* Read data from register file for Add */
-    		if (strcmp(stage->opcode, "ADD") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] =1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-        /* Read data from register file for Sub */
-    		if (strcmp(stage->opcode, "SUB") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-            /* Read data from register file for Jump */
-            if (strcmp(stage->opcode, "JUMP") == 0)
-            {
-       			if(cpu->regs_valid[stage->rs1] == 1)
-                {
-                    stage->stalled=1;
-      			//stage->stage_stalled=1;
-                }
-                else
-                {
-                    stage->rs1_value= cpu->regs[stage->rs1];
-                    stage->stalled=0;
-		    //cpu->regs_valid[stage->rd] = 1;
-                    //stage->stage_stalled=0;
-                }
-            }
-
-    		/* Read data from register file for Xor */
-    		if (strcmp(stage->opcode, "XOR") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-                }
-            }
-
-            /* Read data from register file for OR */
-    		if (strcmp(stage->opcode, "OR") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-            /* Read data from register file for AND */
-    		if (strcmp(stage->opcode, "AND") == 0)
-            {
-                //printf("src1=%d:%d, src2:%d:%d\n",stage->rs1, cpu->regs_valid[stage->rs1], stage->rs2, cpu->regs_valid[stage->rs2]);
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-    		if (strcmp(stage->opcode, "MUL") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-    			if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-    			
-                    stage->stalled=1;
-    			}
-                else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-
-    		/* Copy data from decode latch to execute latch*/
+    		/* Copy data from decode latch to execute latch, a MUL goes to M1 and leaves a bubble */
     		cpu->stage[EX] = cpu->stage[DRF];
-            if (ENABLE_DEBUG_MESSAGES)
+		if (mul && !stage->stalled)
+		{
+			cpu->mul_pipe[0] = *stage;
+			cpu->stage[EX].busy = 1;
+		}
+            if (TRACE(cpu))
             {
       			print_stage_content("Decode/RF", stage);
     		}
@@ -484,7 +462,7 @@ decode(APEX_CPU* cpu)
 	else
     {
         cpu->stage[EX] = cpu->stage[DRF];
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
         {
             print_stage_contents("Decode");
         }
@@ -502,25 +480,34 @@ int
 execute(APEX_CPU* cpu)
 {
   	CPU_Stage* stage = &cpu->stage[EX];
-	if(stage->busy && mul_count==1)
-	stage->busy = 0;
+	if (mul_pipe_step(cpu))
+	{
+		if (TRACE(cpu))
+		{
+			if (cpu->ex_hold)
+				print_stage_content("Execute", stage);
+			else
+				print_stage_contents("Execute");
+		}
+		return 0;
+	}
 	if(strcmp(cpu->stage[EX].opcode, "HALT") == 0 || strcmp(cpu->stage[MEM].opcode, "HALT") ==0 || strcmp(cpu->stage[WB].opcode, "HALT") == 0)
 	{
 		//stage->stalled=1;
 		strcpy(cpu->stage[DRF].opcode,"");
 		strcpy(cpu->stage[F].opcode, "");
-		halt = 1;
+		cpu->halt = 1;
 		cpu->stage[MEM] = cpu->stage[EX];
-		if (ENABLE_DEBUG_MESSAGES)
+		if (TRACE(cpu))
 		{
   			print_stage_content("Decode", stage);
   		}
 		return 0;
 	}
-	else if(hck == 1)   //Halt Check
+	else if(cpu->hck == 1)   //Halt Check
 	{
 		cpu->stage[EX]=cpu->stage[DRF];
-		if (ENABLE_DEBUG_MESSAGES)
+		if (TRACE(cpu))
 		{
   			print_stage_content("Execute", stage);
   		}
@@ -538,10 +525,15 @@ execute(APEX_CPU* cpu)
         if (strcmp(stage->opcode, "LOAD") == 0)
 		{
             stage->mem_address=(stage->rs1_value)+(stage->imm);
-		cpu->regs_valid[stage->rd] = 1;//#new
 
         }
 
+        /* FADD/SWAP address the word in rs1 directly */
+        if (is_atomic(stage->opcode))
+		{
+            stage->mem_address=stage->rs1_value;
+        }
+
         /* MOVC */
         if (strcmp(stage->opcode, "MOVC") == 0)
 		{
@@ -551,7 +543,6 @@ execute(APEX_CPU* cpu)
 		/* JUMP */
 		if (strcmp(stage->opcode, "JUMP") == 0)
 		{
-            printf("cpu PC %d\n",cpu -> pc);
             cpu->pc =stage->rs1_value + stage->imm;
         }
 
@@ -559,61 +550,32 @@ execute(APEX_CPU* cpu)
         if (strcmp(stage->opcode, "ADD") == 0)
 		{
             stage->buffer=(stage->rs1_value)+(stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* SUB */
         if (strcmp(stage->opcode, "SUB") == 0)
 		{
             stage->buffer=(stage->rs1_value)-(stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* XOR */
         if (strcmp(stage->opcode, "XOR") == 0)
 		{
             stage->buffer=(stage->rs1_value)^(stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* OR */
         if (strcmp(stage->opcode, "OR") == 0)
 		{
             stage->buffer=(stage->rs1_value)|(stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* AND */
         if (strcmp(stage->opcode, "AND") == 0)
 		{
             stage->buffer=(stage->rs1_value) & (stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
-        /* MUL */
-        if (strcmp(stage->opcode, "MUL") == 0)
-		{
-            stage->buffer=(stage->rs1_value) * (stage->rs2_value);
-		cpu->regs_valid[stage->rd] = 1;//#new
-
-			if(mul_count == 0)
-			{
-                stage->busy=1;
-				mul_count++;
-			}
-			else
-			mul_count = 0;
-        }
         /*BZ*/
         if (strcmp(stage->opcode, "BZ") == 0)
 	{
@@ -648,7 +610,7 @@ execute(APEX_CPU* cpu)
 //        printf("\nreg_valid[%d]: %d\n",stage->rd, cpu->regs_valid[stage->rd]);
 		//cpu->stage[F].stalled=0;
         //cpu->stage[DRF].stalled=1;
-		if (ENABLE_DEBUG_MESSAGES)
+		if (TRACE(cpu))
 		{
             print_stage_content("Execute", stage);
         }
@@ -656,7 +618,7 @@ execute(APEX_CPU* cpu)
 	else
     {
         cpu->stage[MEM] = cpu->stage[EX];
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
         {
       		print_stage_contents("Execute");
         }
@@ -678,19 +640,33 @@ int memory(APEX_CPU* cpu)
         /* Store */
         if (strcmp(stage->opcode, "STORE") == 0)
 		{
-            cpu->data_memory[stage->mem_address]=stage->rs1_value;
+            dm_write(cpu->data_memory, stage->mem_address, stage->rs1_value);
         }
 
         /* Load */
         if (strcmp(stage->opcode, "LOAD") == 0)
 		{
-            stage->mem_address=cpu->data_memory[stage->mem_address];
-		cpu->regs_valid[stage->rd] = 1;//#new
+            stage->mem_address=dm_read(cpu->data_memory, stage->mem_address);
 
 
             //cpu->regs_valid[stage->rd]=0;
         }
 
+        /* Read-modify-write in one step, no other core accesses memory in between */
+        if (is_atomic(stage->opcode))
+		{
+            stage->buffer=dm_read(cpu->data_memory, stage->mem_address);
+            dm_write(cpu->data_memory, stage->mem_address,
+                     strcmp(stage->opcode, "FADD") == 0 ? stage->buffer + stage->rs2_value : stage->rs2_value);
+            cpu->atomics++;
+        }
+
+        /* Older STOREs are done once a FENCE reaches MEM and younger LOADs are behind it */
+        if (strcmp(stage->opcode, "FENCE") == 0)
+		{
+            cpu->fences++;
+        }
+
         /* MOVC */
         if (strcmp(stage->opcode, "MOVC") == 0)
 		{
@@ -699,41 +675,26 @@ int memory(APEX_CPU* cpu)
         /* ADD */
         if (strcmp(stage->opcode, "ADD") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* SUB */
         if (strcmp(stage->opcode, "SUB") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* XOR */
         if (strcmp(stage->opcode, "XOR") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* OR */
         if (strcmp(stage->opcode, "OR") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
         /* AND */
         if (strcmp(stage->opcode, "AND") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
         
         if(strcmp(stage->opcode,"BZ")==0 || strcmp(stage->opcode, "BNZ")==0) {
@@ -741,18 +702,19 @@ cpu->regs_valid[stage->rd] = 1;//#new
                 cpu->pc = stage->buffer;
                 strcpy(cpu->stage[DRF].opcode,"");
                 cpu->stage[DRF].pc=0;
+                if (!cpu->stage[EX].stalled)
+                {
+                    scoreboard_release(cpu, &cpu->stage[EX]);
+                }
                 strcpy(cpu->stage[EX].opcode,"");
                 cpu->stage[EX].pc=0;
-                cpu->regs_valid[cpu->stage[EX].rd] = 0;
+                squash_mul_pipe(cpu);
             }
         }
 
         /* MUL */
         if (strcmp(stage->opcode, "MUL") == 0)
 		{
-cpu->regs_valid[stage->rd] = 1;//#new
-
-
         }
 
 		/* HALT */
@@ -763,7 +725,7 @@ cpu->regs_valid[stage->rd] = 1;//#new
 
         /* Copy data from decode latch to execute latch*/
         cpu->stage[WB] = cpu->stage[MEM];
-		if (ENABLE_DEBUG_MESSAGES)
+		if (TRACE(cpu))
 		{
             print_stage_content("Memory", stage);
         }
@@ -773,7 +735,7 @@ cpu->regs_valid[stage->rd] = 1;//#new
 		strcpy(stage->opcode,"");
 		stage->pc = 1111;
   		cpu->stage[WB] = cpu->stage[MEM];
-  		if (ENABLE_DEBUG_MESSAGES)
+  		if (TRACE(cpu))
 		{
   			print_stage_content("Memory", stage);
   		}
@@ -783,7 +745,7 @@ cpu->regs_valid[stage->rd] = 1;//#new
     {
         cpu->stage[WB] = cpu->stage[MEM];
         //printf("\nMemory\n" );
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
         {
             //print_stage_content("Memory", stage);
             print_stage_contents("Memory");
@@ -846,6 +808,13 @@ int writeback(APEX_CPU* cpu)
             }
         }
 
+        //FADD, SWAP
+        if (is_atomic(stage->opcode))
+		{
+            cpu->regs[stage->rd] = stage->buffer;
+			cpu->regs_valid[stage->rd]=0;
+        }
+
         //XOR
         if (strcmp(stage->opcode, "XOR") == 0)
 		{
@@ -885,10 +854,12 @@ int writeback(APEX_CPU* cpu)
         //HALT
 		if (strcmp(stage->opcode, "HALT") == 0)
 		{
-			hck=1;
+			cpu->hck=1;
 		}
+        scoreboard_release(cpu, stage);
         if(strcmp(stage->opcode,"") == 0){}else{
         cpu->ins_completed++;
+        cpu->ins_retired++;
         }
         //printf("\ncpu->ins_completed: %d\n", cpu->ins_completed);
         
@@ -904,21 +875,21 @@ int writeback(APEX_CPU* cpu)
         }
         //cpu->regs_valid[stage->rd] = 0;
 //        printf("\nreg_valid[%d]: %d\n",stage->rd, cpu->regs_valid[stage->rd]);
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
         {
             print_stage_content("Writeback", stage);
         }
     }
 	/*else
 	{
-		if (ENABLE_DEBUG_MESSAGES)
+		if (TRACE(cpu))
 		{
   			print_stage_content("Memory", stage);
   		}
   	}*/
 	else
     {
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
         {
             print_stage_contents("Writeback");
     	}
@@ -945,40 +916,115 @@ void displaymem(APEX_CPU* cpu)
 {
 	for(int i=0; i<100; i++)
 	{
-		printf("\n\tMEM_Value[%d] || Value = %d",i,cpu->data_memory[i]);
+		printf("\n\tMEM_Value[%d] || Value = %d",i,dm_read(cpu->data_memory, i));
 	}
 }
 
+/*
+ * LOAD/STORE and the atomics in MEM access the L1D before the stage does its
+ * work, atomics then hold MEM for ATOMIC_LATENCY more cycles and a FENCE for
+ * FENCE_LATENCY. While MEM waits the stages behind it are frozen and a bubble
+ * goes to WB. Returns 1 while MEM has to wait.
+ */
 int
-APEX_cpu_run(APEX_CPU* cpu)
+mem_stall(APEX_CPU* cpu)
 {
-  	while (1)
+	CPU_Stage* stage = &cpu->stage[MEM];
+	int atomic = is_atomic(stage->opcode);
+	int fence = strcmp(stage->opcode, "FENCE") == 0;
+
+	if (cpu->mem_wait > 0)
+	{
+		cpu->mem_wait--;
+	}
+	else if (!stage->busy && !stage->stalled &&
+		 (strcmp(stage->opcode, "LOAD") == 0 || strcmp(stage->opcode, "STORE") == 0 || atomic || fence))
+	{
+		cpu->mem_wait = 0;
+		if (ENABLE_L1D_CACHE && !fence)
+		{
+			/* An atomic needs the line writable like a STORE */
+			int write = strcmp(stage->opcode, "LOAD") != 0;
+			long ready = cpu->bus ? bus_access(cpu->bus, cpu->id, stage->mem_address * 4, write, cpu->clock)
+					      : cache_access(&cpu->l1d, stage->mem_address * 4, write, cpu->clock);
+			/* No free MSHR, try again next cycle */
+			cpu->mem_wait = (ready == -1) ? 1 : ready - cpu->clock - 1;
+		}
+		if (atomic)
+			cpu->mem_wait += ATOMIC_LATENCY;
+		if (fence)
+			cpu->mem_wait += FENCE_LATENCY;
+	}
+	else
 	{
+		return 0;
+	}
+
+	if (cpu->mem_wait == 0)
+	{
+		return 0;
+	}
+	if (atomic || fence)
+	{
+		cpu->sync_cycles++;
+	}
+	strcpy(cpu->stage[WB].opcode, "");
+	cpu->stage[WB].pc = 0;
+	if (TRACE(cpu))
+	{
+		printf("Memory         : (I%d) waiting for %s, %d cycle(s) left\n", (stage->pc - 4000) / 4,
+		       atomic || fence ? stage->opcode : "L1D", cpu->mem_wait);
+	}
+	return 1;
+}
+
+/*
+ * Simulates one clock cycle. Returns 0 once the program has completed.
+ */
+int
+APEX_cpu_step(APEX_CPU* cpu)
+{
         /* All the instructions committed, so exit */
-        if (cpu->ins_completed == cpu->code_memory_size || hck == 1)
+        if (cpu->ins_completed == cpu->code_memory_size || cpu->hck == 1)
 		{
             printf("(apex) >> Simulation Complete\n");
-            break;
+            return 0;
         }
 
-        if (ENABLE_DEBUG_MESSAGES)
+        if (TRACE(cpu))
 		{
             printf("\t-----------------------------------------------\n");
-            printf("\tClock Cycle #: %d\n", cpu->clock);
+            if (cpu->id >= 0)
+                printf("\tCore %d Clock Cycle #: %d\n", cpu->id, cpu->clock);
+            else
+                printf("\tClock Cycle #: %d\n", cpu->clock);
             printf("\t-----------------------------------------------\n");
         }
 
         writeback(cpu);
+        /* Only MEM touches the shared memory and the bus */
+        if (cpu->quantum)
+            quantum_enter(cpu->quantum, cpu->id);
+        if (mem_stall(cpu))
+        {
+            if (cpu->quantum)
+                quantum_leave(cpu->quantum, cpu->id);
+            cpu->clock++;
+            return 1;
+        }
         memory(cpu);
+        if (cpu->quantum)
+            quantum_leave(cpu->quantum, cpu->id);
         execute(cpu);
         decode(cpu);
         fetch(cpu);
         cpu->clock++;
-	//for(int i =0; i<16;i++){
-	//	printf("\nReghister[%d]: %d", i, cpu->regs[i]);
-	//}
-	        
-  	}
+        return 1;
+}
+
+void
+APEX_cpu_print_registers(APEX_CPU* cpu)
+{
 	printf("=============================STATE OF ARCHITECTURAL REGISTER FILE=============================\n");
   	for(int i=0;i<16;i++)
   	{
@@ -986,11 +1032,64 @@ APEX_cpu_run(APEX_CPU* cpu)
   		printf(" | Register[%d] | Value=%d | status=%s | \n",i,cpu->regs[i],(cpu->regs_valid[i])?"Valid" : "Invalid");
 
   	}
-	printf("====================================STATE OF DATA MEMORY======================================\n");
+}
 
-  	for(int i=0;i<99;i++)
-  	{
-        printf(" | MEM[%d] | Value=%d | \n",i,cpu->data_memory[i]);
-  	}
+/*
+ * Makes the core part of an APEX_System: loads and stores go to the shared
+ * data memory and, with the L1D modelled, through the coherence bus.
+ */
+void
+APEX_cpu_join(APEX_CPU* cpu, int id, struct DataMemory* memory, struct Bus* bus)
+{
+	cpu->id = id;
+	cpu->data_memory = memory;
+	if (ENABLE_L1D_CACHE)
+	{
+		/* Cores join in order, so the bus numbers them the same way */
+		bus_attach(bus, &cpu->l1d);
+		cpu->bus = bus;
+	}
+}
+
+static void
+print_sync_stats(APEX_CPU* cpu)
+{
+	printf("=======SYNCHRONIZATION========\n");
+	printf(" | Atomics     | %d |\n", cpu->atomics);
+	printf(" | Fences      | %d |\n", cpu->fences);
+	printf(" | MEM cycles  | %d |\n", cpu->sync_cycles);
+}
+
+void
+APEX_cpu_print_stats(APEX_CPU* cpu)
+{
+	printf("=======CORE %d========\n", cpu->id);
+	printf(" | Cycles      | %d |\n", cpu->clock);
+	printf(" | Retired     | %d |\n", cpu->ins_retired);
+	printf(" | IPC         | %.3f |\n", cpu->clock ? (double)cpu->ins_retired / cpu->clock : 0.0);
+	if (ENABLE_L1D_CACHE)
+	{
+		cache_print_stats(&cpu->l1d);
+		bus_print_stats(cpu->bus, cpu->id);
+	}
+	print_sync_stats(cpu);
+}
+
+int
+APEX_cpu_run(APEX_CPU* cpu)
+{
+	while (APEX_cpu_step(cpu))
+		;
+	APEX_cpu_print_registers(cpu);
+	printf("====================================STATE OF DATA MEMORY======================================\n");
+	dm_print(cpu->data_memory);
+	if (ENABLE_L1D_CACHE)
+	{
+		cache_print_stats(&cpu->l1d);
+	}
+	if (cpu->atomics || cpu->fences)
+	{
+		print_sync_stats(cpu);
+	}
   	return 0;
 }
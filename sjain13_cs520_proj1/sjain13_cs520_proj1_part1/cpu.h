@@ -8,6 +8,11 @@
  *  Gaurav Kothari (gkothar1@binghamton.edu)
  *  State University of New York, Binghamton
  */
+#include "datamem.h"
+#include "cache.h"
+#include "coherence.h"
+
+struct Quantum;
 
 enum
 {
@@ -19,6 +24,9 @@ enum
   NUM_STAGES
 };
 
+/* Cycles a MUL spends in its own pipeline alongside EX, a new MUL can start every cycle */
+#define MUL_LATENCY 2
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction
 {
@@ -44,6 +52,7 @@ typedef struct CPU_Stage
   int mem_address;	// Computed Memory Address
   int busy;		    // Flag to indicate, stage is performing some action
   int stalled;		// Flag to indicate, stage is stalled
+  int seq;		    // Issue order, the EX/MUL arbiter sends the older one to MEM
 } CPU_Stage;
 
 /* Model of APEX CPU */
@@ -69,15 +78,45 @@ typedef struct APEX_CPU
   APEX_Instruction* code_memory;
   int code_memory_size;
 
-  /* Data Memory */
-  int data_memory[4096];
+  /* Data Memory, points at the shared one when the core is part of an APEX_System */
+  struct DataMemory* data_memory;
+  struct DataMemory private_memory;
 
   /* Some stats */
   int ins_completed;
+  int ins_retired;		// Instructions written back, for IPC
+
+  int id;			// Core number, -1 when it runs alone
+  int halt;
+  int hck;
+
+  /* L1 data cache, on the coherence bus when bus is set */
+  struct Cache l1d;
+  struct Bus* bus;
+  int mem_wait;			// Cycles MEM still waits for the L1D, an atomic or a FENCE
+  struct Quantum* quantum;	// Guards MEM when the cores run on host threads, NULL otherwise
 
-	int zflag;
-	int num_cycle;
-	const char*simulate;
+  /* Synchronization cost */
+  int atomics;
+  int fences;
+  int sync_cycles;		// Cycles MEM was held by an atomic or a FENCE
+
+  CPU_Stage mul_pipe[MUL_LATENCY];	// M1 first, an empty opcode is a free slot
+  int issue_count;		// Stamped into seq as DRF issues
+  int ex_hold;			// EX lost the arbiter to an older MUL and keeps its instruction
+
+  /*
+   * Pending-write scoreboard. Bit r of pending_writes is set from the cycle a
+   * writer of Rr leaves DRF until it writes back, producer[r] is the PC of the
+   * youngest such writer so an older one finishing does not clear the bit (WAW).
+   */
+  unsigned int pending_writes;
+  int producer[32];
+  int zflag_producer;		// PC of the youngest ADD/SUB/MUL past DRF, 0 = none
+
+	int zflag;
+	int num_cycle;
+	const char*simulate;
 
 
 } APEX_CPU;
@@ -88,6 +127,18 @@ create_code_memory(const char* filename, int* size);
 APEX_CPU*
 APEX_cpu_init(const char* filename);
 
+int
+APEX_cpu_step(APEX_CPU* cpu);
+
+void
+APEX_cpu_print_registers(APEX_CPU* cpu);
+
+void
+APEX_cpu_join(APEX_CPU* cpu, int id, struct DataMemory* memory, struct Bus* bus);
+
+void
+APEX_cpu_print_stats(APEX_CPU* cpu);
+
 int
 APEX_cpu_run(APEX_CPU* cpu);
 
@@ -78,6 +78,17 @@ create_APEX_instruction(APEX_Instruction* ins, char* buffer)
  if (strcmp(ins->opcode, "HALT") == 0) {
   }
 
+ /* Atomics, MEM[rs1] is read into rd and replaced by rd + rs2 (FADD) or rs2 (SWAP) */
+ if (strcmp(ins->opcode, "FADD") == 0 || strcmp(ins->opcode, "SWAP") == 0) {
+    ins->rd = get_num_from_string(tokens[1]);
+    ins->rs1 = get_num_from_string(tokens[2]);
+    ins->rs2 = get_num_from_string(tokens[3]);
+    ins->imm = 0;
+  }
+
+ if (strcmp(ins->opcode, "FENCE") == 0) {
+  }
+
 
 
 
@@ -1,33 +1,72 @@
-/*
- *  main.c
- *
- *  Author :
- *  Gaurav Kothari (gkothar1@binghamton.edu)
- *  State University of New York, Binghamton
- */
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "cpu.h"
-
-int
-main(int argc, char const* argv[])
-{
-  if (argc != 4) {
-    fprintf(stderr, "APEX_Help : Usage %s <input_file>\n", argv[0]);
-    exit(1);
-  }
-
-  APEX_CPU* cpu = APEX_cpu_init(argv[1]);
-  if (!cpu) {
-    fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
-    exit(1);
-  }
-
-  cpu->simulate=argv[2];
-  cpu->num_cycle=atoi(argv[3]);
-
-  APEX_cpu_run(cpu);
-  APEX_cpu_stop(cpu);
-  return 0;
-}
+/*
+ *  main.c
+ *
+ *  Author :
+ *  Gaurav Kothari (gkothar1@binghamton.edu)
+ *  State University of New York, Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "multicore.h"
+
+int
+main(int argc, char const* argv[])
+{
+  if (argc < 4) {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> simulate <cycles> [<input_file> ...] [quantum=N]\n", argv[0]);
+    exit(1);
+  }
+
+  /* Every extra program runs on its own core, quantum=N runs the cores on host threads */
+  if (argc > 4) {
+    const char* files[MAX_CORES];
+    int cores = 1;
+    int quantum = DEFAULT_QUANTUM;
+    files[0] = argv[1];
+    for (int i = 4; i < argc; i++) {
+      if (strncmp(argv[i], "quantum=", 8) == 0) {
+        quantum = atoi(argv[i] + 8);
+        if (quantum < 0) {
+          fprintf(stderr, "APEX_Error : Invalid %s\n", argv[i]);
+          exit(1);
+        }
+        continue;
+      }
+      if (cores == MAX_CORES) {
+        fprintf(stderr, "APEX_Error : At most %d cores\n", MAX_CORES);
+        exit(1);
+      }
+      files[cores++] = argv[i];
+    }
+
+    APEX_System* sys = APEX_system_init(files, cores);
+    if (!sys) {
+      fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
+      exit(1);
+    }
+    sys->quantum = quantum;
+    for (int i = 0; i < cores; i++) {
+      sys->core[i]->simulate=argv[2];
+      sys->core[i]->num_cycle=atoi(argv[3]);
+    }
+    APEX_system_run(sys);
+    APEX_system_stop(sys);
+    return 0;
+  }
+
+  APEX_CPU* cpu = APEX_cpu_init(argv[1]);
+  if (!cpu) {
+    fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
+    exit(1);
+  }
+
+  cpu->simulate=argv[2];
+  cpu->num_cycle=atoi(argv[3]);
+
+  APEX_cpu_run(cpu);
+  APEX_cpu_stop(cpu);
+  return 0;
+}
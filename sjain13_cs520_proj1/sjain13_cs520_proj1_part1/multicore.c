@@ -0,0 +1,225 @@
+/*
+ *  multicore.c
+ *  Runs several APEX cores in lockstep on one shared data memory
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "multicore.h"
+
+APEX_System*
+APEX_system_init(const char** filenames, int cores)
+{
+	if (cores < 1 || cores > MAX_CORES)
+	{
+		return NULL;
+	}
+
+	APEX_System* sys = calloc(1, sizeof(*sys));
+	if (!sys)
+	{
+		return NULL;
+	}
+	dm_init(&sys->data_memory);
+	bus_init(&sys->bus, BUS_LATENCY);
+	sys->quantum = DEFAULT_QUANTUM;
+
+	for (int i = 0; i < cores; i++)
+	{
+		sys->core[i] = APEX_cpu_init(filenames[i]);
+		if (!sys->core[i])
+		{
+			APEX_system_stop(sys);
+			return NULL;
+		}
+		sys->cores++;
+		APEX_cpu_join(sys->core[i], i, &sys->data_memory, &sys->bus);
+	}
+	return sys;
+}
+
+void
+APEX_system_stop(APEX_System* sys)
+{
+	for (int i = 0; i < sys->cores; i++)
+	{
+		APEX_cpu_stop(sys->core[i]);
+	}
+	dm_free(&sys->data_memory);
+	free(sys);
+}
+
+void
+quantum_enter(struct Quantum* q, int id)
+{
+	pthread_mutex_lock(&q->lock);
+	if (q->cycles == 1)
+	{
+		while (q->turn != id)
+			pthread_cond_wait(&q->turn_changed, &q->lock);
+	}
+}
+
+void
+quantum_leave(struct Quantum* q, int id)
+{
+	if (q->cycles == 1)
+	{
+		q->turn = (id + 1) % q->cores;
+		pthread_cond_broadcast(&q->turn_changed);
+	}
+	pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Every core simulates the same cycle before the clock moves on, lower
+ * numbered cores reach the bus first within a cycle. A core that has
+ * completed stops while the others keep running.
+ */
+static void
+run_lockstep(APEX_System* sys)
+{
+	int live[MAX_CORES];
+	int running = sys->cores;
+
+	for (int i = 0; i < sys->cores; i++)
+	{
+		live[i] = 1;
+	}
+	while (running)
+	{
+		for (int i = 0; i < sys->cores; i++)
+		{
+			if (live[i] && !APEX_cpu_step(sys->core[i]))
+			{
+				live[i] = 0;
+				running--;
+			}
+		}
+	}
+}
+
+struct CoreThread
+{
+	APEX_System* sys;
+	int id;
+	pthread_t thread;
+};
+
+/*
+ * One host thread per core. A core that has completed keeps meeting the
+ * others at the barrier, and with Q = 1 keeps passing the turn on, until
+ * every core is done.
+ */
+static void*
+core_thread(void* arg)
+{
+	struct CoreThread* ct = arg;
+	struct Quantum* q = &ct->sys->q;
+	APEX_CPU* cpu = ct->sys->core[ct->id];
+	int live = 1;
+
+	while (1)
+	{
+		for (int c = 0; c < q->cycles; c++)
+		{
+			if (live && !APEX_cpu_step(cpu))
+			{
+				live = 0;
+				pthread_mutex_lock(&q->lock);
+				q->running--;
+				pthread_mutex_unlock(&q->lock);
+			}
+			if (!live && q->cycles == 1)
+			{
+				quantum_enter(q, ct->id);
+				quantum_leave(q, ct->id);
+			}
+		}
+		/* running only changes between the second wait and the next first one */
+		if (pthread_barrier_wait(&q->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+			q->done = q->running == 0;
+		pthread_barrier_wait(&q->barrier);
+		if (q->done)
+			return NULL;
+	}
+}
+
+static int
+run_threaded(APEX_System* sys)
+{
+	struct Quantum* q = &sys->q;
+	struct CoreThread ct[MAX_CORES];
+	int started = 0;
+
+	q->cycles = sys->quantum;
+	q->cores = sys->cores;
+	q->turn = 0;
+	q->running = sys->cores;
+	q->done = 0;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->turn_changed, NULL);
+	pthread_barrier_init(&q->barrier, NULL, sys->cores);
+	for (int i = 0; i < sys->cores; i++)
+	{
+		sys->core[i]->quantum = q;
+	}
+
+	for (; started < sys->cores; started++)
+	{
+		ct[started].sys = sys;
+		ct[started].id = started;
+		if (pthread_create(&ct[started].thread, NULL, core_thread, &ct[started]) != 0)
+			break;
+	}
+	if (started < sys->cores)
+	{
+		/* The barrier would never fill, nothing has been simulated that can be kept */
+		fprintf(stderr, "APEX_Error : Unable to start a host thread per core\n");
+		exit(1);
+	}
+	for (int i = 0; i < sys->cores; i++)
+	{
+		pthread_join(ct[i].thread, NULL);
+	}
+
+	pthread_barrier_destroy(&q->barrier);
+	pthread_cond_destroy(&q->turn_changed);
+	pthread_mutex_destroy(&q->lock);
+	for (int i = 0; i < sys->cores; i++)
+	{
+		sys->core[i]->quantum = NULL;
+	}
+	return 0;
+}
+
+int
+APEX_system_run(APEX_System* sys)
+{
+	if (sys->quantum > 0)
+		run_threaded(sys);
+	else
+		run_lockstep(sys);
+
+	for (int i = 0; i < sys->cores; i++)
+	{
+		if (sys->core[i]->clock > sys->clock)
+			sys->clock = sys->core[i]->clock;
+	}
+
+	for (int i = 0; i < sys->cores; i++)
+	{
+		printf("=============================CORE %d=============================\n", i);
+		APEX_cpu_print_registers(sys->core[i]);
+		APEX_cpu_print_stats(sys->core[i]);
+	}
+	printf("====================================STATE OF DATA MEMORY======================================\n");
+	dm_print(&sys->data_memory);
+	printf("=======SYSTEM========\n");
+	printf(" | Cores       | %d |\n", sys->cores);
+	if (sys->quantum > 0)
+		printf(" | Quantum     | %d |\n", sys->quantum);
+	printf(" | Cycles      | %d |\n", sys->clock);
+	printf(" | Bus wait    | %lu |\n", sys->bus.wait);
+	return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef _APEX_MULTICORE_H_
+#define _APEX_MULTICORE_H_
+/**
+ *  multicore.h
+ *  Several APEX cores, each running its own program with its own
+ *  registers and pipeline, sharing one data memory. With the L1D
+ *  modelled, the private caches are kept coherent by the MSI bus.
+ *
+ *  With a quantum Q > 0 every core runs on its own host thread and the
+ *  threads meet at a barrier every Q cycles. The shared memory and the bus
+ *  are only touched from MEM, which a core enters under the quantum lock.
+ *  Q = 1 also hands the lock round in core order every cycle, so the run is
+ *  exactly the lockstep one; a larger Q lets cores drift up to Q cycles
+ *  apart and take the bus in whatever order they get there. The per-stage
+ *  trace is off while the cores run on threads.
+ */
+#include <pthread.h>
+
+#include "cpu.h"
+
+/* Cycles one coherence transaction holds the bus */
+#define BUS_LATENCY 4
+
+/* Cycles between barriers, 0 steps every core from one host thread */
+#define DEFAULT_QUANTUM 0
+
+struct Quantum
+{
+  int cycles;
+  int cores;
+  pthread_mutex_t lock;		// Held by the core in MEM
+  pthread_cond_t turn_changed;
+  int turn;			// Core whose MEM goes next, only with cycles == 1
+  pthread_barrier_t barrier;
+  int running;			// Cores that have not completed
+  int done;			// Set at the barrier once running reaches 0
+};
+
+typedef struct APEX_System
+{
+  APEX_CPU* core[MAX_CORES];
+  int cores;
+
+  /* Shared by every core */
+  struct DataMemory data_memory;
+  struct Bus bus;
+
+  int quantum;			// Q, see above
+  struct Quantum q;
+
+  int clock;
+} APEX_System;
+
+APEX_System*
+APEX_system_init(const char** filenames, int cores);
+
+int
+APEX_system_run(APEX_System* sys);
+
+void
+APEX_system_stop(APEX_System* sys);
+
+void
+quantum_enter(struct Quantum* q, int id);
+
+void
+quantum_leave(struct Quantum* q, int id);
+
+#endif
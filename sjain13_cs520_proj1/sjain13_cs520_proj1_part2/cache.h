@@ -0,0 +1,109 @@
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+/**
+ *  cache.h
+ *  Set-associative cache timing model
+ *
+ *  Only tags and timing are modelled, the data itself stays in data_memory.
+ *  Misses are non-blocking: each outstanding line takes an MSHR, a later
+ *  access to a line that is still being filled merges into it, and an
+ *  access that needs a new MSHR while all are busy is refused so the
+ *  caller retries it.
+ *
+ *  Levels compose: a miss is sent to the next cache if there is one, else
+ *  to the DRAM model if there is one, else it costs a fixed miss latency.
+ *  Dirty victims are written back to the same place.
+ */
+#include <stdbool.h>
+
+enum
+{
+  CACHE_LRU,
+  CACHE_PLRU        // Tree pseudo-LRU, ways must be a power of two
+};
+
+struct CacheConfig{
+  const char* name;
+  int sets;
+  int ways;
+  int line_size;        // Bytes
+  int replacement;
+  int hit_latency;
+  int miss_latency;     // Added to the hit latency on a miss with no level below
+  int mshrs;
+};
+
+struct CacheLine{
+  bool valid;
+  bool dirty;
+  bool prefetched;      // Filled by the prefetcher, no demand access yet
+  int tag;
+  unsigned long last_use;
+  unsigned long ready;  // Cycle the fill completes
+};
+
+struct Mshr{
+  bool valid;
+  int line;
+  unsigned long ready;
+};
+
+/* Open-page DRAM with per-bank row buffers and one shared data bus */
+struct DramConfig{
+  int banks;
+  int row_size;         // Bytes per row in one bank
+  int t_cas;            // Row buffer hit
+  int t_rcd;            // Activate a closed bank
+  int t_rp;             // Precharge the open row first on a conflict
+  int burst;            // Bus cycles to transfer one line, caps the bandwidth
+};
+
+struct Dram{
+  struct DramConfig cfg;
+  int* open_row;                // Per bank, -1 when closed
+  unsigned long* bank_free;     // Per bank, cycle it can take the next command
+  unsigned long bus_free;
+  unsigned long accesses;
+  unsigned long row_hits;
+  unsigned long row_empty;
+  unsigned long row_conflicts;
+  unsigned long bus_wait;       // Cycles spent waiting for the data bus
+  unsigned long latency;        // Sum over all accesses
+};
+
+struct Cache{
+  struct CacheConfig cfg;
+  struct Cache* next;           // Set after cache_init, NULL for the last level
+  struct Dram* mem;
+  struct CacheLine* lines;      // sets * ways
+  unsigned* plru;               // One bit tree per set
+  struct Mshr* mshr;
+  unsigned long accesses;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long merged;         // Hit on a line still being filled
+  unsigned long mshr_full;
+  unsigned long writebacks;
+  unsigned long pf_issued;      // Prefetch fills started
+  unsigned long pf_dropped;     // No MSHR free for the prefetch
+  unsigned long pf_useful;      // Prefetched lines a demand access used
+  unsigned long pf_late;        // ... while the fill was still in flight
+  unsigned long pf_useless;     // Prefetched lines evicted unused
+};
+
+bool cache_init(struct Cache*, struct CacheConfig*);
+void cache_free(struct Cache*);
+long cache_access(struct Cache*, int, bool, unsigned long);
+bool cache_prefetch(struct Cache*, int, unsigned long);
+bool cache_probe(struct Cache*, int, bool*);
+bool cache_snoop(struct Cache*, int, bool, unsigned long);
+void cache_print_stats(struct Cache*);
+bool cache_parse_geometry(struct CacheConfig*, const char*);
+
+bool dram_init(struct Dram*, struct DramConfig*);
+void dram_free(struct Dram*);
+long dram_access(struct Dram*, int, unsigned long);
+void dram_print_stats(struct Dram*);
+bool dram_parse(struct DramConfig*, const char*);
+
+#endif
@@ -12,12 +12,37 @@
 #include <string.h>
 
 #include "cpu.h"
+#include "cache.h"
 
 /* Set this flag to 1 to enable debug messages */
 #define ENABLE_DEBUG_MESSAGES 1
+
+/* Set this flag to 1 to model the L1 data cache, memory is otherwise always a hit */
+#define ENABLE_L1D_CACHE 0
+#define L1D_SETS 64
+#define L1D_WAYS 4
+#define L1D_LINE_SIZE 16		// Bytes, four words
+#define L1D_REPLACEMENT CACHE_LRU
+#define L1D_HIT_LATENCY 1		// Cycles, 1 fits in the MEM stage
+#define L1D_MISS_LATENCY 10
+#define L1D_MSHRS 4
 int mul_count = 0;
 int halt=0;
 int hck = 0;
+struct Cache l1d;
+int mem_wait = 0;		// Cycles MEM still waits for the L1D
+
+/* Forwarding paths into DRF, named after the stage that produced the value */
+enum
+{
+	BYPASS_NONE,		// Register file is current
+	BYPASS_EX,		// Producer in the MEM latch
+	BYPASS_MEM,		// Producer in the WB latch
+	NUM_BYPASS
+};
+int producer[32];		// Youngest in-flight writer of each register, rebuilt every decode
+unsigned long bypass_hits[NUM_BYPASS];
+unsigned long load_use_stalls = 0;
 
 /*
  * This function creates and initializes APEX cpu.
@@ -43,10 +68,8 @@ APEX_cpu_init(const char* filename)
   	cpu->pc = 4000;
   	memset(cpu->regs, 0, sizeof(int) * 32);
   	memset(cpu->regs_valid, 1, sizeof(int) * 32);
-	memset(cpu->ex, 0, sizeof(int) * 32);
-  	memset(cpu->ex_valid, 0, sizeof(int) * 32);
 	memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-  	memset(cpu->data_memory, 0, sizeof(int) * 4000);
+  	dm_init(&cpu->data_memory);
 
   	/* Parse input file and create code memory */
   	cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
@@ -57,6 +80,18 @@ APEX_cpu_init(const char* filename)
     		return NULL;
   	}
 
+	if (ENABLE_L1D_CACHE)
+	{
+		struct CacheConfig cfg = { "L1D", L1D_SETS, L1D_WAYS, L1D_LINE_SIZE, L1D_REPLACEMENT,
+					   L1D_HIT_LATENCY, L1D_MISS_LATENCY, L1D_MSHRS };
+		if (!cache_init(&l1d, &cfg))
+		{
+			free(cpu->code_memory);
+			free(cpu);
+			return NULL;
+		}
+	}
+
   	if (ENABLE_DEBUG_MESSAGES)
 	{
     		fprintf(stderr,"APEX_CPU : Initialized APEX CPU, loaded %d instructions\n",cpu->code_memory_size);
@@ -91,6 +126,9 @@ APEX_cpu_init(const char* filename)
 void
 APEX_cpu_stop(APEX_CPU* cpu)
 {
+	if (ENABLE_L1D_CACHE)
+		cache_free(&l1d);
+	dm_free(&cpu->data_memory);
   	free(cpu->code_memory);
   	free(cpu);
 }
@@ -235,6 +273,111 @@ fetch(APEX_CPU* cpu)
 	return 0;
 }
 
+/*
+ * Forwarding network into DRF. decode runs after execute and memory in the
+ * cycle, so the producer of a source is in one of two latches by then: MEM
+ * (computed by EX this cycle) or WB (leaving MEM this cycle). Anything older
+ * has already been written to the register file by writeback.
+ */
+static int
+writes_rd(const char* opcode)
+{
+	return strcmp(opcode, "MOVC") == 0 || strcmp(opcode, "ADD") == 0 || strcmp(opcode, "SUB") == 0 ||
+	       strcmp(opcode, "MUL") == 0 || strcmp(opcode, "AND") == 0 || strcmp(opcode, "OR") == 0 ||
+	       strcmp(opcode, "XOR") == 0 || strcmp(opcode, "LOAD") == 0;
+}
+
+static int
+sets_zflag(const char* opcode)
+{
+	return strcmp(opcode, "ADD") == 0 || strcmp(opcode, "SUB") == 0 || strcmp(opcode, "MUL") == 0;
+}
+
+static int
+reads_rs1(const char* opcode)
+{
+	return (writes_rd(opcode) && strcmp(opcode, "MOVC") != 0) || strcmp(opcode, "STORE") == 0 ||
+	       strcmp(opcode, "JUMP") == 0;
+}
+
+static int
+reads_rs2(const char* opcode)
+{
+	return reads_rs1(opcode) && strcmp(opcode, "LOAD") != 0 && strcmp(opcode, "JUMP") != 0;
+}
+
+/* Bubbles (stalled) and the first cycle of a MUL (busy) produce nothing */
+static int
+holds_result(CPU_Stage* stage)
+{
+	return !stage->busy && !stage->stalled && strcmp(stage->opcode, "") != 0;
+}
+
+static void
+build_scoreboard(APEX_CPU* cpu)
+{
+	for (int i = 0; i < 32; i++)
+	{
+		producer[i] = BYPASS_NONE;
+	}
+	if (holds_result(&cpu->stage[WB]) && writes_rd(cpu->stage[WB].opcode))
+	{
+		producer[cpu->stage[WB].rd] = BYPASS_MEM;
+	}
+	/* Younger than WB, overrides it */
+	if (holds_result(&cpu->stage[MEM]) && writes_rd(cpu->stage[MEM].opcode))
+	{
+		producer[cpu->stage[MEM].rd] = BYPASS_EX;
+	}
+}
+
+/* A LOAD that has only been through EX has no data to forward yet */
+static int
+load_use_hazard(APEX_CPU* cpu, CPU_Stage* stage)
+{
+	int load_rd = (producer[stage->rs1] == BYPASS_EX || producer[stage->rs2] == BYPASS_EX) &&
+		      strcmp(cpu->stage[MEM].opcode, "LOAD") == 0 ? cpu->stage[MEM].rd : -1;
+	return load_rd != -1 && ((reads_rs1(stage->opcode) && stage->rs1 == load_rd) ||
+				 (reads_rs2(stage->opcode) && stage->rs2 == load_rd));
+}
+
+static int
+read_source(APEX_CPU* cpu, int reg)
+{
+	CPU_Stage* from;
+	switch (producer[reg])
+	{
+	case BYPASS_EX:
+		from = &cpu->stage[MEM];
+		break;
+	case BYPASS_MEM:
+		from = &cpu->stage[WB];
+		break;
+	default:
+		return cpu->regs[reg];
+	}
+	bypass_hits[producer[reg]]++;
+	/* A LOAD carries its data in mem_address once it has been through MEM */
+	return strcmp(from->opcode, "LOAD") == 0 ? from->mem_address : from->buffer;
+}
+
+/* Zero flag as seen by a BZ/BNZ entering EX next cycle */
+static int
+read_zero_flag(APEX_CPU* cpu)
+{
+	if (holds_result(&cpu->stage[MEM]) && sets_zflag(cpu->stage[MEM].opcode))
+	{
+		bypass_hits[BYPASS_EX]++;
+		return cpu->stage[MEM].buffer == 0;
+	}
+	if (holds_result(&cpu->stage[WB]) && sets_zflag(cpu->stage[WB].opcode))
+	{
+		bypass_hits[BYPASS_MEM]++;
+		return cpu->stage[WB].buffer == 0;
+	}
+	return cpu->zflag;
+}
+
 /*
  *  Decode Stage of APEX Pipeline
  *
@@ -245,13 +388,6 @@ int
 decode(APEX_CPU* cpu)
 {
   	CPU_Stage* stage = &cpu->stage[DRF];
-	//printf("\nDecode opcode: %s\n",stage->opcode);
-	/*if((cpu->regs_valid[stage->rs1]==1) || (cpu->regs_valid[stage->rs2]==1))
-	{
-		stage->stalled=1;
-	}
-	else
-	stage->stalled=0;*/
   	if(cpu->stage[EX].busy==1 && strcmp(cpu->stage[EX].opcode, "MUL") == 0)
 	{
   		stage->stalled=1;
@@ -261,344 +397,36 @@ decode(APEX_CPU* cpu)
   		}
   		return 0;
   	}
-	if(mul_count == 0)
-		stage->stalled = 0;
-	/*if(cpu->regs_valid[stage->rd]==0)
-	{
-		cpu->stage[F].stalled=1;
-  		cpu->stage[DRF].stalled=1;
-	}
-	else
-	{
-		cpu->stage[F].stalled=0;
-  		cpu->stage[DRF].stalled=0;
-	}*/
 	if(stage->stalled==1)
 	{
      		stage->stalled=0;
    	}
   	if (!stage->busy && !stage->stalled)
 	{
-		/*if(strcmp(stage->opcode, "HALT")==0){halt=1;
-			strcpy(cpu->stage[F].opcode, "");
-		}*/
-		/* Read data from register file for store */
-		if(strcmp(stage->opcode, "BZ")==0 || strcmp(stage->opcode, "BNZ")==0)
-        {
-            if(strcmp(cpu->stage[MEM].opcode, "ADD")==0 || strcmp(cpu->stage[WB].opcode, "ADD")==0 || strcmp(stage[MEM].opcode, "SUB")==0 || strcmp(stage[WB].opcode,"SUB")==0 || strcmp(stage[MEM].opcode,"MUL")==0 || strcmp(stage[WB].opcode,"MUL")==0)
-            {
-                cpu->stage[DRF].stalled=1;
-                //cpu->stage[F].stalled=1;
-            } else {
-                cpu->stage[DRF].stalled=0;
-                cpu->stage[F].stalled=0;
-            }
-        }
-        if (strcmp(stage->opcode, "STORE") == 0)
-	{
-            	if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
+		build_scoreboard(cpu);
+		if (load_use_hazard(cpu, stage))
 		{
+			/* Goes to EX as a bubble, fetch holds and decode retries next cycle */
 			stage->stalled=1;
-            	}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                { 
-                	stage->rs1_value=cpu->ex[stage->rs1];
-    			stage->rs2_value=cpu->regs[stage->rs2];
+			load_use_stalls++;
 		}
-                else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                { 
-                        stage->rs1_value=cpu->ex[stage->rs1];
-    			stage->rs2_value=cpu->ex[stage->rs2];
-				
-                }
-
-                else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                { 
-                        stage->rs1_value=cpu->regs[stage->rs1];
-    			stage->rs2_value=cpu->ex[stage->rs2];
-				
-                }
-
-      		else
-            	{
-                	stage->rs1_value=cpu->regs[stage->rs1];
-      			stage->rs2_value=cpu->regs[stage->rs2];
-      			stage->stalled=0;
-      			//stage->stage_stalled=0;
-      		}
-        }
-
-		/* Read data from register file for load */
-     		if (strcmp(stage->opcode, "LOAD") == 0)
-            {
-                
-     			if(cpu->regs_valid[stage->rs1] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->stalled=0;
-      				//stage->stage_stalled=0;
-				cpu->regs_valid[stage->rd] = 1;
-    			}
-            }
-
-   	 	/* No Register file read needed for MOVC*/
-    		if (strcmp(stage->opcode, "MOVC") == 0)
+		else
 		{
-			cpu->regs_valid[stage->rd]=1;
+			if (reads_rs1(stage->opcode))
+			{
+				stage->rs1_value=read_source(cpu, stage->rs1);
+			}
+			if (reads_rs2(stage->opcode))
+			{
+				stage->rs2_value=read_source(cpu, stage->rs2);
+			}
+			/* BZ/BNZ carry the forwarded zero flag to EX in rs1_value */
+			if (strcmp(stage->opcode, "BZ") == 0 || strcmp(stage->opcode, "BNZ") == 0)
+			{
+				stage->rs1_value=read_zero_flag(cpu);
+			}
 		}
 
-  		/* Read data from register file for Add */
-    		if (strcmp(stage->opcode, "ADD") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] =1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-        /* Read data from register file for Sub */
-    		if (strcmp(stage->opcode, "SUB") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-            /* Read data from register file for Jump */
-            if (strcmp(stage->opcode, "JUMP") == 0)
-            {
-       			if(cpu->regs_valid[stage->rs1] == 1)
-                {
-                    stage->stalled=1;
-      			//stage->stage_stalled=1;
-                }
-                else
-                {
-                    stage->rs1_value= cpu->regs[stage->rs1];
-                    stage->stalled=0;
-		    //cpu->regs_valid[stage->rd] = 1;
-                    //stage->stage_stalled=0;
-                }
-            }
-
-    		/* Read data from register file for Xor */
-    		if (strcmp(stage->opcode, "XOR") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-                }
-            }
-
-            /* Read data from register file for OR */
-    		if (strcmp(stage->opcode, "OR") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-            /* Read data from register file for AND */
-    		if (strcmp(stage->opcode, "AND") == 0)
-            {
-                //printf("src1=%d:%d, src2:%d:%d\n",stage->rs1, cpu->regs_valid[stage->rs1], stage->rs2, cpu->regs_valid[stage->rs2]);
-                if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-      				stage->stalled=1;
-      				//stage->stage_stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-    			else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-    		if (strcmp(stage->opcode, "MUL") == 0)
-            {
-                //cpu->regs_valid[stage->rd]=1;
-    			if(cpu->regs_valid[stage->rs1] == 1 || cpu->regs_valid[stage->rs2] == 1)
-                {
-    				/*stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-    				cpu->regs_valid[stage->rd]=0;*/
-                    stage->stalled=1;
-    			}
-		else if((cpu->ex_valid[stage->rs1])&&(cpu->regs_valid[stage->rs2]))
-                	{ 
-                		stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->regs[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                	else if((cpu->ex_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->ex[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-
-                	else if((cpu->regs_valid[stage->rs1])&&(cpu->ex_valid[stage->rs2]))
-                	{ 
-                        	stage->rs1_value=cpu->regs[stage->rs1];
-    				stage->rs2_value=cpu->ex[stage->rs2];
-				cpu->regs_valid[stage->rd]=0;
-                	}
-                else
-                {
-      				stage->rs1_value=cpu->regs[stage->rs1];
-      				stage->rs2_value=cpu->regs[stage->rs2];
-        			stage->stalled=0;
-        			cpu->regs_valid[stage->rd] = 1;
-				//stage->stage_stalled=0;
-    			}
-            }
-
-
     		/* Copy data from decode latch to execute latch*/
     		cpu->stage[EX] = cpu->stage[DRF];
             if (ENABLE_DEBUG_MESSAGES)
@@ -664,15 +492,12 @@ execute(APEX_CPU* cpu)
         if (strcmp(stage->opcode, "LOAD") == 0)
 		{
             stage->mem_address=(stage->rs1_value)+(stage->imm);
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* MOVC */
         if (strcmp(stage->opcode, "MOVC") == 0)
 		{
             stage->buffer=0+(stage->imm);
-		cpu->ex[stage->rd]=stage->buffer;
-                 cpu->ex_valid[stage->rd]=1;
 
         }
 
@@ -687,55 +512,36 @@ execute(APEX_CPU* cpu)
         if (strcmp(stage->opcode, "ADD") == 0)
 		{
             stage->buffer=(stage->rs1_value)+(stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			//cpu->regs_valid[stage->rd]=0;
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* SUB */
         if (strcmp(stage->opcode, "SUB") == 0)
 		{
             stage->buffer=(stage->rs1_value)-(stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			cpu->regs_valid[stage->rd]=1;
         }
 
         /* XOR */
         if (strcmp(stage->opcode, "XOR") == 0)
 		{
             stage->buffer=(stage->rs1_value)^(stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			cpu->regs_valid[stage->rd]=1;
         }
 
         /* OR */
         if (strcmp(stage->opcode, "OR") == 0)
 		{
             stage->buffer=(stage->rs1_value)|(stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			cpu->regs_valid[stage->rd]=1;
         }
 
         /* AND */
         if (strcmp(stage->opcode, "AND") == 0)
 		{
             stage->buffer=(stage->rs1_value) & (stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			cpu->regs_valid[stage->rd]=1;
         }
 
         /* MUL */
         if (strcmp(stage->opcode, "MUL") == 0)
 		{
             stage->buffer=(stage->rs1_value) * (stage->rs2_value);
-		cpu->ex[stage->rd]=stage->buffer;
-                        cpu->ex_valid[stage->rd]=1;
-			cpu->regs_valid[stage->rd]=1;
 			if(mul_count == 0)
 			{
                 stage->busy=1;
@@ -755,7 +561,7 @@ execute(APEX_CPU* cpu)
 		}
 		else
 		{*/
-			if(cpu->zflag==1)
+			if(stage->rs1_value==1)
             		{
 						stage->buffer=(stage->pc)+(stage->imm);
                 		//cpu->pc=(stage->pc)+(stage->imm);
@@ -780,7 +586,7 @@ execute(APEX_CPU* cpu)
 		}
 		else
 		{*/
-			if(cpu->zflag==0)
+			if(stage->rs1_value==0)
             		{
                 		stage->buffer=(stage->pc)+(stage->imm);
 						//cpu->pc=(stage->pc)+(stage->imm);
@@ -828,14 +634,13 @@ int memory(APEX_CPU* cpu)
         /* Store */
         if (strcmp(stage->opcode, "STORE") == 0)
 		{
-            cpu->data_memory[stage->mem_address]=stage->rs1_value;
+            dm_write(&cpu->data_memory, stage->mem_address, stage->rs1_value);
         }
 
         /* Load */
         if (strcmp(stage->opcode, "LOAD") == 0)
 		{
-            stage->mem_address=cpu->data_memory[stage->mem_address];
-            cpu->regs_valid[stage->rd]=1;
+            stage->mem_address=dm_read(&cpu->data_memory, stage->mem_address);
         }
 
         /* MOVC */
@@ -846,37 +651,31 @@ int memory(APEX_CPU* cpu)
         /* ADD */
         if (strcmp(stage->opcode, "ADD") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* SUB */
         if (strcmp(stage->opcode, "SUB") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* XOR */
         if (strcmp(stage->opcode, "XOR") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* OR */
         if (strcmp(stage->opcode, "OR") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* AND */
         if (strcmp(stage->opcode, "AND") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
         /* MUL */
         if (strcmp(stage->opcode, "MUL") == 0)
 		{
-			cpu->regs_valid[stage->rd] = 1;//#new
         }
 
 		/* HALT */
@@ -891,7 +690,6 @@ int memory(APEX_CPU* cpu)
                 cpu->stage[DRF].pc=0;
                 strcpy(cpu->stage[EX].opcode,"");
                 cpu->stage[EX].pc=0;
-                cpu->regs_valid[cpu->stage[EX].rd] = 0;
             }
         }
 
@@ -1078,8 +876,46 @@ void displaymem(APEX_CPU* cpu)
 {
 	for(int i=0; i<100; i++)
 	{
-		printf("\n\tMEM_Value[%d] || Value = %d",i,cpu->data_memory[i]);
+		printf("\n\tMEM_Value[%d] || Value = %d",i,dm_read(&cpu->data_memory, i));
+	}
+}
+
+/*
+ * LOAD/STORE in MEM access the L1D before the stage does its work. On a miss
+ * MEM holds the instruction until the line arrives: the stages behind it are
+ * frozen and a bubble goes to WB. Returns 1 while MEM has to wait.
+ */
+int
+l1d_stall(APEX_CPU* cpu)
+{
+	CPU_Stage* stage = &cpu->stage[MEM];
+	if (mem_wait > 0)
+	{
+		mem_wait--;
 	}
+	else if (!stage->busy && !stage->stalled &&
+		 (strcmp(stage->opcode, "LOAD") == 0 || strcmp(stage->opcode, "STORE") == 0))
+	{
+		long ready = cache_access(&l1d, stage->mem_address * 4, strcmp(stage->opcode, "STORE") == 0, cpu->clock);
+		/* No free MSHR, try again next cycle */
+		mem_wait = (ready == -1) ? 1 : ready - cpu->clock - 1;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (mem_wait == 0)
+	{
+		return 0;
+	}
+	strcpy(cpu->stage[WB].opcode, "");
+	cpu->stage[WB].pc = 0;
+	if (ENABLE_DEBUG_MESSAGES)
+	{
+		printf("Memory         : (I%d) waiting for L1D, %d cycle(s) left\n", (stage->pc - 4000) / 4, mem_wait);
+	}
+	return 1;
 }
 
 int
@@ -1102,6 +938,11 @@ APEX_cpu_run(APEX_CPU* cpu)
         }
 
         writeback(cpu);
+        if (ENABLE_L1D_CACHE && l1d_stall(cpu))
+        {
+            cpu->clock++;
+            continue;
+        }
         memory(cpu);
         execute(cpu);
         decode(cpu);
@@ -1116,10 +957,14 @@ APEX_cpu_run(APEX_CPU* cpu)
 
   	}
 	printf("====================================STATE OF DATA MEMORY======================================\n");
-
-  	for(int i=0;i<99;i++)
-  	{
-        printf(" | MEM[%d] | Value=%d | \n",i,cpu->data_memory[i]);
-  	}
+	dm_print(&cpu->data_memory);
+	printf("=====================================FORWARDING NETWORK=======================================\n");
+	printf(" | EX->DRF bypass  | %lu | \n",bypass_hits[BYPASS_EX]);
+	printf(" | MEM->DRF bypass | %lu | \n",bypass_hits[BYPASS_MEM]);
+	printf(" | Load-use stalls | %lu | \n",load_use_stalls);
+	if (ENABLE_L1D_CACHE)
+	{
+		cache_print_stats(&l1d);
+	}
   	return 0;
 }
@@ -8,6 +8,7 @@
  *  Gaurav Kothari (gkothar1@binghamton.edu)
  *  State University of New York, Binghamton
  */
+#include "datamem.h"
 
 enum
 {
@@ -59,9 +60,6 @@ typedef struct APEX_CPU
   int regs[32];
   int regs_valid[32];
 
- int ex[32];
-  int ex_valid[32];
-
   /* Array of 5 CPU_stage */
   CPU_Stage stage[5];
 
@@ -70,7 +68,7 @@ typedef struct APEX_CPU
   int code_memory_size;
 
   /* Data Memory */
-  int data_memory[4096];
+  struct DataMemory data_memory;
 
   /* Some stats */
   int ins_completed;
@@ -0,0 +1,33 @@
+#ifndef _APEX_DATAMEM_H_
+#define _APEX_DATAMEM_H_
+/**
+ *  datamem.h
+ *  Sparse, page-granular data memory
+ *
+ *  Word addresses 0 .. DM_SIZE-1 are valid. A page is allocated the first
+ *  time one of its words is written; reading an untouched page returns 0
+ *  without allocating it. Accesses outside the address space are refused
+ *  and recorded in fault instead of landing in neighbouring state.
+ */
+#include <stdbool.h>
+
+#define DM_PAGE_BITS 10                         // 1024 words per page
+#define DM_PAGE_WORDS (1 << DM_PAGE_BITS)
+#define DM_SIZE (1 << 22)                       // Words, 16 MB
+#define DM_NUM_PAGES (DM_SIZE / DM_PAGE_WORDS)
+
+struct DataMemory{
+  int* page[DM_NUM_PAGES];      // NULL until first written
+  int pages;                    // Pages allocated
+  bool fault;                   // An access was out of range
+  int fault_address;            // First such address
+};
+
+void dm_init(struct DataMemory*);
+void dm_free(struct DataMemory*);
+bool dm_valid(int);
+int dm_read(struct DataMemory*, int);
+void dm_write(struct DataMemory*, int, int);
+void dm_print(struct DataMemory*);
+
+#endif
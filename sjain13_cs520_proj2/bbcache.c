@@ -0,0 +1,77 @@
+/*
+ *  bbcache.c
+ *  Basic-block cache of decoded micro-ops
+ */
+#include <string.h>
+#include <stdbool.h>
+
+#include "bbcache.h"
+#include "bundle.h"
+#include "functional.h"
+
+static struct BasicBlock blocks[BB_CACHE_BLOCKS];
+
+void bb_init(){
+  for(int i=0;i<BB_CACHE_BLOCKS;i++)
+    blocks[i].code = NULL;
+}
+
+int bb_flags(int op){
+  int flags = 0;
+  if(bundle_writes_rd(op))
+    flags |= BB_WRITES_RD;
+  if(op != FUNC_NOP && op != FUNC_MOVC && op != FUNC_BZ && op != FUNC_BNZ && op != FUNC_HALT && op != FUNC_FENCE)
+    flags |= BB_READS_RS1;
+  if((op >= FUNC_ADD && op <= FUNC_XOR) || op == FUNC_STORE || op == FUNC_FADD || op == FUNC_SWAP)
+    flags |= BB_READS_RS2;
+  if(bundle_sets_zero(op))
+    flags |= BB_SETS_ZERO;
+  if(op == FUNC_BZ || op == FUNC_BNZ)
+    flags |= BB_READS_ZERO | BB_CONTROL;
+  if(op == FUNC_JUMP || op == FUNC_JAL)
+    flags |= BB_CONTROL;
+  if(op == FUNC_LOAD || op == FUNC_STORE || op == FUNC_FADD || op == FUNC_SWAP || op == FUNC_FENCE)
+    flags |= BB_MEMORY;
+  return flags;
+}
+
+static void decode_block(struct BasicBlock* bb, const APEX_Instruction* code, int code_size, int pc){
+  bb->code = code;
+  bb->entry_pc = pc;
+  bb->size = 0;
+  for(int index=(pc - 4000) / 4;index < code_size && bb->size < BB_MAX_OPS;index++, pc += 4){
+    struct BlockOp* o = &bb->op[bb->size];
+    o->ins = &code[index];
+    o->pc = pc;
+    o->op = func_decode_opcode(o->ins->opcode);
+    o->flags = bb_flags(o->op);
+    o->dep1 = o->dep2 = o->dep_zero = -1;
+    for(int j=0;j<bb->size;j++){    //  YOUNGEST OLDER PRODUCER WINS
+      struct BlockOp* p = &bb->op[j];
+      if(p->flags & BB_WRITES_RD){
+        if((o->flags & BB_READS_RS1) && p->ins->rd == o->ins->rs1)
+          o->dep1 = j;
+        if((o->flags & BB_READS_RS2) && p->ins->rd == o->ins->rs2)
+          o->dep2 = j;
+      }
+      if((p->flags & BB_SETS_ZERO) && (o->flags & BB_READS_ZERO))
+        o->dep_zero = j;
+    }
+    bb->size++;
+    if((o->flags & BB_CONTROL) || o->op == FUNC_HALT)
+      break;
+  }
+}
+
+/*
+ * Block entered at pc, decoded on a miss. NULL when pc is outside the code.
+ */
+struct BasicBlock* bb_lookup(const APEX_Instruction* code, int code_size, int pc){
+  if(pc < 4000 || (pc - 4000) % 4 || (pc - 4000) / 4 >= code_size)
+    return NULL;
+  struct BasicBlock* bb = &blocks[(pc >> 2) % BB_CACHE_BLOCKS];
+  if(bb->code != code || bb->entry_pc != pc)
+    decode_block(bb,code,code_size,pc);
+  return bb;
+}
+
@@ -0,0 +1,56 @@
+#ifndef _APEX_BBCACHE_H_
+#define _APEX_BBCACHE_H_
+/**
+ *  bbcache.h
+ *  Basic-block cache of decoded micro-ops
+ *
+ *  A block runs from its entry PC up to and including the next BZ, BNZ,
+ *  JUMP, JAL or HALT, or BB_MAX_OPS instructions. The first fetch from an
+ *  entry PC decodes the block once: opcode, operand fields, class flags
+ *  and, for every source, the older op of the same block producing it.
+ *  Later fetches from that PC take the micro-ops as they are. A PC inside
+ *  a block that is fetched directly (after a redirect, or a bundle cut by
+ *  the fetch width) becomes the entry of a block of its own.
+ *
+ *  Code memory is never written, so blocks stay valid for the whole run;
+ *  they are tagged with the code memory they came from so SMT threads
+ *  running different programs do not share them.
+ */
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define BB_CACHE_BLOCKS 256         // Direct mapped on the entry PC
+#define BB_MAX_OPS 16
+
+/* Micro-op class flags */
+#define BB_WRITES_RD  0x01
+#define BB_READS_RS1  0x02
+#define BB_READS_RS2  0x04
+#define BB_SETS_ZERO  0x08
+#define BB_READS_ZERO 0x10          // BZ/BNZ
+#define BB_CONTROL    0x20          // Goes through the branch predictor
+#define BB_MEMORY     0x40          // LOAD/STORE/FADD/SWAP/FENCE, takes an LSQ entry
+
+struct BlockOp{
+  const APEX_Instruction* ins;      // In code memory, for the fields rename copies
+  int pc;
+  int op;                           // FUNC_* opcode
+  int flags;
+  int dep1;                         // Older op of the block producing rs1, -1 for none
+  int dep2;
+  int dep_zero;                     // Older op of the block setting the zero flag
+};
+
+struct BasicBlock{
+  const APEX_Instruction* code;     // Code memory the block was decoded from, NULL when free
+  int entry_pc;
+  int size;
+  struct BlockOp op[BB_MAX_OPS];
+};
+
+void bb_init();
+struct BasicBlock* bb_lookup(const APEX_Instruction*, int, int);
+int bb_flags(int);
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ *  bpred.c
+ *  Dynamic direction predictor for BZ/BNZ (bimodal, gshare, TAGE-lite),
+ *  branch target buffer and return address stack for JUMP/JAL
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bpred.h"
+#include "bundle.h"
+#include "config.h"
+
+#define BP_FIFO_SIZE (FETCH_BUFFER_MAX + 2 * MAX_WIDTH)    // Branches between fetch and dispatch: the fetch buffer, the DRF bundle and its renamed slots
+#define BP_MAX_INFLIGHT 32      // Dispatched, unresolved branches (one ROB worth)
+#define BP_TAGE_TAG_BITS 9
+#define BP_TAGE_U_RESET 262144  // Resolutions between ageing of useful bits
+
+struct TageEntry{
+  signed char ctr;      // 3-bit signed counter, taken when >= 0
+  unsigned short tag;
+  unsigned char u;      // 2-bit useful counter
+};
+
+struct BtbEntry{
+  bool valid;
+  int pc;               // Full fetch PC as the tag
+  int target;
+};
+
+static const char* bp_names[BP_NUM_TYPES] = { "none", "bimodal", "gshare", "tage" };
+
+static unsigned char* base;                         // 2-bit counters
+static struct TageEntry* tage[BP_TAGE_TABLES];
+static int tage_hist[BP_TAGE_TABLES];               // Geometric history lengths
+static int base_mask;
+static int tage_mask;
+static int hist_len;
+static unsigned long long ghr;                      // Speculative global history
+
+static struct BtbEntry* btb;
+static int btb_mask;
+static int* ras_addr;                               // Circular, overflow overwrites the oldest
+static int* ras_link;                               // Register JAL wrote the return address to
+static int ras_top;
+static int ras_count;
+
+static struct BranchPrediction fifo[BP_FIFO_SIZE];
+static int fifo_head = 0;
+static int fifo_count = 0;
+static int next_seq = 0;
+static struct BranchPrediction inflight[BP_MAX_INFLIGHT];
+static int inflight_count = 0;
+
+static bool redirect_pending = false;
+static int redirect_pc;
+
+static unsigned long bp_lookups = 0;
+static unsigned long bp_resolved = 0;
+static unsigned long bp_mispredicts = 0;
+static unsigned long tage_provider_hits = 0;
+static unsigned long btb_lookups = 0;
+static unsigned long btb_hits = 0;
+static unsigned long target_resolved = 0;
+static unsigned long target_mispredicts = 0;
+static unsigned long ras_pushes = 0;
+static unsigned long ras_pops = 0;
+static unsigned long ras_overflows = 0;
+static unsigned long return_mispredicts = 0;
+
+int bp_parse_type(const char* name){   //  -1 FOR AN UNKNOWN PREDICTOR NAME
+  for(int i=0;i<BP_NUM_TYPES;i++){
+    if(!strcmp(name,bp_names[i]))
+      return i;
+  }
+  return -1;
+}
+
+void bp_init(){
+  int bits = sim_config.bp_bits;
+  base_mask = (1 << bits) - 1;
+  base = malloc(1 << bits);
+  memset(base,1,1 << bits);         // Weakly not taken
+
+  hist_len = sim_config.bp_hist;
+  if(hist_len <= 0)
+    hist_len = sim_config.bp_type == BP_TAGE ? 32 : bits;
+  if(hist_len > 64)
+    hist_len = 64;
+
+  if(sim_config.bp_type == BP_TAGE){
+    tage_mask = (1 << (bits - 1)) - 1;
+    for(int t=0;t<BP_TAGE_TABLES;t++){
+      tage[t] = calloc(tage_mask + 1,sizeof(struct TageEntry));
+      tage_hist[t] = hist_len >> (BP_TAGE_TABLES - 1 - t);
+      if(tage_hist[t] < 1)
+        tage_hist[t] = 1;
+    }
+  }
+
+  if(sim_config.btb_bits){
+    btb_mask = (1 << sim_config.btb_bits) - 1;
+    btb = calloc(btb_mask + 1,sizeof(struct BtbEntry));
+    ras_addr = calloc(sim_config.ras_depth,sizeof(int));
+    ras_link = calloc(sim_config.ras_depth,sizeof(int));
+  }
+  ras_top = ras_count = 0;
+
+  ghr = 0;
+  bp_lookups = bp_resolved = bp_mispredicts = tage_provider_hits = 0;
+  btb_lookups = btb_hits = target_resolved = target_mispredicts = 0;
+  ras_pushes = ras_pops = ras_overflows = return_mispredicts = 0;
+  fifo_head = fifo_count = inflight_count = 0;
+  next_seq = 0;
+  redirect_pending = false;
+}
+
+void bp_free(){
+  free(base);
+  base = NULL;
+  for(int t=0;t<BP_TAGE_TABLES;t++){
+    free(tage[t]);
+    tage[t] = NULL;
+  }
+  free(btb);
+  free(ras_addr);
+  free(ras_link);
+  btb = NULL;
+  ras_addr = ras_link = NULL;
+}
+
+static unsigned fold_history(unsigned long long h, int len, int bits){   //  XOR-FOLD THE LAST len BITS INTO bits BITS
+  unsigned long long x = len >= 64 ? h : (h & ((1ULL << len) - 1));
+  unsigned r = 0;
+  while(x){
+    r ^= x & ((1u << bits) - 1);
+    x >>= bits;
+  }
+  return r;
+}
+
+static bool counter_taken(unsigned char c){
+  return c >= 2;
+}
+
+static void counter_train(unsigned char* c, bool taken){
+  if(taken && *c < 3)
+    (*c)++;
+  else if(!taken && *c > 0)
+    (*c)--;
+}
+
+static void predict(struct BranchPrediction* p){
+  int pc = p->pc >> 2;
+  int bits = sim_config.bp_bits;
+
+  p->provider = -1;
+  if(sim_config.bp_type == BP_GSHARE)
+    p->base_index = (pc ^ fold_history(ghr,hist_len,bits)) & base_mask;
+  else
+    p->base_index = pc & base_mask;
+  p->taken = counter_taken(base[p->base_index]);
+  p->alt_taken = p->taken;
+  p->provider_taken = p->taken;
+
+  if(sim_config.bp_type != BP_TAGE)
+    return;
+
+  /* Spread the PC over the whole table so short histories of neighbouring branches do not alias */
+  unsigned spread = ((unsigned)pc * 2654435761u) >> (32 - (bits - 1));
+  for(int t=0;t<BP_TAGE_TABLES;t++){
+    p->index[t] = (spread ^ fold_history(ghr,tage_hist[t],bits - 1) ^ (t << 1)) & tage_mask;
+    p->tag[t] = (pc ^ fold_history(ghr,tage_hist[t],BP_TAGE_TAG_BITS)
+                 ^ (fold_history(ghr,tage_hist[t],BP_TAGE_TAG_BITS - 1) << 1)) & ((1 << BP_TAGE_TAG_BITS) - 1);
+  }
+  bool provider_taken = p->taken;
+  for(int t=BP_TAGE_TABLES-1;t>=0;t--){   //  LONGEST MATCHING HISTORY PROVIDES, NEXT ONE IS THE ALTERNATE
+    if(tage[t][p->index[t]].tag != p->tag[t])
+      continue;
+    if(p->provider == -1){
+      p->provider = t;
+      provider_taken = tage[t][p->index[t]].ctr >= 0;
+    }
+    else{
+      p->alt_taken = tage[t][p->index[t]].ctr >= 0;
+      break;
+    }
+  }
+  if(p->provider == -1)
+    return;
+
+  /* A freshly allocated entry has not learnt anything yet, trust the alternate */
+  struct TageEntry* e = &tage[p->provider][p->index[p->provider]];
+  bool weak = (e->ctr == 0 || e->ctr == -1) && e->u == 0;
+  p->taken = weak ? p->alt_taken : provider_taken;
+  p->provider_taken = provider_taken;
+}
+
+static void train(struct BranchPrediction* p, bool taken){
+  if(sim_config.bp_type != BP_TAGE){
+    counter_train(&base[p->base_index],taken);
+    return;
+  }
+
+  if(p->provider == -1 || p->alt_taken != p->provider_taken)
+    counter_train(&base[p->base_index],taken);
+  if(p->provider != -1){
+    struct TageEntry* e = &tage[p->provider][p->index[p->provider]];
+    if(taken && e->ctr < 3)
+      e->ctr++;
+    else if(!taken && e->ctr > -4)
+      e->ctr--;
+    if(p->provider_taken != p->alt_taken){
+      if(p->provider_taken == taken && e->u < 3)
+        e->u++;
+      else if(p->provider_taken != taken && e->u > 0)
+        e->u--;
+    }
+    if(p->provider_taken == taken)
+      tage_provider_hits++;
+  }
+
+  if(p->taken != taken || p->provider_taken != taken){   //  ALLOCATE IN A LONGER HISTORY TABLE
+    bool allocated = false;
+    for(int t=p->provider+1;t<BP_TAGE_TABLES && !allocated;t++){
+      struct TageEntry* e = &tage[t][p->index[t]];
+      if(e->u == 0){
+        e->tag = p->tag[t];
+        e->ctr = taken ? 0 : -1;
+        allocated = true;
+      }
+    }
+    if(!allocated){
+      for(int t=p->provider+1;t<BP_TAGE_TABLES;t++){
+        if(tage[t][p->index[t]].u > 0)
+          tage[t][p->index[t]].u--;
+      }
+    }
+  }
+
+  if(bp_resolved % BP_TAGE_U_RESET == 0){
+    for(int t=0;t<BP_TAGE_TABLES;t++){
+      for(int i=0;i<=tage_mask;i++)
+        tage[t][i].u >>= 1;
+    }
+  }
+}
+
+static int btb_lookup(int pc){   //  PREDICTED TARGET, pc + 4 ON A MISS
+  struct BtbEntry* e = &btb[(pc >> 2) & btb_mask];
+  btb_lookups++;
+  if(!e->valid || e->pc != pc)
+    return pc + 4;
+  btb_hits++;
+  return e->target;
+}
+
+static void ras_push(int addr, int link){
+  if(ras_count == sim_config.ras_depth)
+    ras_overflows++;
+  else
+    ras_count++;
+  ras_top = (ras_top + 1) % sim_config.ras_depth;
+  ras_addr[ras_top] = addr;
+  ras_link[ras_top] = link;
+  ras_pushes++;
+}
+
+static int ras_pop(){
+  int addr = ras_addr[ras_top];
+  ras_top = (ras_top + sim_config.ras_depth - 1) % sim_config.ras_depth;
+  ras_count--;
+  ras_pops++;
+  return addr;
+}
+
+static void restore(struct BranchPrediction* p){   //  REWIND HISTORY AND RAS TO BEFORE p WAS FETCHED
+  ghr = p->ghr;
+  if(!ras_addr)
+    return;
+  ras_top = p->ras_top;
+  ras_count = p->ras_count;
+  ras_addr[ras_top] = p->ras_top_addr;
+  ras_link[ras_top] = p->ras_top_link;
+}
+
+/*
+ * Called by fetch for every instruction it fetches, returns the next fetch PC.
+ * Control instructions are recognised from the predecoded opcode; JAL pushes
+ * its return address and a JUMP through the link register of the top RAS
+ * entry is treated as a return. *seq is the number the prediction is handed
+ * to bp_dispatch with, -1 when none was made.
+ */
+int bp_fetch(int pc, const char* opcode, int rd, int rs1, int literal, int* seq){
+  struct BranchPrediction p;
+  memset(&p,0,sizeof(p));
+  *seq = -1;
+  p.pc = pc;
+  p.cod = -1;
+  p.ghr = ghr;
+  if(ras_addr){   //  EVERY PREDICTION, A SQUASH REWINDS TO THE OLDEST ONE IT DROPS WHATEVER ITS KIND
+    p.ras_top = ras_top;
+    p.ras_count = ras_count;
+    p.ras_top_addr = ras_addr[ras_top];
+    p.ras_top_link = ras_link[ras_top];
+  }
+
+  if(!strcmp(opcode,"BZ") || !strcmp(opcode,"BNZ")){
+    if(sim_config.bp_type == BP_NONE)
+      return pc + 4;
+    p.kind = BP_COND;
+    p.target = pc + literal;
+  }
+  else if(!strcmp(opcode,"JUMP") || !strcmp(opcode,"JAL")){
+    if(!btb)
+      return pc + 4;
+    p.taken = true;
+    if(!strcmp(opcode,"JAL")){
+      p.kind = BP_CALL;
+      p.target = btb_lookup(pc);
+      ras_push(pc + 4,rd);
+    }
+    else if(ras_count && ras_link[ras_top] == rs1){
+      p.kind = BP_RETURN;
+      p.target = ras_pop();
+    }
+    else{
+      p.kind = BP_JUMP;
+      p.target = btb_lookup(pc);
+    }
+  }
+  else
+    return pc + 4;
+
+  if(p.kind == BP_COND){
+    predict(&p);
+    ghr = (ghr << 1) | p.taken;
+    bp_lookups++;
+  }
+
+  if(fifo_count == BP_FIFO_SIZE){   //  SIZED FOR EVERY SLOT THE FRONTEND CAN HOLD
+    fprintf(stderr, "APEX_Error : More than %d predicted branches between fetch and dispatch\n", BP_FIFO_SIZE);
+    exit(1);
+  }
+  p.seq = *seq = next_seq++;
+  fifo[(fifo_head + fifo_count) % BP_FIFO_SIZE] = p;
+  fifo_count++;
+  return p.taken ? p.target : pc + 4;
+}
+
+/*
+ * Called when a control instruction is dispatched together with its CFQ
+ * entry, with the seq bp_fetch gave its prediction. The frontend is in
+ * order, so that prediction is the oldest one still waiting; instructions
+ * fetched without a prediction (seq -1) leave the FIFO alone.
+ */
+void bp_dispatch(int seq, int cod){
+  int n;
+  if(seq == -1)
+    return;
+  for(n=0;n<fifo_count;n++){
+    if(fifo[(fifo_head + n) % BP_FIFO_SIZE].seq == seq)
+      break;
+  }
+  if(n == fifo_count)
+    return;
+
+  struct BranchPrediction p = fifo[(fifo_head + n) % BP_FIFO_SIZE];
+  fifo_head = (fifo_head + n + 1) % BP_FIFO_SIZE;
+  fifo_count -= n + 1;
+  if(inflight_count == BP_MAX_INFLIGHT){
+    memmove(&inflight[0],&inflight[1],sizeof(inflight[0]) * (BP_MAX_INFLIGHT - 1));
+    inflight_count--;
+  }
+  p.cod = cod;
+  inflight[inflight_count++] = p;
+}
+
+/*
+ * Drops every prediction younger than cod (dispatched later or still in the
+ * frontend) and rewinds the global history and the RAS to before the oldest
+ * of them.
+ */
+void bp_squash_younger(int cod){
+  int i;
+  for(i=0;i<inflight_count;i++){
+    if(inflight[i].cod > cod)
+      break;
+  }
+  if(i < inflight_count){
+    restore(&inflight[i]);
+    inflight_count = i;
+  }
+  else if(fifo_count)
+    restore(&fifo[fifo_head]);
+  fifo_count = 0;
+}
+
+static bool take_inflight(int cod, struct BranchPrediction* p){   //  REMOVE THE PREDICTION FOR cod, FALSE IF THERE IS NONE
+  int place = -1;
+  for(int i=0;i<inflight_count;i++){
+    if(inflight[i].cod == cod)
+      place = i;
+  }
+  if(place == -1)
+    return false;
+
+  *p = inflight[place];
+  memmove(&inflight[place],&inflight[place+1],sizeof(inflight[0]) * (inflight_count - place - 1));
+  inflight_count--;
+  return true;
+}
+
+/*
+ * Called when the INT FU resolves BZ/BNZ with the given cod, pc and taken
+ * target. Trains the predictor and returns true on a misprediction, in which
+ * case everything younger than the branch must be flushed; fetch picks up the
+ * correct path through bp_take_redirect(). A branch fetched without a
+ * prediction was fetched as not taken.
+ */
+bool bp_resolve(int cod, int pc, int target, bool taken){
+  struct BranchPrediction p;
+  if(!take_inflight(cod,&p)){
+    if(!taken)
+      return false;
+    bp_squash_younger(cod);
+    redirect_pending = true;
+    redirect_pc = target;
+    return true;
+  }
+
+  bp_resolved++;
+  train(&p,taken);
+  if(p.taken == taken)
+    return false;
+
+  bp_mispredicts++;
+  bp_squash_younger(cod);
+  ghr = (p.ghr << 1) | taken;
+  redirect_pending = true;
+  redirect_pc = taken ? p.target : p.pc + 4;
+  return true;
+}
+
+/*
+ * Called when the INT FU computes the target of JUMP/JAL with the given cod
+ * and pc. Trains the BTB and returns true when fetch did not follow the right
+ * path (wrong target, or no prediction was made and the target is not the
+ * fall-through pc + 4), in which case everything younger must be flushed and
+ * fetch restarts at the real target.
+ */
+bool bp_resolve_target(int cod, int pc, int target){
+  struct BranchPrediction p;
+  bool predicted = take_inflight(cod,&p);
+
+  if(predicted){
+    target_resolved++;
+    if(p.kind != BP_RETURN){
+      struct BtbEntry* e = &btb[(p.pc >> 2) & btb_mask];
+      e->valid = true;
+      e->pc = p.pc;
+      e->target = target;
+    }
+    if(p.target == target)
+      return false;
+    target_mispredicts++;
+    if(p.kind == BP_RETURN)
+      return_mispredicts++;
+  }
+  else if(target == pc + 4)
+    return false;
+
+  bp_squash_younger(cod);
+  redirect_pending = true;
+  redirect_pc = target;
+  return true;
+}
+
+/*
+ * Restarts fetch at pc after everything younger than cod was squashed for
+ * a reason other than a control instruction, e.g. a replayed LOAD.
+ */
+void bp_replay(int cod, int pc){
+  bp_squash_younger(cod);
+  redirect_pending = true;
+  redirect_pc = pc;
+}
+
+bool bp_take_redirect(int* pc){
+  if(!redirect_pending)
+    return false;
+  redirect_pending = false;
+  *pc = redirect_pc;
+  return true;
+}
+
+bool bp_redirect_pending(){   //  FETCH HAS NOT TAKEN THE LAST REDIRECT YET
+  return redirect_pending;
+}
+
+void bp_print_stats(){
+  printf("=======BRANCH PREDICTOR========\n");
+  if(sim_config.bp_type != BP_NONE){
+    printf(" | Predictor   | %s (2^%d entries, %d history bits) |\n",bp_names[sim_config.bp_type],sim_config.bp_bits,
+           sim_config.bp_type == BP_BIMODAL ? 0 : hist_len);
+    printf(" | Predictions | %lu |\n",bp_lookups);
+    printf(" | Resolved    | %lu |\n",bp_resolved);
+    printf(" | Mispredicts | %lu |\n",bp_mispredicts);
+    if(bp_resolved)
+      printf(" | Accuracy    | %.2f%% |\n",100.0 * (bp_resolved - bp_mispredicts) / bp_resolved);
+    if(sim_config.bp_type == BP_TAGE)
+      printf(" | TAGE hits   | %lu |\n",tage_provider_hits);
+  }
+  if(btb){
+    printf(" | BTB         | 2^%d entries, RAS depth %d |\n",sim_config.btb_bits,sim_config.ras_depth);
+    printf(" | BTB hits    | %lu / %lu |\n",btb_hits,btb_lookups);
+    printf(" | Targets     | %lu resolved, %lu mispredicted |\n",target_resolved,target_mispredicts);
+    printf(" | RAS         | %lu pushes, %lu pops, %lu overflows |\n",ras_pushes,ras_pops,ras_overflows);
+    printf(" | Return miss | %lu |\n",return_mispredicts);
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef _APEX_BPRED_H_
+#define _APEX_BPRED_H_
+/**
+ *  bpred.h
+ *  Frontend control-flow prediction: direction predictor for BZ/BNZ,
+ *  branch target buffer for JUMP/JAL and a return address stack
+ *
+ *  fetch() asks for the next PC and follows it. The prediction travels with
+ *  the instruction (keyed by the sequence number bp_fetch gave it until
+ *  dispatch, then by its cod next to the CFQ entry) and is checked when the
+ *  INT FU resolves it. On a
+ *  misprediction fetch is redirected to the correct path on the next cycle.
+ */
+#include <stdbool.h>
+
+enum
+{
+  BP_NONE,        // No prediction, every branch is fetched as not taken
+  BP_BIMODAL,
+  BP_GSHARE,
+  BP_TAGE,
+  BP_NUM_TYPES
+};
+
+/* What kind of control transfer a prediction was made for */
+enum
+{
+  BP_COND,        // BZ/BNZ
+  BP_JUMP,        // JUMP through an arbitrary register
+  BP_CALL,        // JAL, pushes the return address
+  BP_RETURN       // JUMP through the link register of the top RAS entry
+};
+
+#define BP_TAGE_TABLES 4
+
+/* Everything needed to train and recover one in-flight branch */
+struct BranchPrediction{
+  int pc;
+  int kind;
+  int seq;                          // Fetch order, given by bp_fetch
+  int cod;                          // Assigned at dispatch, -1 before that
+  int target;                       // Taken target, predicted target for JUMP/JAL
+  bool taken;                       // Predicted direction
+  unsigned long long ghr;           // Global history before this branch
+  int base_index;
+  int provider;                     // TAGE table that gave the prediction, -1 for base
+  bool provider_taken;
+  bool alt_taken;
+  int index[BP_TAGE_TABLES];
+  int tag[BP_TAGE_TABLES];
+  int ras_top;                      // RAS checkpoint taken before this instruction
+  int ras_count;
+  int ras_top_addr;
+  int ras_top_link;
+};
+
+void bp_init();
+void bp_free();
+int bp_parse_type(const char*);
+int bp_fetch(int, const char*, int, int, int, int*);
+void bp_dispatch(int, int);
+bool bp_resolve(int, int, int, bool);
+bool bp_resolve_target(int, int, int);
+void bp_squash_younger(int);
+void bp_replay(int, int);
+bool bp_take_redirect(int*);
+bool bp_redirect_pending();
+void bp_print_stats();
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ *  bundle.c
+ *  Fetch bundle formation and intra-bundle dependency checking
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "bundle.h"
+#include "bbcache.h"
+#include "bpred.h"
+#include "config.h"
+#include "functional.h"
+
+bool bundle_writes_rd(int op){
+  switch(op){
+    case FUNC_MOVC: case FUNC_ADD: case FUNC_SUB: case FUNC_MUL: case FUNC_DIV:
+    case FUNC_AND: case FUNC_OR: case FUNC_XOR: case FUNC_LOAD: case FUNC_JAL:
+    case FUNC_FADD: case FUNC_SWAP:
+      return true;
+  }
+  return false;
+}
+
+bool bundle_sets_zero(int op){
+  return op == FUNC_ADD || op == FUNC_SUB || op == FUNC_MUL || op == FUNC_DIV;
+}
+
+/*
+ * Points every source of slot i at the youngest older producer in the
+ * bundle. Slots from base on came from one block, whose own producers were
+ * found when it was decoded; only the slots before base are searched.
+ */
+static void link_slot(struct Bundle* b, int i, int base, struct BlockOp* o){
+  struct BundleSlot* s = &b->slot[i];
+  s->dep1 = (o && o->dep1 != -1) ? base + o->dep1 : -1;
+  s->dep2 = (o && o->dep2 != -1) ? base + o->dep2 : -1;
+  s->dep_zero = (o && o->dep_zero != -1) ? base + o->dep_zero : -1;
+  for(int j=0;j<base;j++){
+    struct BundleSlot* p = &b->slot[j];
+    if(p->flags & BB_WRITES_RD){
+      if(!(o && o->dep1 != -1) && (s->flags & BB_READS_RS1) && p->ins.rd == s->ins.rs1)
+        s->dep1 = j;
+      if(!(o && o->dep2 != -1) && (s->flags & BB_READS_RS2) && p->ins.rd == s->ins.rs2)
+        s->dep2 = j;
+    }
+    if(!(o && o->dep_zero != -1) && (p->flags & BB_SETS_ZERO) && (s->flags & BB_READS_ZERO))
+      s->dep_zero = j;
+  }
+}
+
+/*
+ * Fills at most max slots starting at pc and returns the PC to fetch next cycle.
+ * Slots come from the basic-block cache already decoded and linked. Only
+ * control transfers go through the predictor; one whose successor is not
+ * pc + 4 ends the bundle, and so does HALT or the end of code memory.
+ */
+int bundle_fetch(struct Bundle* b, APEX_Instruction* code, int code_size, int pc, int max){
+  b->size = 0;
+  while(b->size < max){
+    struct BasicBlock* bb = bb_lookup(code, code_size, pc);
+    if(!bb)
+      break;
+    int base = b->size;
+    for(int k=0;k<bb->size && b->size < max;k++){
+      struct BlockOp* o = &bb->op[k];
+      struct BundleSlot* s = &b->slot[b->size];
+      s->ins = *o->ins;
+      s->pc = o->pc;
+      s->op = o->op;
+      s->flags = o->flags;
+      s->bp_seq = -1;
+      link_slot(b, b->size++, base, o);
+      if(o->flags & BB_CONTROL){
+        int next = bp_fetch(o->pc, o->ins->opcode, o->ins->rd, o->ins->rs1, o->ins->imm, &s->bp_seq);
+        if(next != o->pc + 4)
+          return next;
+      }
+      if(o->op == FUNC_HALT)
+        return o->pc + 4;
+    }
+    pc = b->slot[b->size - 1].pc + 4;
+  }
+  return pc;
+}
+
+void bundle_link(struct Bundle* b){   //  SLOTS REGROUPED BY THE FETCH BUFFER, THE BLOCK LINKS NO LONGER APPLY
+  for(int i=0;i<b->size;i++)
+    link_slot(b, i, i, NULL);
+}
+
+int fetch_buffer_room(struct FetchBuffer* fb){
+  return sim_config.fetch_buffer - fb->count;
+}
+
+void fetch_buffer_push(struct FetchBuffer* fb, struct Bundle* b){   //  CALLER CHECKED THE ROOM
+  for(int i=0;i<b->size;i++)
+    fb->slot[(fb->head + fb->count++) % FETCH_BUFFER_MAX] = b->slot[i];
+}
+
+void fetch_buffer_pop(struct FetchBuffer* fb, struct Bundle* b, int max){   //  OLDEST SLOTS FIRST, IN FETCH ORDER
+  b->size = 0;
+  while(b->size < max && fb->count){
+    b->slot[b->size++] = fb->slot[fb->head];
+    fb->head = (fb->head + 1) % FETCH_BUFFER_MAX;
+    fb->count--;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _APEX_BUNDLE_H_
+#define _APEX_BUNDLE_H_
+/**
+ *  bundle.h
+ *  Fetch bundles for an N-wide frontend
+ *
+ *  Fetch collects up to sim_config.width consecutive instructions per cycle,
+ *  ending the bundle after a predicted taken control transfer. Rename looks
+ *  up all slots of a bundle in the same cycle, so a source produced by an
+ *  older slot of the same bundle has to take that slot's new physical
+ *  register instead of the (stale) rename map entry. bundle_fetch() takes
+ *  those links from the basic-block cache, bundle_link() recomputes them
+ *  for bundles formed elsewhere.
+ *
+ *  With an instruction cache, fetch and decode are decoupled by the fetch
+ *  buffer: fetch appends whatever the I-cache delivered this cycle, decode
+ *  takes up to sim_config.width of the oldest slots.
+ */
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define MAX_WIDTH 8
+#define FETCH_BUFFER_MAX 64
+
+struct BundleSlot{
+  APEX_Instruction ins;
+  int pc;
+  int op;             // FUNC_* opcode
+  int flags;          // BB_* class flags
+  int dep1;           // Older slot producing rs1, -1 to read the rename map
+  int dep2;           // Older slot producing rs2
+  int dep_zero;       // Older slot setting the zero flag read by BZ/BNZ
+  int bp_seq;         // Prediction bp_fetch made for a control slot, -1 for none
+};
+
+struct Bundle{
+  int size;
+  struct BundleSlot slot[MAX_WIDTH];
+};
+
+struct FetchBuffer{
+  int head;
+  int count;
+  struct BundleSlot slot[FETCH_BUFFER_MAX];
+};
+
+int bundle_fetch(struct Bundle*, APEX_Instruction*, int, int, int);
+void bundle_link(struct Bundle*);
+bool bundle_writes_rd(int);
+bool bundle_sets_zero(int);
+int fetch_buffer_room(struct FetchBuffer*);
+void fetch_buffer_push(struct FetchBuffer*, struct Bundle*);
+void fetch_buffer_pop(struct FetchBuffer*, struct Bundle*, int);
+
+#endif
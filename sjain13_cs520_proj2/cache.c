@@ -0,0 +1,339 @@
+/*
+ *  cache.c
+ *  Set-associative cache timing model with LRU/PLRU replacement and MSHRs,
+ *  and the DRAM model behind the last cache level
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cache.h"
+
+bool cache_init(struct Cache* c, struct CacheConfig* cfg){
+  memset(c,0,sizeof(*c));
+  c->cfg = *cfg;
+  if(cfg->sets < 1 || cfg->ways < 1 || cfg->ways > 32 || cfg->line_size < 4 || cfg->mshrs < 1)
+    return false;
+  if(cfg->replacement == CACHE_PLRU && (cfg->ways & (cfg->ways - 1)))
+    return false;
+  c->lines = calloc(cfg->sets * cfg->ways,sizeof(struct CacheLine));
+  c->plru = calloc(cfg->sets,sizeof(unsigned));
+  c->mshr = calloc(cfg->mshrs,sizeof(struct Mshr));
+  return c->lines && c->plru && c->mshr;
+}
+
+void cache_free(struct Cache* c){
+  free(c->lines);
+  free(c->plru);
+  free(c->mshr);
+  c->lines = NULL;
+  c->plru = NULL;
+  c->mshr = NULL;
+}
+
+static void plru_touch(struct Cache* c, int set, int way){   //  POINT EVERY NODE ON THE PATH AWAY FROM way
+  int node = 1;
+  for(int half=c->cfg.ways/2;half>=1;half/=2){
+    bool right = way & half;
+    if(right)
+      c->plru[set] &= ~(1u << node);
+    else
+      c->plru[set] |= 1u << node;
+    node = node * 2 + right;
+  }
+}
+
+static int plru_victim(struct Cache* c, int set){
+  int node = 1;
+  int way = 0;
+  for(int half=c->cfg.ways/2;half>=1;half/=2){
+    bool right = c->plru[set] & (1u << node);
+    if(right)
+      way |= half;
+    node = node * 2 + right;
+  }
+  return way;
+}
+
+static void touch(struct Cache* c, int set, int way, unsigned long now){
+  c->lines[set * c->cfg.ways + way].last_use = now;
+  if(c->cfg.replacement == CACHE_PLRU)
+    plru_touch(c,set,way);
+}
+
+static int victim(struct Cache* c, int set){
+  struct CacheLine* l = &c->lines[set * c->cfg.ways];
+  int lru = 0;
+  for(int w=0;w<c->cfg.ways;w++){
+    if(!l[w].valid)
+      return w;
+    if(l[w].last_use < l[lru].last_use)
+      lru = w;
+  }
+  return c->cfg.replacement == CACHE_PLRU ? plru_victim(c,set) : lru;
+}
+
+static struct Mshr* free_mshr(struct Cache* c, unsigned long now){   //  RETIRES FINISHED FILLS FIRST
+  struct Mshr* found = NULL;
+  for(int m=0;m<c->cfg.mshrs;m++){
+    if(c->mshr[m].valid && c->mshr[m].ready <= now)
+      c->mshr[m].valid = false;
+    if(!c->mshr[m].valid && !found)
+      found = &c->mshr[m];
+  }
+  return found;
+}
+
+static long next_level(struct Cache* c, int address, bool write, unsigned long now){   //  CYCLE THE LINE ARRIVES FROM BELOW, -1 IF REFUSED
+  if(c->next)
+    return cache_access(c->next,address,write,now);
+  if(c->mem)
+    return dram_access(c->mem,address,now);
+  return now + c->cfg.miss_latency;
+}
+
+static int lookup(struct Cache* c, int line){   //  WAY HOLDING line, -1 ON A MISS
+  struct CacheLine* l = &c->lines[(line % c->cfg.sets) * c->cfg.ways];
+  for(int w=0;w<c->cfg.ways;w++){
+    if(l[w].valid && l[w].tag == line / c->cfg.sets)
+      return w;
+  }
+  return -1;
+}
+
+static long fill(struct Cache* c, int line, bool write, bool prefetch, unsigned long now){   //  ALLOCATE line ON A MISS, -1 IF NO MSHR HERE OR BELOW
+  int set = line % c->cfg.sets;
+  struct CacheLine* l = &c->lines[set * c->cfg.ways];
+  struct Mshr* m = free_mshr(c,now);
+  if(!m)
+    return -1;
+  int w = victim(c,set);
+  if(l[w].valid && l[w].dirty){   //  THE VICTIM LEAVES FIRST, A REFUSED WRITEBACK REFUSES THE FILL
+    if((c->next || c->mem) && next_level(c,(l[w].tag * c->cfg.sets + set) * c->cfg.line_size,true,now) == -1){
+      c->wb_refused++;
+      return -1;
+    }
+    c->writebacks++;
+    l[w].dirty = false;           //  BELOW NOW, NOT WRITTEN AGAIN IF THE READ IS REFUSED
+  }
+  long ready = next_level(c,line * c->cfg.line_size,false,now + c->cfg.hit_latency);
+  if(ready == -1)
+    return -1;
+  if(l[w].valid && l[w].prefetched)
+    c->pf_useless++;
+  l[w].valid = true;
+  l[w].dirty = write;
+  l[w].prefetched = prefetch;
+  l[w].tag = line / c->cfg.sets;
+  l[w].ready = ready;
+  touch(c,set,w,now);
+  m->valid = true;
+  m->line = line;
+  m->ready = ready;
+  return ready;
+}
+
+/*
+ * Accesses byte address at cycle now. Returns the cycle the data is
+ * available, or -1 when the access misses and every MSHR is busy.
+ * Writes allocate and mark the line dirty.
+ */
+long cache_access(struct Cache* c, int address, bool write, unsigned long now){
+  int line = (unsigned)address / c->cfg.line_size;
+  int set = line % c->cfg.sets;
+  int w = lookup(c,line);
+  long ready;
+
+  if(w != -1){
+    struct CacheLine* l = &c->lines[set * c->cfg.ways + w];
+    touch(c,set,w,now);
+    l->dirty |= write;
+    if(l->prefetched){          //  FIRST DEMAND USE OF A PREFETCHED LINE
+      l->prefetched = false;
+      c->pf_useful++;
+      if(l->ready > now)
+        c->pf_late++;
+    }
+    if(l->ready > now){
+      c->merged++;
+      ready = l->ready;
+    }
+    else{
+      c->hits++;
+      ready = now + c->cfg.hit_latency;
+    }
+  }
+  else{
+    ready = fill(c,line,write,false,now);
+    if(ready == -1){
+      c->mshr_full++;     //  REFUSED HERE OR BELOW, NOT AN ACCESS UNTIL A RETRY IS ACCEPTED
+      return -1;
+    }
+    c->misses++;
+  }
+  c->accesses++;
+  return ready;
+}
+
+/*
+ * Brings the line holding byte address in without a demand access. Dropped
+ * when the line is already present or no MSHR is free, demand misses keep
+ * priority. Returns true if a fill was started.
+ */
+bool cache_prefetch(struct Cache* c, int address, unsigned long now){
+  int line = (unsigned)address / c->cfg.line_size;
+  if(address < 0 || lookup(c,line) != -1)
+    return false;
+  if(fill(c,line,false,true,now) == -1){
+    c->pf_dropped++;
+    return false;
+  }
+  c->pf_issued++;
+  return true;
+}
+
+/*
+ * Coherence hooks for a snooping bus. A valid dirty line is Modified, a
+ * valid clean one Shared. cache_probe looks without touching replacement
+ * state or counters, cache_snoop writes a dirty copy back below and then
+ * keeps the line clean or drops it. Both return whether the line is held.
+ */
+bool cache_probe(struct Cache* c, int address, bool* dirty){
+  int line = (unsigned)address / c->cfg.line_size;
+  int w = lookup(c,line);
+  if(w == -1)
+    return false;
+  *dirty = c->lines[(line % c->cfg.sets) * c->cfg.ways + w].dirty;
+  return true;
+}
+
+bool cache_snoop(struct Cache* c, int address, bool invalidate, unsigned long now){
+  int line = (unsigned)address / c->cfg.line_size;
+  int w = lookup(c,line);
+  if(w == -1)
+    return false;
+  struct CacheLine* l = &c->lines[(line % c->cfg.sets) * c->cfg.ways + w];
+  if(l->dirty){
+    if((c->next || c->mem) && next_level(c,line * c->cfg.line_size,true,now) == -1){
+      c->wb_refused++;
+      return true;      //  STILL HELD AND DIRTY, THE SNOOP HAS TO BE RETRIED
+    }
+    c->writebacks++;
+    l->dirty = false;
+  }
+  if(invalidate){
+    if(l->prefetched)
+      c->pf_useless++;
+    l->valid = false;
+  }
+  return true;
+}
+
+void cache_print_stats(struct Cache* c){
+  printf("=======%s CACHE========\n",c->cfg.name);
+  printf(" | Geometry    | %d sets x %d ways x %dB, %s |\n",c->cfg.sets,c->cfg.ways,c->cfg.line_size,
+         c->cfg.replacement == CACHE_PLRU ? "PLRU" : "LRU");
+  printf(" | Accesses    | %lu |\n",c->accesses);
+  printf(" | Hits        | %lu |\n",c->hits);
+  printf(" | Misses      | %lu |\n",c->misses);
+  printf(" | Merged      | %lu |\n",c->merged);
+  printf(" | MSHR full   | %lu |\n",c->mshr_full);
+  printf(" | Writebacks  | %lu |\n",c->writebacks);
+  printf(" | WB refused  | %lu |\n",c->wb_refused);
+  if(c->accesses)
+    printf(" | Hit rate    | %.2f%% |\n",100.0 * c->hits / c->accesses);
+}
+
+bool cache_parse_geometry(struct CacheConfig* cfg, const char* value){   //  "SETS:WAYS:LINE:HIT:MSHRS"
+  int sets, ways, line, hit, mshrs;
+  if(sscanf(value,"%d:%d:%d:%d:%d",&sets,&ways,&line,&hit,&mshrs) != 5)
+    return false;
+  if(sets < 1 || ways < 1 || ways > 32 || line < 4 || hit < 1 || mshrs < 1 || mshrs > 64)
+    return false;
+  cfg->sets = sets;
+  cfg->ways = ways;
+  cfg->line_size = line;
+  cfg->hit_latency = hit;
+  cfg->mshrs = mshrs;
+  return true;
+}
+
+bool dram_init(struct Dram* d, struct DramConfig* cfg){
+  memset(d,0,sizeof(*d));
+  d->cfg = *cfg;
+  if(cfg->banks < 1 || cfg->row_size < 4 || cfg->burst < 1)
+    return false;
+  d->open_row = malloc(cfg->banks * sizeof(int));
+  d->bank_free = calloc(cfg->banks,sizeof(unsigned long));
+  if(!d->open_row || !d->bank_free)
+    return false;
+  for(int b=0;b<cfg->banks;b++)
+    d->open_row[b] = -1;
+  return true;
+}
+
+void dram_free(struct Dram* d){
+  free(d->open_row);
+  free(d->bank_free);
+  d->open_row = NULL;
+  d->bank_free = NULL;
+}
+
+/*
+ * Reads or writes the line holding byte address, the request reaching DRAM
+ * at cycle now. The bank is busy until its row is open, the line then waits
+ * for the shared bus. Returns the cycle the whole line has been transferred.
+ */
+long dram_access(struct Dram* d, int address, unsigned long now){
+  int row_index = (unsigned)address / d->cfg.row_size;
+  int bank = row_index % d->cfg.banks;
+  int row = row_index / d->cfg.banks;
+
+  unsigned long start = now > d->bank_free[bank] ? now : d->bank_free[bank];
+  unsigned long lat = d->cfg.t_cas;
+  if(d->open_row[bank] == row)
+    d->row_hits++;
+  else if(d->open_row[bank] == -1){
+    d->row_empty++;
+    lat += d->cfg.t_rcd;
+  }
+  else{
+    d->row_conflicts++;
+    lat += d->cfg.t_rp + d->cfg.t_rcd;
+  }
+  d->open_row[bank] = row;
+  d->bank_free[bank] = start + lat;
+
+  unsigned long data = start + lat;
+  if(d->bus_free > data){
+    d->bus_wait += d->bus_free - data;
+    data = d->bus_free;
+  }
+  d->bus_free = data + d->cfg.burst;
+  d->accesses++;
+  d->latency += d->bus_free - now;
+  return d->bus_free;
+}
+
+void dram_print_stats(struct Dram* d){
+  printf("=======DRAM========\n");
+  printf(" | Banks         | %d x %dB rows |\n",d->cfg.banks,d->cfg.row_size);
+  printf(" | Accesses      | %lu |\n",d->accesses);
+  printf(" | Row hits      | %lu |\n",d->row_hits);
+  printf(" | Row empty     | %lu |\n",d->row_empty);
+  printf(" | Row conflicts | %lu |\n",d->row_conflicts);
+  printf(" | Bus wait      | %lu |\n",d->bus_wait);
+  if(d->accesses)
+    printf(" | Avg latency   | %.2f |\n",(double)d->latency / d->accesses);
+}
+
+bool dram_parse(struct DramConfig* cfg, const char* value){   //  "BANKS:ROW:CAS:RCD:RP:BURST"
+  struct DramConfig c;
+  if(sscanf(value,"%d:%d:%d:%d:%d:%d",&c.banks,&c.row_size,&c.t_cas,&c.t_rcd,&c.t_rp,&c.burst) != 6)
+    return false;
+  if(c.banks < 1 || c.banks > 64 || c.row_size < 4 || c.t_cas < 0 || c.t_rcd < 0 || c.t_rp < 0 || c.burst < 1)
+    return false;
+  *cfg = c;
+  return true;
+}
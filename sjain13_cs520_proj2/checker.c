@@ -0,0 +1,86 @@
+/*
+ *  checker.c
+ *  Lockstep co-simulation of ROB commits against the functional model
+ *
+ *  Every instruction leaving the ROB head is retired in the functional
+ *  model as well; the committed PC, destination value, memory address/data
+ *  and, for a control instruction, the PC it continues at must agree,
+ *  otherwise the first mismatch is reported and the simulation loop stops.
+ *  When the core finishes, the reference must have reached HALT too, or be
+ *  about to leave the code the same way a program without HALT ends.
+ */
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "checker.h"
+#include "functional.h"
+
+static struct FuncState ref;
+static bool failed = false;
+static unsigned long checked = 0;
+
+bool checker_init(APEX_Instruction* code_memory, int code_memory_size){
+  failed = false;
+  checked = 0;
+  return func_init(&ref,code_memory,code_memory_size);
+}
+
+void checker_free(){
+  func_free(&ref);
+}
+
+static void report(struct CommitRecord* c, struct FuncRetire* r, const char* what, int got, int expected){
+  fprintf(stderr, "APEX_Checker : MISMATCH at commit #%lu pc(%d) %s : %s core=%d reference=%d\n",
+          checked + 1, c->pc, func_op_name(r->op), what, got, expected);
+  failed = true;
+}
+
+bool checker_retire(struct CommitRecord* c){   //  RETURNS FALSE ON THE FIRST MISMATCH
+  struct FuncRetire r;
+  if(failed)
+    return false;
+
+  int expected_pc = ref.pc;
+  if(!func_step(&ref,&r)){
+    fprintf(stderr, "APEX_Checker : MISMATCH at commit #%lu pc(%d) : reference model %s at pc(%d)\n",
+            checked + 1, c->pc, ref.halted ? "already halted" : "faulted", expected_pc);
+    failed = true;
+    return false;
+  }
+
+  if(c->pc != r.pc)
+    report(c,&r,"pc",c->pc,r.pc);
+  else if(r.writes_reg && c->dest_value != r.value)
+    report(c,&r,"dest value",c->dest_value,r.value);
+  else if(r.is_mem && c->mem_address != r.mem_address)
+    report(c,&r,"address",c->mem_address,r.mem_address);
+  else if(r.op == FUNC_STORE && c->store_data != r.store_data)
+    report(c,&r,"store data",c->store_data,r.store_data);
+  else if((r.op == FUNC_BZ || r.op == FUNC_BNZ || r.op == FUNC_JUMP || r.op == FUNC_JAL) && c->next_pc != ref.pc)
+    report(c,&r,"next pc",c->next_pc,ref.pc);
+
+  if(failed)
+    return false;
+  checked++;
+  return true;
+}
+
+bool checker_finish(){   //  THE CORE RAN OUT OF WORK, FALSE WHEN THE REFERENCE HAS MORE TO RUN
+  int index = (ref.pc - 4000) / 4;
+  if(failed || ref.halted || ref.pc < 4000 || (ref.pc - 4000) % 4 || index >= ref.code_size)
+    return !failed;
+  fprintf(stderr, "APEX_Checker : MISMATCH after commit #%lu : core finished, reference model %s at pc(%d)\n",
+          checked, ref.fault ? "faulted" : "still running", ref.pc);
+  failed = true;
+  return false;
+}
+
+bool checker_has_failed(){
+  return failed;
+}
+
+void checker_print_stats(){
+  printf("=======LOCKSTEP CHECKER========\n");
+  printf(" | Commits verified | %lu |\n",checked);
+  printf(" | Status           | %s |\n",failed ? "MISMATCH" : "OK");
+}
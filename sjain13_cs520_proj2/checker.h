@@ -0,0 +1,27 @@
+#ifndef _APEX_CHECKER_H_
+#define _APEX_CHECKER_H_
+/**
+ *  checker.h
+ *  Lockstep co-simulation of ROB commits against the functional model
+ */
+#include <stdbool.h>
+
+#include "cpu.h"
+
+/* What the out-of-order core retired from the ROB head */
+struct CommitRecord{
+  int pc;
+  int dest_value;     // Value written to the destination register, if any
+  int mem_address;    // Computed address for LOAD/STORE
+  int store_data;     // Data written by a STORE
+  int next_pc;        // PC the core continues at after BZ/BNZ/JUMP/JAL
+};
+
+bool checker_init(APEX_Instruction*, int);
+void checker_free();
+bool checker_retire(struct CommitRecord*);
+bool checker_finish();
+bool checker_has_failed();
+void checker_print_stats();
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ *  config.c
+ *  Parses the optional key=value simulator options
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "bpred.h"
+#include "bundle.h"
+#include "prefetch.h"
+#include "smt.h"
+
+struct SimConfig sim_config;
+
+void config_init(){   //  DEFAULTS BEFORE ANY OPTION IS PARSED
+  sim_config.checker = ENABLE_LOCKSTEP_CHECKER;
+  sim_config.bp_type = DEFAULT_BP_TYPE;
+  sim_config.bp_bits = DEFAULT_BP_BITS;
+  sim_config.bp_hist = 0;
+  sim_config.btb_bits = DEFAULT_BTB_BITS;
+  sim_config.ras_depth = DEFAULT_RAS_DEPTH;
+  sim_config.width = DEFAULT_WIDTH;
+  sim_config.commit_width = DEFAULT_COMMIT_WIDTH;
+  sim_config.mem_spec = ENABLE_MEM_SPECULATION;
+  sim_config.store_sets = DEFAULT_STORE_SETS;
+  sim_config.fu_pool = ENABLE_FU_POOL;
+  sim_config.fu[FU_INT] = (struct FuClass){ 1, 1, true };
+  sim_config.fu[FU_MUL] = (struct FuClass){ 1, 2, true };   // m1, m2
+  sim_config.fu[FU_DIV] = (struct FuClass){ 1, 4, true };   // d1 .. d4
+  fu_parse_ports(DEFAULT_FU_PORTS);
+  sim_config.l1d = ENABLE_L1D_CACHE;
+  sim_config.l1d_cfg = (struct CacheConfig){ "L1D", DEFAULT_L1D_SETS, DEFAULT_L1D_WAYS, DEFAULT_L1D_LINE, CACHE_LRU,
+                                             DEFAULT_L1D_HIT, DEFAULT_L1D_MISS, DEFAULT_L1D_MSHRS };
+  sim_config.prefetch = DEFAULT_PREFETCH;
+  sim_config.pf_degree = DEFAULT_PF_DEGREE;
+  sim_config.pf_distance = DEFAULT_PF_DISTANCE;
+  sim_config.atomic_latency = DEFAULT_ATOMIC_LATENCY;
+  sim_config.fence_latency = DEFAULT_FENCE_LATENCY;
+  sim_config.l1i = ENABLE_L1I_CACHE;
+  sim_config.l1i_cfg = (struct CacheConfig){ "L1I", 0, 0, 0, CACHE_LRU, 0, DEFAULT_L1I_MISS, 0 };
+  cache_parse_geometry(&sim_config.l1i_cfg,DEFAULT_L1I);
+  sim_config.fetch_buffer = DEFAULT_FETCH_BUFFER;
+  sim_config.l2 = ENABLE_L2_CACHE;
+  sim_config.l2_cfg = (struct CacheConfig){ "L2", 0, 0, 0, CACHE_LRU, 0, DEFAULT_L1D_MISS, 0 };
+  cache_parse_geometry(&sim_config.l2_cfg,DEFAULT_L2);
+  sim_config.dram = ENABLE_DRAM;
+  dram_parse(&sim_config.dram_cfg,DEFAULT_DRAM);
+  sim_config.threads = DEFAULT_THREADS;
+  sim_config.smt_fetch = DEFAULT_SMT_FETCH;
+  sim_config.smt_rob_partition = ENABLE_ROB_PARTITION;
+  for(int t=0;t<SMT_MAX_THREADS;t++)
+    sim_config.thread_program[t] = NULL;
+  sim_config.profile = NULL;
+  sim_config.interval = DEFAULT_INTERVAL;
+  sim_config.interval_file = DEFAULT_INTERVAL_FILE;
+}
+
+bool config_parse_option(const char* option){   //  RETURNS FALSE FOR AN UNKNOWN OR MALFORMED OPTION
+  char key[64];
+  const char* eq = strchr(option,'=');
+  if(!eq || eq == option || (size_t)(eq - option) >= sizeof(key))
+    return false;
+  strncpy(key,option,eq - option);
+  key[eq - option] = '\0';
+  const char* value = eq + 1;
+
+  if(!strcmp(key,"checker")){
+    sim_config.checker = atoi(value) != 0;
+    return true;
+  }
+  if(!strcmp(key,"bp")){
+    sim_config.bp_type = bp_parse_type(value);
+    return sim_config.bp_type != -1;
+  }
+  if(!strcmp(key,"bp_bits")){
+    sim_config.bp_bits = atoi(value);
+    return sim_config.bp_bits >= 2 && sim_config.bp_bits <= 20;
+  }
+  if(!strcmp(key,"bp_hist")){
+    sim_config.bp_hist = atoi(value);
+    return sim_config.bp_hist >= 0 && sim_config.bp_hist <= 64;
+  }
+  if(!strcmp(key,"btb_bits")){
+    sim_config.btb_bits = atoi(value);
+    return sim_config.btb_bits >= 0 && sim_config.btb_bits <= 16;
+  }
+  if(!strcmp(key,"ras_depth")){
+    sim_config.ras_depth = atoi(value);
+    return sim_config.ras_depth >= 1 && sim_config.ras_depth <= 64;
+  }
+  if(!strcmp(key,"width")){
+    sim_config.width = atoi(value);
+    return sim_config.width >= 1 && sim_config.width <= MAX_WIDTH;
+  }
+  if(!strcmp(key,"commit_width")){
+    sim_config.commit_width = atoi(value);
+    return sim_config.commit_width >= 1 && sim_config.commit_width <= MAX_WIDTH;
+  }
+  if(!strcmp(key,"mem_spec")){
+    sim_config.mem_spec = atoi(value) != 0;
+    return true;
+  }
+  if(!strcmp(key,"store_sets")){
+    sim_config.store_sets = atoi(value);
+    return sim_config.store_sets >= 0 && sim_config.store_sets <= 16;
+  }
+  if(!strcmp(key,"fu_pool")){
+    sim_config.fu_pool = atoi(value) != 0;
+    return true;
+  }
+  if(!strcmp(key,"int_fu"))
+    return fu_parse_class(FU_INT,value);
+  if(!strcmp(key,"mul_fu"))
+    return fu_parse_class(FU_MUL,value);
+  if(!strcmp(key,"div_fu"))
+    return fu_parse_class(FU_DIV,value);
+  if(!strcmp(key,"ports"))
+    return fu_parse_ports(value);
+  if(!strcmp(key,"l1d")){
+    sim_config.l1d = atoi(value) != 0;
+    return true;
+  }
+  if(!strcmp(key,"l1d_sets")){
+    sim_config.l1d_cfg.sets = atoi(value);
+    return sim_config.l1d_cfg.sets >= 1 && sim_config.l1d_cfg.sets <= 4096;
+  }
+  if(!strcmp(key,"l1d_ways")){
+    sim_config.l1d_cfg.ways = atoi(value);
+    return sim_config.l1d_cfg.ways >= 1 && sim_config.l1d_cfg.ways <= 32;
+  }
+  if(!strcmp(key,"l1d_line")){
+    sim_config.l1d_cfg.line_size = atoi(value);
+    return sim_config.l1d_cfg.line_size >= 4 && sim_config.l1d_cfg.line_size <= 256;
+  }
+  if(!strcmp(key,"l1d_repl")){
+    if(!strcmp(value,"lru"))
+      sim_config.l1d_cfg.replacement = CACHE_LRU;
+    else if(!strcmp(value,"plru"))
+      sim_config.l1d_cfg.replacement = CACHE_PLRU;
+    else
+      return false;
+    return true;
+  }
+  if(!strcmp(key,"l1d_hit")){
+    sim_config.l1d_cfg.hit_latency = atoi(value);
+    return sim_config.l1d_cfg.hit_latency >= 1 && sim_config.l1d_cfg.hit_latency <= 16;
+  }
+  if(!strcmp(key,"l1d_miss")){
+    sim_config.l1d_cfg.miss_latency = atoi(value);
+    return sim_config.l1d_cfg.miss_latency >= 0 && sim_config.l1d_cfg.miss_latency <= 1000;
+  }
+  if(!strcmp(key,"l1d_mshrs")){
+    sim_config.l1d_cfg.mshrs = atoi(value);
+    return sim_config.l1d_cfg.mshrs >= 1 && sim_config.l1d_cfg.mshrs <= 32;
+  }
+  if(!strcmp(key,"prefetch")){
+    sim_config.prefetch = pf_parse_type(value);
+    return sim_config.prefetch != -1;
+  }
+  if(!strcmp(key,"pf_degree")){
+    sim_config.pf_degree = atoi(value);
+    return sim_config.pf_degree >= 1 && sim_config.pf_degree <= 16;
+  }
+  if(!strcmp(key,"pf_distance")){
+    sim_config.pf_distance = atoi(value);
+    return sim_config.pf_distance >= 1 && sim_config.pf_distance <= 64;
+  }
+  if(!strcmp(key,"l1i")){
+    sim_config.l1i = strcmp(value,"0") != 0;
+    return !sim_config.l1i || !strcmp(value,"1") || cache_parse_geometry(&sim_config.l1i_cfg,value);
+  }
+  if(!strcmp(key,"atomic_latency")){
+    sim_config.atomic_latency = atoi(value);
+    return sim_config.atomic_latency >= 0 && sim_config.atomic_latency <= 100;
+  }
+  if(!strcmp(key,"fence_latency")){
+    sim_config.fence_latency = atoi(value);
+    return sim_config.fence_latency >= 0 && sim_config.fence_latency <= 100;
+  }
+  if(!strcmp(key,"l1i_miss")){
+    sim_config.l1i_cfg.miss_latency = atoi(value);
+    return sim_config.l1i_cfg.miss_latency >= 0 && sim_config.l1i_cfg.miss_latency <= 1000;
+  }
+  if(!strcmp(key,"fetch_buffer")){
+    sim_config.fetch_buffer = atoi(value);
+    return sim_config.fetch_buffer >= 1 && sim_config.fetch_buffer <= FETCH_BUFFER_MAX;
+  }
+  if(!strcmp(key,"l2")){
+    sim_config.l2 = strcmp(value,"0") != 0;
+    return !sim_config.l2 || !strcmp(value,"1") || cache_parse_geometry(&sim_config.l2_cfg,value);
+  }
+  if(!strcmp(key,"dram")){
+    sim_config.dram = strcmp(value,"0") != 0;
+    return !sim_config.dram || !strcmp(value,"1") || dram_parse(&sim_config.dram_cfg,value);
+  }
+  if(!strcmp(key,"threads")){
+    sim_config.threads = atoi(value);
+    return sim_config.threads >= 1 && sim_config.threads <= SMT_MAX_THREADS;
+  }
+  if(!strcmp(key,"smt_fetch")){
+    sim_config.smt_fetch = smt_parse_fetch(value);
+    return sim_config.smt_fetch != -1;
+  }
+  if(!strcmp(key,"smt_rob")){
+    if(!strcmp(value,"shared"))
+      sim_config.smt_rob_partition = false;
+    else if(!strcmp(value,"partitioned"))
+      sim_config.smt_rob_partition = true;
+    else
+      return false;
+    return true;
+  }
+  if(!strncmp(key,"thread",6) && key[6] >= '1' && key[6] < '0' + SMT_MAX_THREADS && key[7] == '\0'){
+    sim_config.thread_program[key[6] - '0'] = value;    //  POINTS INTO argv
+    return *value != '\0';
+  }
+  if(!strcmp(key,"profile")){
+    sim_config.profile = value;    //  POINTS INTO argv
+    return *value != '\0';
+  }
+  if(!strcmp(key,"interval")){
+    sim_config.interval = atoi(value);
+    return sim_config.interval >= 0;
+  }
+  if(!strcmp(key,"interval_file")){
+    sim_config.interval_file = value;    //  POINTS INTO argv
+    return *value != '\0';
+  }
+  return false;
+}
+
+/*
+ * Combinations every option is valid for on its own but the core cannot
+ * run. SMT threads fetch straight from their own code memory, so there is
+ * no per-thread fetch buffer for l1i=1, and the checker holds one
+ * functional model, not one per thread.
+ */
+bool config_check(){   //  CALLED ONCE EVERY OPTION IS PARSED
+  if(sim_config.threads > 1 && (sim_config.l1i || sim_config.checker)){
+    fprintf(stderr, "APEX_Error : threads>1 needs l1i=0 and checker=0\n");
+    return false;
+  }
+  return true;
+}
+
+void config_print_usage(){
+  fprintf(stderr, "APEX_Help : Options (key=value)\n");
+  fprintf(stderr, "  checker=0|1        verify every commit against the functional model\n");
+  fprintf(stderr, "  bp=none|bimodal|gshare|tage   BZ/BNZ direction predictor\n");
+  fprintf(stderr, "  bp_bits=N          log2 entries per predictor table (2-20)\n");
+  fprintf(stderr, "  bp_hist=N          global history bits (0-64, 0 = default)\n");
+  fprintf(stderr, "  btb_bits=N         log2 BTB entries for JUMP/JAL targets (0-16, 0 = off)\n");
+  fprintf(stderr, "  ras_depth=N        return address stack entries (1-64)\n");
+  fprintf(stderr, "  width=N            fetch/rename/dispatch width (1-8)\n");
+  fprintf(stderr, "  commit_width=N     ROB commits per cycle (1-8)\n");
+  fprintf(stderr, "  mem_spec=0|1       issue LOADs past unresolved STOREs, replay on a violation\n");
+  fprintf(stderr, "  store_sets=N       log2 store set table entries for mem_spec (0-16, 0 = off)\n");
+  fprintf(stderr, "  fu_pool=0|1        issue arithmetic through the functional unit pool\n");
+  fprintf(stderr, "  int_fu=C:L[:p|u]   C INT units of latency L, pipelined or unpipelined\n");
+  fprintf(stderr, "  mul_fu=C:L[:p|u]   same for MUL\n");
+  fprintf(stderr, "  div_fu=C:L[:p|u]   same for DIV\n");
+  fprintf(stderr, "  ports=I,M,D        issue ports and the classes each serves, e.g. IM,ID\n");
+  fprintf(stderr, "  l1d=0|1            model the L1 data cache\n");
+  fprintf(stderr, "  l1d_sets=N         L1D sets (1-4096)\n");
+  fprintf(stderr, "  l1d_ways=N         L1D associativity (1-32, power of two for plru)\n");
+  fprintf(stderr, "  l1d_line=N         L1D line size in bytes (4-256)\n");
+  fprintf(stderr, "  l1d_repl=lru|plru  L1D replacement policy\n");
+  fprintf(stderr, "  l1d_hit=N          L1D hit latency in cycles (1-16)\n");
+  fprintf(stderr, "  l1d_miss=N         extra cycles on an L1D miss (0-1000)\n");
+  fprintf(stderr, "  l1d_mshrs=N        outstanding L1D misses (1-32)\n");
+  fprintf(stderr, "  prefetch=none|nextline|stride   L1D prefetcher, needs l1d=1\n");
+  fprintf(stderr, "  pf_degree=N        prefetches per trigger (1-16)\n");
+  fprintf(stderr, "  pf_distance=N      lines or strides ahead of the access (1-64)\n");
+  fprintf(stderr, "  l1i=0|1|S:W:B:H:M  instruction cache and fetch buffer, sets:ways:line:hit:mshrs\n");
+  fprintf(stderr, "  atomic_latency=N   extra memory stage cycles of a FADD/SWAP (0-100)\n");
+  fprintf(stderr, "  fence_latency=N    extra memory stage cycles of a FENCE (0-100)\n");
+  fprintf(stderr, "  l1i_miss=N         extra cycles on an L1I miss with no L2 (0-1000)\n");
+  fprintf(stderr, "  fetch_buffer=N     fetch buffer slots between fetch and decode (1-64)\n");
+  fprintf(stderr, "  l2=0|1|S:W:B:H:M   unified L2 behind the L1I/L1D, sets:ways:line:hit:mshrs\n");
+  fprintf(stderr, "  dram=0|1|B:R:C:D:P:T  DRAM behind the last cache, banks:row bytes:CAS:RCD:RP:burst\n");
+  fprintf(stderr, "  threads=N          SMT hardware threads sharing the core (1-4), >1 needs l1i=0 and checker=0\n");
+  fprintf(stderr, "  smt_fetch=rr|icount   thread that fetches each cycle\n");
+  fprintf(stderr, "  smt_rob=shared|partitioned   ROB shared or split evenly between threads\n");
+  fprintf(stderr, "  threadN=FILE       program of thread N (1-3), default another copy of the input\n");
+  fprintf(stderr, "  profile=FILE       write a per-PC hotspot report to FILE at exit\n");
+  fprintf(stderr, "  interval=N         write a row of interval statistics every N cycles (0 = off)\n");
+  fprintf(stderr, "  interval_file=FILE CSV the interval rows go to, default " DEFAULT_INTERVAL_FILE "\n");
+}
@@ -0,0 +1,121 @@
+#ifndef _APEX_CONFIG_H_
+#define _APEX_CONFIG_H_
+/**
+ *  config.h
+ *  Simulator options selected on the command line
+ *
+ *  Options are passed after the three mandatory arguments as
+ *  key=value pairs, e.g.  ./apex_sim input.asm simulate 100 checker=1
+ */
+#include <stdbool.h>
+
+#include "fupool.h"
+#include "cache.h"
+
+/* Set this flag to 1 to run the lockstep checker by default */
+#define ENABLE_LOCKSTEP_CHECKER 0
+
+/* Branch predictor defaults, see bpred.h for the algorithms */
+#define DEFAULT_BP_TYPE 0       // BP_NONE
+#define DEFAULT_BP_BITS 10      // log2 of the entries per predictor table
+#define DEFAULT_BTB_BITS 0      // log2 of the BTB entries, 0 leaves JUMP/JAL unpredicted
+#define DEFAULT_RAS_DEPTH 8
+
+/* Superscalar widths, the defaults are the original scalar frontend with 2-wide commit */
+#define DEFAULT_WIDTH 1         // Fetch, rename and dispatch
+#define DEFAULT_COMMIT_WIDTH 2
+
+/* Functional unit pool, off by default so the single in/m1-m2/d1-d4 latches are used */
+#define ENABLE_FU_POOL 0
+#define DEFAULT_FU_PORTS "I,M,D"  // One issue port per class
+
+/* Set this flag to 1 to let LOADs issue past STOREs with unknown addresses */
+#define ENABLE_MEM_SPECULATION 0
+#define DEFAULT_STORE_SETS 0    // log2 of the store set table, 0 speculates without prediction
+
+/* Set this flag to 1 to model the L1 data cache, memory is otherwise always a hit */
+#define ENABLE_L1D_CACHE 0
+#define DEFAULT_L1D_SETS 64
+#define DEFAULT_L1D_WAYS 4
+#define DEFAULT_L1D_LINE 16     // Bytes, four words
+#define DEFAULT_L1D_HIT 1       // Cycles, 1 fits in the memory stage
+#define DEFAULT_L1D_MISS 10
+#define DEFAULT_L1D_MSHRS 4
+
+/* L1D prefetcher, see prefetch.h */
+#define DEFAULT_PREFETCH 0      // PF_NONE
+#define DEFAULT_PF_DEGREE 2     // Lines requested per trigger
+#define DEFAULT_PF_DISTANCE 1   // How many lines or strides ahead the first request is
+
+/* Extra cycles FADD/SWAP and FENCE hold the memory stage */
+#define DEFAULT_ATOMIC_LATENCY 2            // Read-modify-write
+#define DEFAULT_FENCE_LATENCY 1
+
+/* Set this flag to 1 to fetch through an instruction cache and a fetch buffer */
+#define ENABLE_L1I_CACHE 0
+#define DEFAULT_L1I "64:2:16:1:2"           // SETS:WAYS:LINE:HIT:MSHRS
+#define DEFAULT_L1I_MISS 10
+#define DEFAULT_FETCH_BUFFER 8              // Slots between fetch and decode
+
+/* Levels below the L1 caches, both off by default so an L1D miss costs DEFAULT_L1D_MISS */
+#define ENABLE_L2_CACHE 0
+#define DEFAULT_L2 "256:8:16:8:8"           // SETS:WAYS:LINE:HIT:MSHRS
+#define ENABLE_DRAM 0
+#define DEFAULT_DRAM "8:1024:10:10:10:4"    // BANKS:ROW:CAS:RCD:RP:BURST
+
+/* SMT, see smt.h; one thread is the original single-threaded core */
+#define SMT_MAX_THREADS 4
+#define DEFAULT_THREADS 1
+#define DEFAULT_SMT_FETCH 0                 // SMT_FETCH_RR
+#define ENABLE_ROB_PARTITION 0
+
+/* Interval statistics, see interval.h */
+#define DEFAULT_INTERVAL 0                  // Cycles per CSV row, 0 = off
+#define DEFAULT_INTERVAL_FILE "intervals.csv"
+
+struct SimConfig{
+  bool checker;     // Retire every ROB commit in the functional reference model
+  int bp_type;      // BZ/BNZ direction predictor
+  int bp_bits;
+  int bp_hist;      // Global history length, 0 picks the predictor's default
+  int btb_bits;     // JUMP/JAL target buffer, 0 = off
+  int ras_depth;
+  int width;        // Instructions fetched, renamed and dispatched per cycle
+  int commit_width; // ROB entries retired per cycle
+  bool mem_spec;    // Speculative LOAD issue with violation detection and replay
+  int store_sets;   // Memory dependence predictor for speculative LOADs, 0 = off
+  bool fu_pool;     // Issue INT/MUL/DIV arithmetic through the functional unit pool
+  struct FuClass fu[FU_NUM_CLASSES];
+  int ports;
+  int port_mask[FU_MAX_PORTS];      // Bit per FU class the port can issue to
+  bool l1d;         // LOAD/STORE timing through the L1 data cache
+  struct CacheConfig l1d_cfg;
+  int prefetch;     // L1D prefetcher, needs l1d
+  int pf_degree;
+  int pf_distance;
+  int atomic_latency;
+  int fence_latency;
+  bool l1i;         // Fetch through the instruction cache into the fetch buffer
+  struct CacheConfig l1i_cfg;
+  int fetch_buffer;
+  bool l2;          // Unified L2 behind the L1I and L1D
+  struct CacheConfig l2_cfg;
+  bool dram;        // DRAM timing behind the last cache level
+  struct DramConfig dram_cfg;
+  int threads;      // Hardware threads sharing the core
+  int smt_fetch;    // Fetch thread selection
+  bool smt_rob_partition;   // Each thread limited to its share of the ROB
+  const char* thread_program[SMT_MAX_THREADS];    // NULL runs another copy of the input file
+  const char* profile;      // Per-PC hotspot report written at exit, NULL = off
+  int interval;             // Cycles per interval statistics row, 0 = off
+  const char* interval_file;
+};
+
+extern struct SimConfig sim_config;
+
+void config_init();
+bool config_parse_option(const char*);
+bool config_check();
+void config_print_usage();
+
+#endif
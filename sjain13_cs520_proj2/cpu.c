@@ -2,15 +2,153 @@
 #include <stdlib.h>
 #include <string.h>
 #include<stdbool.h>
-#define ROB_SIZE 32
-#define IQ_SIZE 16
-#define LSQ_SIZE 32
 
 #include "cpu.h"
+#include "config.h"
+#include "functional.h"
+#include "checker.h"
+#include "bpred.h"
+#include "bundle.h"
+#include "bbcache.h"
+#include "fupool.h"
+#include "storeq.h"
+#include "memdep.h"
+#include "cache.h"
+#include "prefetch.h"
+#include "smt.h"
+#include "prof.h"
+#include "interval.h"
+#include "hosttimer.h"
 
 /* Set this flag to 1 to enable debug messages */
 #define ENABLE_DEBUG_MESSAGES 1
 
+struct Queue iq;                    // Issue queue, in dispatch order
+struct Queue lsq;                   // Load-store queue, in dispatch order
+struct ReorderBuffer rob;
+struct PhysicalRF prf;
+struct RegisterFile rf;             // Architectural registers of the resident thread
+struct CFQ cfq;
+int front = -1;                     // ROB head and tail, -1 when empty
+int rear = -1;
+int iq_rear = -1;                   // Last occupied IQ/LSQ/CFQ entry
+int lsq_rear = -1;
+int cf_rear = -1;
+struct Stage d;                     // Renamed instruction waiting to dispatch
+struct Stage in;                    // INT FU
+struct Stage m1, m2;                // MUL FU, two stages
+struct Stage d1, d2, d3, d4;        // DIV FU, four stages
+struct Stage me;                    // Memory stage
+int next_cod = 1;                   // Dispatch order of the next instruction
+bool fetch_halted = false;          // HALT dispatched, nothing more to fetch (single thread)
+bool frontend_squashed = false;     // Flushed this cycle, the frontend latches hold the wrong path
+static bool trace = false;          // Stage contents every cycle, display mode only
+
+struct RenameCheckpoint ckpt[RENAME_CHECKPOINTS];
+struct Bundle fetch_bundle;         // Fetched this cycle
+struct Bundle decode_bundle;        // In DRF, dependencies between slots linked
+struct Stage db[MAX_WIDTH];         // Renamed slots of decode_bundle, db_head is the next to dispatch
+struct RenameMap db_map[MAX_WIDTH];  // Map each checkpointed slot of db recovers to
+int db_head = 0;
+int db_size = 0;
+struct InstructionInfo fu_ins[FU_MAX_INFLIGHT];    // Instructions in flight in the FU pool, by slot
+struct FetchBuffer fetch_buffer;    // Between the I-cache and decode when sim_config.l1i
+unsigned long fetch_ready = 0;      // Fetch waits for the I-cache line of fetch_miss_line until this cycle
+int fetch_miss_line = -1;
+unsigned long icache_stall_cycles = 0;
+unsigned long fetch_buffer_full_cycles = 0;
+unsigned long decode_starved_cycles = 0;
+struct Cache l1i;
+struct Cache l1d;
+struct Cache l2;
+struct Dram dram;
+struct InstructionInfo parked[LSQ_SIZE];  // LOADs that missed in the L1D, waiting for their line
+long parked_ready[LSQ_SIZE];              // Cycle the line arrives, -1 while no MSHR was free
+int parked_count = 0;
+int mem_busy = 0;                         // Cycles an atomic or FENCE still holds the memory stage
+unsigned long sync_atomics = 0;
+unsigned long sync_fences = 0;
+unsigned long sync_busy_cycles = 0;
+unsigned long sync_blocked_loads = 0;     // Ready LOADs held back by an older FADD/SWAP/FENCE, per cycle
+int decode_tid = 0;                       // SMT thread of decode_bundle and of everything dispatched from it
+unsigned long rob_committed = 0;          // ROB entries retired, every thread
+unsigned long dispatch_iq_full = 0;       // Dispatch attempts refused by a full IQ
+
+static bool is_atomic(const char* op){
+  return !strcmp(op,"FADD") || !strcmp(op,"SWAP");
+}
+
+static bool is_sync(const char* op){
+  return is_atomic(op) || !strcmp(op,"FENCE");
+}
+
+static bool is_memory(const char* op){    //  TAKES AN LSQ ENTRY
+  return !strcmp(op,"LOAD") || !strcmp(op,"STORE") || is_sync(op);
+}
+
+static bool is_control(const char* op){   //  TAKES A CFQ ENTRY AND A CHECKPOINT
+  return !strcmp(op,"BZ") || !strcmp(op,"BNZ") || !strcmp(op,"JUMP") || !strcmp(op,"JAL");
+}
+
+static void ins_init(struct InstructionInfo* ins){
+  memset(ins,0,sizeof(*ins));
+  strcpy(ins->instruction.instruction_string," ");
+  ins->cod = -1;
+  ins->target_address = -1;
+}
+
+static bool is_empty(struct InstructionInfo* ins){
+  return !strcmp(ins->instruction.instruction_string," ");
+}
+
+static void stage_init(struct Stage* s){
+  ins_init(&s->instruction_info);
+  s->stalled = false;
+}
+
+static bool stage_will_write(struct Stage* s){   //  HOLDS AN INSTRUCTION
+  return !is_empty(&s->instruction_info);
+}
+
+static bool stage_is_ready(struct Stage* s){     //  FREE TO TAKE ONE
+  return is_empty(&s->instruction_info);
+}
+
+static bool instruction_will_write(struct InstructionInfo* ins){   //  WAS GIVEN A PHYSICAL DESTINATION
+  return ins->dest.name[0] != '\0';
+}
+
+static bool is_arithmetic_i(struct InstructionInfo* ins){   //  SETS THE ZERO FLAG
+  return bundle_sets_zero(func_decode_opcode(ins->operation));
+}
+
+static void phy_reg_init(struct Register* r){
+  memset(r,0,sizeof(*r));
+}
+
+static int phys_index(const char* name){   //  "P12" -> 12
+  return atoi(name + 1);
+}
+
+static void prf_init(){
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    phy_reg_init(&prf.P[k]);
+    sprintf(prf.P[k].name,"P%d",k);
+    prf.renamed[k][0] = '\0';
+    prf.latest[k] = false;
+  }
+}
+
+static void rf_init(){
+  for(int i=0;i<=ARF_SIZE-1;i++){
+    phy_reg_init(&rf.R[i]);
+    sprintf(rf.R[i].name,"R%d",i);
+    rf.R[i].status = true;
+  }
+  rf.zero.bit = false;
+  rf.zero.status = true;
+}
+
 /*
  * This function creates and initializes APEX cpu.
  */
@@ -29,50 +167,79 @@ APEX_cpu_init(const char* filename)
    }
 
   /* Initialize PC, Registers and all pipeline stages */
+  memset(cpu, 0, sizeof(*cpu));
   cpu->pc = 4000;
-  memset(cpu->regs, 0, sizeof(int) * 16);
-  memset(cpu->regs_valid, 1, sizeof(int) * 16);
-  memset(cpu->stage, 0, sizeof(CPU_Stage) * NUM_STAGES);
-  memset(cpu->data_memory, 0, sizeof(int) * 4000);
-
-  cpu->stage[EX].flush=0;
-
-  for (int i =0; i<16; i++) 
-  {
-    cpu->regs_valid[i] = 1;
-    cpu->buff_valid[i] = 1;
-  }
+  dm_init(&cpu->data_memory);
+  rf_init();
+  prf_init();
+  iq_init();
+  lsq_init();
+  cfq_init();
+  clear_rob();
+  stage_init(&d);
+  stage_init(&in);
+  stage_init(&m1);
+  stage_init(&m2);
+  stage_init(&d1);
+  stage_init(&d2);
+  stage_init(&d3);
+  stage_init(&d4);
+  stage_init(&me);
 
   /* Parse input file and create code memory */
   cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
 
-  if (!cpu->code_memory) 
+  if (!cpu->code_memory)
   {
     free(cpu);
     return NULL;
   }
 
-  if (ENABLE_DEBUG_MESSAGES) 
+  if (sim_config.checker && !checker_init(cpu->code_memory, cpu->code_memory_size))
   {
-    fprintf(stderr, "APEX_CPU : Initialized APEX CPU, loaded %d instructions\n", cpu->code_memory_size);
-    fprintf(stderr, "APEX_CPU : Printing Code Memory\n");
-    printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2", "imm");
+    free(cpu->code_memory);
+    free(cpu);
+    return NULL;
+  }
 
-    for (int i = 0; i < cpu->code_memory_size; ++i) 
-    {
-      printf("%-9s %-9d %-9d %-9d %-9d\n",
-             cpu->code_memory[i].opcode,
-             cpu->code_memory[i].rd,
-             cpu->code_memory[i].rs1,
-             cpu->code_memory[i].rs2,
-             cpu->code_memory[i].imm);
-    }
-}
+  bp_init();
+  bb_init();
+  checkpoint_init();
+  fu_init();
+  stq_init();
+  if (sim_config.store_sets)
+    md_init();
+  if ((sim_config.l1d || sim_config.l1i) && !memory_hierarchy_init())
+  {
+    fprintf(stderr, "APEX_Error : Invalid cache or DRAM geometry\n");
+    free(cpu->code_memory);
+    free(cpu);
+    return NULL;
+  }
+  if (sim_config.profile && (sim_config.threads > 1 || !prof_init(filename, cpu->code_memory_size)))
+  {
+    fprintf(stderr, "APEX_Error : profile= needs threads=1\n");
+    free(cpu->code_memory);
+    free(cpu);
+    return NULL;
+  }
+  if (sim_config.interval && !interval_open(sim_config.interval_file))
+  {
+    fprintf(stderr, "APEX_Error : Unable to open %s\n", sim_config.interval_file);
+    free(cpu->code_memory);
+    free(cpu);
+    return NULL;
+  }
+  if (sim_config.threads > 1 && !smt_init(cpu, filename, ROB_SIZE))
+  {
+    free(cpu->code_memory);
+    free(cpu);
+    return NULL;
+  }
 
-  /* Make all stages busy except Fetch stage, initally to start the pipeline */
-  for (int i = 1; i < NUM_STAGES; ++i) 
+  if (ENABLE_DEBUG_MESSAGES)
   {
-    cpu->stage[i].busy = 1;
+    fprintf(stderr, "APEX_CPU : Initialized APEX CPU, loaded %d instructions\n", cpu->code_memory_size);
   }
   return cpu;
 }
@@ -85,6 +252,18 @@ APEX_cpu_init(const char* filename)
  */
 void APEX_cpu_stop(APEX_CPU* cpu)
 {
+  if (sim_config.checker)
+    checker_free();
+  bp_free();
+  if (sim_config.store_sets)
+    md_free();
+  if (sim_config.l1d || sim_config.l1i)
+    memory_hierarchy_free();
+  if (sim_config.threads > 1)
+    smt_free(cpu);
+  if (sim_config.profile)
+    prof_free();
+  dm_free(&cpu->data_memory);
   free(cpu->code_memory);
   free(cpu);
 }
@@ -100,77 +279,39 @@ int get_code_index(int pc)
   return (pc - 4000) / 4;
 }
 
-static void print_instruction(CPU_Stage* stage)
-{
-  if (strcmp(stage->opcode, "STORE") == 0)
-   {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rs1, stage->rs2, stage->imm);
-   }
-
-   if (strcmp(stage->opcode, "LOAD") == 0) 
-  {
-    printf("%s,R%d,R%d,#%d ", stage->opcode, stage->rd, stage->rs1, stage->imm);
-  }
+static bool in_code(APEX_CPU* cpu, int pc){   //  pc NAMES AN INSTRUCTION OF THE CODE MEMORY
+  return pc >= 4000 && pc % 4 == 0 && get_code_index(pc) < cpu->code_memory_size;
+}
 
-  if (strcmp(stage->opcode, "MOVC") == 0) 
-  {
-    printf("%s,R%d,#%d ", stage->opcode, stage->rd, stage->imm);
-  }
-  
-  if (strcmp(stage->opcode, "ADD") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "SUB") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "AND") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "OR") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "XOR") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "MUL") == 0) 
-  {
-    printf("%s,R%d,R%d,R%d", stage->opcode, stage->rd, stage->rs1,stage->rs2);
-  }
-  
-  if (strcmp(stage->opcode, "BZ") == 0) 
-  {
-    printf("%s,#%d", stage->opcode, stage->imm);
-  }
-  
-  if (strcmp(stage->opcode, "BNZ") == 0) 
-  {
-    printf("%s,#%d", stage->opcode, stage->imm);
-  }
-  
-  if (strcmp(stage->opcode, "JUMP") == 0) 
-  {
-    printf("%s,R%d,#%d", stage->opcode,stage->rs1,stage->imm);
-  }
-  
-  if (strcmp(stage->opcode, "HALT") == 0)
-   {
-    printf("%s", stage->opcode);
-   }
+/*
+ * The opcode is cut to 15 characters, every real one is shorter; with three
+ * full-width ints the text then always fits in 64 bytes.
+ */
+static void format_instruction(char* buf, size_t n, const char* op, int rd, int rs1, int rs2, int imm)
+{
+  if (!strcmp(op, "STORE"))
+    snprintf(buf, n, "%.15s,R%d,R%d,#%d", op, rs1, rs2, imm);
+  else if (!strcmp(op, "LOAD") || !strcmp(op, "JAL"))
+    snprintf(buf, n, "%.15s,R%d,R%d,#%d", op, rd, rs1, imm);
+  else if (!strcmp(op, "MOVC"))
+    snprintf(buf, n, "%.15s,R%d,#%d", op, rd, imm);
+  else if (!strcmp(op, "BZ") || !strcmp(op, "BNZ"))
+    snprintf(buf, n, "%.15s,#%d", op, imm);
+  else if (!strcmp(op, "JUMP"))
+    snprintf(buf, n, "%.15s,R%d,#%d", op, rs1, imm);
+  else if (!strcmp(op, "HALT") || !strcmp(op, "FENCE"))
+    snprintf(buf, n, "%.15s", op);
+  else if (!strcmp(op, ""))
+    snprintf(buf, n, "EMPTY");
+  else
+    snprintf(buf, n, "%.15s,R%d,R%d,R%d", op, rd, rs1, rs2);
+}
 
-   if (strcmp(stage->opcode, "") == 0)
-   {
-    printf("EMPTY");
-   }
+static void print_instruction(CPU_Stage* stage)
+{
+  char buf[64];
+  format_instruction(buf, sizeof(buf), stage->opcode, stage->rd, stage->rs1, stage->rs2, stage->imm);
+  printf("%s", buf);
 }
 
 /* Debug function which dumps the cpu stage
@@ -183,51 +324,145 @@ static void print_stage_content(char* name, CPU_Stage* stage)
   printf("\n");
 }
 
+static void print_fu_content(char* name, struct Stage* s)   //  SAME FOR THE BACKEND, WITH THE RENAMED OPERANDS
+{
+  if (stage_is_ready(s))
+  {
+    printf("%-15s: EMPTY\n", name);
+    return;
+  }
+  printf("%-15s: pc(%d) ", name, s->instruction_info.PC);
+  print_instruction_after_rename(&s->instruction_info);
+  printf("\n");
+}
+
+/*
+ * Fetches at most one I-cache line per cycle into the fetch buffer and
+ * returns the PC to fetch next. Nothing is fetched while a miss is
+ * outstanding or the buffer has no room.
+ */
+int fetch_into_buffer(APEX_CPU* cpu, int pc){
+  int room = fetch_buffer_room(&fetch_buffer);
+  int line = pc / l1i.cfg.line_size;
+  fetch_bundle.size = 0;
+  if(get_code_index(pc) >= cpu->code_memory_size)
+    return pc;
+  if((unsigned long)cpu->clock < fetch_ready){
+    icache_stall_cycles++;
+    return pc;
+  }
+  if(room <= 0){
+    fetch_buffer_full_cycles++;
+    return pc;
+  }
+  if(line != fetch_miss_line){      //  THE LINE WE WAITED FOR IS THERE NOW, DO NOT COUNT IT TWICE
+    long ready = cache_access(&l1i, pc, false, cpu->clock);
+    if(ready == -1 || ready > cpu->clock + 1){
+      fetch_ready = (ready == -1) ? cpu->clock + 1 : ready;
+      fetch_miss_line = line;
+      icache_stall_cycles++;
+      return pc;
+    }
+  }
+  fetch_miss_line = -1;
+
+  int max = (l1i.cfg.line_size - pc % l1i.cfg.line_size) / 4;
+  if(max < 1)
+    max = 1;
+  if(max > room)
+    max = room;
+  if(max > sim_config.width)
+    max = sim_config.width;
+  int next = bundle_fetch(&fetch_bundle, cpu->code_memory, cpu->code_memory_size, pc, max);
+  fetch_buffer_push(&fetch_buffer, &fetch_bundle);
+  return next;
+}
+
+static void latch_slot(CPU_Stage* stage, struct BundleSlot* slot){
+  stage->pc = slot->pc;
+  strcpy(stage->opcode, slot->ins.opcode);
+  stage->rd = slot->ins.rd;
+  stage->rs1 = slot->ins.rs1;
+  stage->rs2 = slot->ins.rs2;
+  stage->imm = slot->ins.imm;
+}
+
 /*
  *  Fetch Stage of APEX Pipeline implementation
  */
 int fetch(APEX_CPU* cpu)
 {
+  HOST_TIMER_SCOPE(HT_FETCH);
   CPU_Stage* stage = &cpu->stage[F];
-  if(cpu->stage[EX].flush==1)
+  int redirect_pc;
+  int tid = 0;
+  bool redirect = bp_take_redirect(&redirect_pc);
+  if(frontend_squashed)
   {
-     strcpy(cpu->stage[F].opcode, "");
-     printf("Fetch         : EMPTY\n");    
+    strcpy(stage->opcode, "");
+    frontend_squashed = false;
   }
-  
- else if (!stage->busy && !stage->stalled) 
-  {  
-    stage->pc = cpu->pc;
-
-    /* Index into code memory using this pc and copy all instruction fields into
-     * fetch latch
-     */
-    APEX_Instruction* current_ins = &cpu->code_memory[get_code_index(cpu->pc)];
-    strcpy(stage->opcode, current_ins->opcode);
-    stage->rd = current_ins->rd;
-    stage->rs1 = current_ins->rs1;
-    stage->rs2 = current_ins->rs2;
-    stage->imm = current_ins->imm;
-    stage->rd = current_ins->rd;
-
-  if(!cpu->stage[DRF].stalled)
+  if(sim_config.threads > 1)
   {
-    /* Update PC for next instruction */
-    cpu->pc += 4;
-
-    /* Copy data from fetch latch to decode latch*/
-    cpu->stage[DRF] = cpu->stage[F];
+    /* The thread picked this cycle is loaded into cpu->pc and cpu->code_memory */
+    int icount[SMT_MAX_THREADS];
+    int rob_count[SMT_MAX_THREADS];
+    count_thread_entries(icount, rob_count);
+    tid = smt_fetch_begin(cpu, redirect ? redirect_pc : -1, icount, rob_count);
+    if(tid == -1)
+    {
+      if (trace)
+        printf("%-15s: EMPTY\n", "Fetch");
+      return 0;
+    }
+  }
+  else if(redirect)      // Branch mispredicted last cycle, restart on the correct path
+  {
+    cpu->pc = redirect_pc;
+    fetch_halted = false;
   }
 
-    if (ENABLE_DEBUG_MESSAGES)
+  if(sim_config.l1i)
+  {
+    /* Decoupled frontend: the I-cache fills the fetch buffer even while decode is stalled,
+     * and decode only ever takes what the buffer holds */
+    strcpy(stage->opcode, "");
+    if(!fetch_halted && in_code(cpu, cpu->pc))
     {
-      print_stage_content("Fetch", stage);
+      cpu->pc = fetch_into_buffer(cpu, cpu->pc);
+      if(fetch_bundle.size)
+        latch_slot(stage, &fetch_bundle.slot[0]);
+      if(fetch_bundle.size && fetch_bundle.slot[fetch_bundle.size - 1].op == FUNC_HALT)
+        fetch_halted = true;      // Nothing past HALT goes into the buffer, a flush restarts fetch
+    }
+    if(!cpu->stage[DRF].stalled)
+    {
+      fetch_buffer_pop(&fetch_buffer, &decode_bundle, sim_config.width);
+      bundle_link(&decode_bundle);
+      if(decode_bundle.size)
+        latch_slot(&cpu->stage[DRF], &decode_bundle.slot[0]);
+      else
+      {
+        strcpy(cpu->stage[DRF].opcode, "");    // Bubble, nothing arrived from the I-cache
+        decode_starved_cycles++;
+      }
     }
+    if (trace)
+    {
+      if (strcmp(stage->opcode, ""))
+        print_stage_content("Fetch", stage);
+      else
+        printf("%-15s: EMPTY\n", "Fetch");
+    }
+  }
+  else if(fetch_halted || !in_code(cpu, cpu->pc))
+  {
+    strcpy(stage->opcode, "");
+    if (trace)
+      printf("%-15s: EMPTY\n", "Fetch");
   }
-  
-  else if(stage->stalled==1 || stage->busy==1)                // To stall fetch when MUL enters Execute stage
+  else
   {
-    /* Store current PC in fetch latch */
     stage->pc = cpu->pc;
 
     /* Index into code memory using this pc and copy all instruction fields into
@@ -239,584 +474,334 @@ int fetch(APEX_CPU* cpu)
     stage->rs1 = current_ins->rs1;
     stage->rs2 = current_ins->rs2;
     stage->imm = current_ins->imm;
-    stage->rd = current_ins->rd;
-    
-   if(ENABLE_DEBUG_MESSAGES)
+
+    if(!cpu->stage[DRF].stalled)
+    {
+      /* Fetch up to sim_config.width instructions, following the predicted direction of BZ/BNZ
+       * and the BTB/RAS target of JUMP/JAL; the bundle ends at a predicted taken transfer */
+      cpu->pc = bundle_fetch(&fetch_bundle, cpu->code_memory, cpu->code_memory_size, stage->pc, sim_config.width);
+
+      /* Copy data from fetch latch to decode latch*/
+      cpu->stage[DRF] = cpu->stage[F];
+      decode_bundle = fetch_bundle;
+      if(sim_config.threads > 1)
+      {
+        decode_tid = tid;
+        smt_fetched(tid, &fetch_bundle);
+      }
+    }
+
+    if (trace)
     {
       print_stage_content("Fetch", stage);
     }
   }
+  if(sim_config.threads > 1)
+    smt_fetch_end(cpu, tid);
   return 0;
 }
 
+/*
+ *  Rename. A source reads the physical register its architectural register
+ *  is mapped to, or the ARF when nothing in flight writes it. Every
+ *  instruction with a destination gets a free physical register, held
+ *  until it commits.
+ */
+static int find_mapping(int r){   //  PHYSICAL REGISTER WITH THE NEWEST VALUE OF Rr, -1 WHEN THE ARF HAS IT
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(prf.latest[k] && !strcmp(prf.renamed[k],rf.R[r].name))
+      return k;
+  }
+  return -1;
+}
+
+static void read_source(struct Register* src, int r){
+  if(r < 0 || r > ARF_SIZE-1)
+    return;
+  int k = find_mapping(r);
+  *src = (k == -1) ? rf.R[r] : prf.P[k];
+}
+
+/*
+ * BZ/BNZ read the zero flag of the youngest ADD/SUB/MUL/DIV before them.
+ * If it is still in flight its destination becomes src1 and the branch is
+ * woken with it; otherwise the architectural flag is already valid.
+ */
+static void read_zero(struct Register* src){
+  if(front != -1){
+    for(int i=rear;;i=(i == 0) ? ROB_SIZE-1 : i - 1){
+      if(rob.tid[i] == decode_tid && is_arithmetic_i(&rob.entry[i])){
+        *src = prf.P[phys_index(rob.entry[i].dest.name)];
+        src->status = src->zero.status;
+        return;
+      }
+      if(i == front)
+        break;
+    }
+  }
+  phy_reg_init(src);
+  src->zero = rf.zero;
+  src->status = true;
+}
+
+static void rename_dest(struct InstructionInfo* ins){   //  CALLER CHECKED A PHYSICAL REGISTER IS FREE
+  int k = 0;
+  while(prf.renamed[k][0] != '\0')
+    k++;
+  for(int j=0;j<=PRF_SIZE-1;j++){
+    if(!strcmp(prf.renamed[j],rf.R[ins->rd].name))
+      prf.latest[j] = false;
+  }
+  strcpy(prf.renamed[k],rf.R[ins->rd].name);
+  prf.latest[k] = true;
+  prf.P[k].value = 0;
+  prf.P[k].status = false;
+  prf.P[k].zero.bit = false;
+  prf.P[k].zero.status = false;
+  ins->dest = prf.P[k];
+}
+
+static void rename_instruction(struct InstructionInfo* ins){
+  int flags = bb_flags(func_decode_opcode(ins->operation));
+  phy_reg_init(&ins->src1);
+  phy_reg_init(&ins->src2);
+  ins->src1.status = true;    //  UNUSED OPERANDS ARE NEVER WAITED FOR
+  ins->src2.status = true;
+  if(flags & BB_READS_RS1)
+    read_source(&ins->src1, ins->rs1);
+  if(flags & BB_READS_RS2)
+    read_source(&ins->src2, ins->rs2);
+  if(flags & BB_READS_ZERO)
+    read_zero(&ins->src1);
+  if(flags & BB_WRITES_RD)
+    rename_dest(ins);
+}
+
+static void decode_instruction(struct InstructionInfo* ins, struct BundleSlot* slot){
+  ins_init(ins);
+  snprintf(ins->operation, sizeof(ins->operation), "%.7s", slot->ins.opcode);
+  format_instruction(ins->instruction.instruction_string, sizeof(ins->instruction.instruction_string),
+                     slot->ins.opcode, slot->ins.rd, slot->ins.rs1, slot->ins.rs2, slot->ins.imm);
+  ins->PC = slot->pc;
+  ins->rd = slot->ins.rd;
+  ins->rs1 = slot->ins.rs1;
+  ins->rs2 = slot->ins.rs2;
+  ins->literal = slot->ins.imm;
+}
+
+static bool needs_checkpoint(struct InstructionInfo* ins){
+  return is_control(ins->operation) || (sim_config.mem_spec && !strcmp(ins->operation,"LOAD"));
+}
+
+/*
+ * Renames every slot of decode_bundle into db, oldest first, or none of
+ * them when there are not enough free physical registers for the slots
+ * that write one. The map a slot needing a checkpoint recovers to is saved
+ * as soon as that slot is renamed; by dispatch the younger slots of the
+ * bundle have renamed too.
+ */
+static bool rename_bundle(){
+  int writers = 0;
+  int free_regs = 0;
+  for(int w=0;w<decode_bundle.size;w++){
+    if(decode_bundle.slot[w].flags & BB_WRITES_RD)
+      writers++;
+  }
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(prf.renamed[k][0] == '\0')
+      free_regs++;
+  }
+  if(writers > free_regs)
+    return false;
+  for(int w=0;w<decode_bundle.size;w++){
+    stage_init(&db[w]);
+    decode_instruction(&db[w].instruction_info, &decode_bundle.slot[w]);
+    rename_instruction(&db[w].instruction_info);
+    link_bundle_sources(w);
+    if(needs_checkpoint(&db[w].instruction_info)){
+      memcpy(db_map[w].renamed,prf.renamed,sizeof(prf.renamed));
+      memcpy(db_map[w].latest,prf.latest,sizeof(prf.latest));
+    }
+  }
+  db_head = 0;
+  db_size = decode_bundle.size;
+  return true;
+}
+
 /*
  *  Decode Stage of APEX Pipeline
  *
+ *  The DRF latch holds the first slot of decode_bundle. The whole bundle is
+ *  renamed in one cycle and then dispatched in order, as many slots per
+ *  cycle as find room; a new bundle is taken only once db is empty.
+ *
  *  Note : You are free to edit this function according to your
  *         implementation
  */
 int decode(APEX_CPU* cpu)
 {
+  HOST_TIMER_SCOPE(HT_DECODE);
   CPU_Stage* stage = &cpu->stage[DRF];
-  if(stage->stalled) 
+  if(frontend_squashed)
   {
-    stage->stalled = 0;
+    strcpy(stage->opcode, "");
   }
-  if(cpu->stage[EX].flush==1)
+  if(sim_config.threads > 1)
+    smt_select(decode_tid, &rf, prf.latest);    // Rename reads and writes the map of the decoding thread
+  if (trace)
   {
-     strcpy(cpu->stage[F].opcode, "");
-     printf("Decode        : EMPTY\n");    
+    if (strcmp(stage->opcode, ""))
+      print_stage_content("Decode/RF", stage);
+    else
+      printf("%-15s: EMPTY\n", "Decode/RF");
   }
-    
-  else if (!stage->busy && !stage->stalled) 
+  if(strcmp(stage->opcode, "") && db_size == 0 && rename_bundle())
   {
-    //STORE
-    if (strcmp(stage->opcode, "STORE") == 0) 
-    {
-    	//when load is in mem stage then free store in DRF that is unstall and validate.
-
-      stage->arithmetic_instr = 0;
-      //printf("\njyrfgfvhkfuvhkufgvrk: %s\n",cpu->stage[EX].opcode);
-      if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])        //Valid bits of regs checked for dependency
-    {
-        cpu->stage[F].stalled=0;
-        cpu->stage[DRF].stalled=0;
-        stage->rs1_value= cpu->regs[stage->rs1];
-        stage->rs2_value= cpu->regs[stage->rs2];
-    }
-    else if(!cpu->regs_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-        cpu->stage[F].stalled=0;
-        cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->buff[stage->rs1];  
-        stage->rs2_value=cpu->regs[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--;
-     /* cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;*/
-    }
+    strcpy(stage->opcode, "");
+  }
+  dispatch_and_issue();
+  stage->stalled = strcmp(stage->opcode, "") || db_size;
+  return 0;
+}
 
-    else  if(cpu->regs_valid[stage->rs1]  && !cpu->regs_valid[stage->rs2] )
-    {
-    	 cpu->stage[F].stalled=0;
-        cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->regs[stage->rs1];  
-        stage->rs2_value=cpu->buff[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--; 
-    }
+void link_bundle_sources(int w){   //  SOURCES PRODUCED EARLIER IN THE SAME BUNDLE READ THAT SLOT'S NEW DEST, NOT THE STALE MAP
+  struct BundleSlot* slot = &decode_bundle.slot[w];
+  struct InstructionInfo* ins = &db[w].instruction_info;
+  if(slot->dep1 != -1)
+    ins->src1 = db[slot->dep1].instruction_info.dest;
+  if(slot->dep2 != -1)
+    ins->src2 = db[slot->dep2].instruction_info.dest;
+  if(slot->dep_zero != -1){   //  BZ/BNZ WAIT FOR THE FLAG, THE ROB DOES NOT HOLD ITS PRODUCER YET
+    ins->src1 = db[slot->dep_zero].instruction_info.dest;
+    ins->src1.status = ins->src1.zero.status;
+  }
+}
 
-    else  if(!cpu->regs_valid[stage->rs1]  && !cpu->regs_valid[stage->rs2] )
-    {
-    	 cpu->stage[F].stalled=0;
-        cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->buff[stage->rs1];  
-        stage->rs2_value=cpu->buff[stage->rs2]; 
-        cpu->buff_valid[stage->rd]--; 
+void dispatch_and_issue(){    //  DISPATCH THE RENAMED BUNDLE IN ORDER, STOP AT THE FIRST SLOT THAT FINDS NO ROOM
+  HOST_TIMER_SCOPE(HT_DISPATCH);
+  while(db_head < db_size){
+    d = db[db_head];
+    if(!dispatch_one(db_head)){
+      stage_init(&d);
+      return;       //  THE REST WAITS IN db FOR NEXT CYCLE
     }
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }}
-  
-    /*stage->rs1_value= cpu->regs[stage->rs1];
-    stage->rs2_value= cpu->regs[stage->rs2];*/
+    db_head++;
+  }
+  db_head = db_size = 0;
+}
 
-    }
-  
-  // LOAD
-  if (strcmp(stage->opcode, "LOAD") == 0) 
-  {
-    stage->arithmetic_instr = 0;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1])       
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];                
-      cpu->regs_valid[stage->rd]--; 
-      printf("%d\n", cpu->regs_valid[stage->rd]);
-    }
+static void wake(struct Register* src, struct Register* dest){   //  ONLY A SOURCE STILL WAITING FOR THIS REGISTER TAKES ITS VALUE
+  if(!src->status && !strcmp(src->name,dest->name))
+    *src = *dest;
+}
 
-    else if(cpu->buff_valid[stage->rs1])       
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->buff[stage->rs1];
-      cpu->buff_valid[stage->rd]--;
-    }
+static void refresh_source(struct Register* src){   //  THE PRODUCER MAY HAVE COMPLETED WHILE THE INSTRUCTION WAITED TO DISPATCH
+  if(!src->status && src->name[0] == 'P')
+    wake(src, &prf.P[phys_index(src->name)]);
+}
 
+bool dispatch_one(int w){
+  struct InstructionInfo* ins = &d.instruction_info;
+  if(sim_config.threads > 1 && smt_rob_full(decode_tid, rob_entries_of(decode_tid)))
+    return false;
+  if(no_rob_slot() || lsq_full_if_mem(ins))
+    return false;
+  if(is_control(ins->operation) && (cfq_full() || free_checkpoint(false) == -1))
+    return false;     //  A CONTROL INSTRUCTION NEVER DISPATCHES WITHOUT A CHECKPOINT TO RECOVER FROM
+  if(strcmp(ins->operation,"HALT") && strcmp(ins->operation,"FENCE") && iq_full()){
+    dispatch_iq_full++;
+    return false;
+  }
+  refresh_source(&ins->src1);
+  refresh_source(&ins->src2);
+  ins->cod = next_cod++;
+  if(!strcmp(ins->operation,"HALT")){
+    if(sim_config.threads > 1)
+      smt_halt(decode_tid);   //  ONLY THIS THREAD STOPS FETCHING
     else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }
-       }   
-  }
+      fetch_halted = true;
+    goto NO_MORE;
+  }
+  if(!strcmp(ins->operation,"FENCE"))    //  NOTHING TO READ OR ADDRESS, ONLY ORDERS THE LSQ
+    ins->target_address = 0;
+  if(is_memory(ins->operation))
+    enqueue_lsq(&d);
+  if(!strcmp(ins->operation,"STORE")){
+    stq_dispatch_store(ins->cod, ins->PC);
+    if(sim_config.store_sets)
+      md_dispatch_store(ins->cod, ins->PC);
+  }
+  if(!strcmp(ins->operation,"LOAD") && sim_config.mem_spec){
+    take_checkpoint(&d, &db_map[w]);      //  LETS IT ISSUE PAST UNRESOLVED STORES, RESTORED IF IT HAS TO REPLAY; NONE LEFT, IT WAITS FOR THEM
+    if(sim_config.store_sets)
+      md_dispatch_load(ins->cod, ins->PC);
+  }
+  if(is_control(ins->operation)){
+    enqueue_cfq(&d);
+    take_checkpoint(&d, &db_map[w]);
+    bp_dispatch(decode_bundle.slot[w].bp_seq, ins->cod);
+  }
+  if(strcmp(ins->operation,"FENCE"))
+    enqueue_iq(&d);
+  NO_MORE:
+  enqueue_rob(&d);
+  if(!strcmp(ins->operation,"HALT"))
+    rob.tag[rear] = 'c';      //  NOTHING TO EXECUTE, RETIRES WHEN IT REACHES THE HEAD
+  if(sim_config.threads > 1)
+    smt_dispatched(decode_tid, ins->PC);
+  stage_init(&d);
+  return true;
+}
 
-  //JUMP
-    if (strcmp(stage->opcode, "JUMP") == 0) 
-    {
-      stage->arithmetic_instr = 0;
-      if(cpu->regs_valid[stage->rs1]) {
-      	stage->rs1_value= cpu->regs[stage->rs1];
-  	  } else {
-  	  	stage->rs1_value=cpu->buff[stage->rs1];
-  	  }
-    }
+struct InstructionInfo get_ins_iq(int i){
+  if(sim_config.profile)
+    prof_issued(iq.ins[i].cod);
+  return iq.ins[i];
+}
 
-    //MOVC
-    if (strcmp(stage->opcode, "MOVC") == 0)
-     {
-      stage->arithmetic_instr = 0;                        // 0 is invalid for dependency
-      cpu->regs_valid[stage->rd]--;           
-    }
-  
-  // ADD
-  if (strcmp(stage->opcode, "ADD") == 0) 
-  {
-    stage->arithmetic_instr = 1;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])  
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;
-    }
+bool iq_has_int(int i){
+  return !iq_has_mul(i) && !iq_has_div(i);
+}
 
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2] )
-    {
-    	cpu->stage[F].stalled=0; 
-        cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->buff[stage->rs1];  
-        stage->rs2_value=cpu->regs[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--;
-    }
+bool iq_has_mul(int i){
+  return !strcmp(iq.ins[i].operation,"MUL");
+}
 
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2] )
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->regs[stage->rs1];  
-        stage->rs2_value=cpu->buff[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--; 
-    }
+bool iq_has_div(int i){
+  return !strcmp(iq.ins[i].operation,"DIV");
+}
 
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->buff_valid[stage->rs2] )
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->buff[stage->rs1];  
-        stage->rs2_value=cpu->buff[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--; 
-    }
+static bool iq_ready(struct InstructionInfo* ins){   //  WHAT THE FU NEEDS IS THERE
+  if(!strcmp(ins->operation,"STORE"))
+    return ins->src2.status;    //  ONLY THE BASE, THE DATA IS WAITED FOR IN THE LSQ
+  if(!strcmp(ins->operation,"LOAD") || is_atomic(ins->operation))
+    return ins->src1.status;
+  return ins->src1.status && ins->src2.status;
+}
 
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }
+struct InstructionInfo get_int_from_iq(){
+  struct InstructionInfo i;
+  for(int i=0;i<=IQ_SIZE-1;i++){
+    if(is_empty(&iq.ins[i]))
+      continue;
+    if(sim_config.fu_pool && fu_class_of(iq.ins[i].operation) != -1)   //  ARITHMETIC GOES TO THE POOL, in KEEPS BRANCHES AND ADDRESSES
+      continue;
+    if(iq_has_int(i) && !iq.ins[i].issued && iq_ready(&iq.ins[i])){
+      iq.ins[i].issued = true;
+      return get_ins_iq(i);
     }
-    /*stage->rs1_value= cpu->regs[stage->rs1];
-    stage->rs2_value= cpu->regs[stage->rs2];
-    cpu->regs_valid[stage->rd]--; */
   }
-  
-  // SUB
-  if (strcmp(stage->opcode, "SUB") == 0) 
-  {
-    stage->arithmetic_instr = 1;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])  
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;
-    }
-
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-       stage->rs1_value=cpu->buff[stage->rs1];  
-       stage->rs2_value=cpu->regs[stage->rs2]; 
-       cpu->regs_valid[stage->rd]--;
-    }
+  ins_init(&i);
+  return i;
+}
 
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-        stage->rs1_value=cpu->regs[stage->rs1];  
-        stage->rs2_value=cpu->buff[stage->rs2]; 
-        cpu->regs_valid[stage->rd]--; 
-    }
-
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-          stage->rs1_value=cpu->buff[stage->rs1];  
-          stage->rs2_value=cpu->buff[stage->rs2]; 
-          cpu->regs_valid[stage->rd]--; 
-    }
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }
-}
-    /*stage->rs1_value= cpu->regs[stage->rs1];
-    stage->rs2_value= cpu->regs[stage->rs2];
-    cpu->regs_valid[stage->rd]--; */
-    }
-  
-  // AND
-  if (strcmp(stage->opcode, "AND") == 0) 
-  {
-    stage->arithmetic_instr = 0;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])  
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;
-    }
-
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->regs[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--;
-    }
-
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->regs[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }  
-}
-   /* stage->rs1_value= cpu->regs[stage->rs1];
-    stage->rs2_value= cpu->regs[stage->rs2];
-    cpu->regs_valid[stage->rd]--; */
-    }
-  
-  // OR
-  if (strcmp(stage->opcode, "OR") == 0) 
-  {
-    stage->arithmetic_instr = 0;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])  
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;
-    }
-
-    else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->regs[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->regs[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-   else  if(!cpu->regs_valid[stage->rs1]  && !cpu->regs_valid[stage->rs2])
-   {
-   	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    } }
-    }
-  
-  // XOR
-  if (strcmp(stage->opcode, "XOR") == 0) 
-  {
-    stage->arithmetic_instr = 0;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])                // For Dependency
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;  
-    }
-     else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->regs[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->regs[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-   else  if(cpu->buff_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-   {
-   	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }
-}
-      /*stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--; */
-    }
-  
-  // MUL
-  if (strcmp(stage->opcode, "MUL") == 0) 
-  {
-    stage->arithmetic_instr = 1;
-    if(strcmp(cpu->stage[EX].opcode,"LOAD")==0 && (cpu->stage[EX].rd==stage->rs1 || cpu->stage[EX].rd==stage->rs2)) {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-  }else{
-    if(cpu->regs_valid[stage->rs1] && cpu->regs_valid[stage->rs2])  
-    {
-      cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value= cpu->regs[stage->rs1];
-      stage->rs2_value= cpu->regs[stage->rs2];
-      cpu->regs_valid[stage->rd]--;  
-    }
-     else  if(cpu->buff_valid[stage->rs1]  && cpu->regs_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->regs[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-    else  if(cpu->regs_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-    {
-    	cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->regs[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-    }
-
-   else  if(cpu->buff_valid[stage->rs1]  && cpu->buff_valid[stage->rs2])
-   {
-   	  cpu->stage[F].stalled=0; 
-      cpu->stage[DRF].stalled=0;
-      stage->rs1_value=cpu->buff[stage->rs1];  
-      stage->rs2_value=cpu->buff[stage->rs2]; 
-      cpu->regs_valid[stage->rd]--; 
-   }
-
-    else
-    {
-      cpu->stage[F].stalled=1; 
-      cpu->stage[DRF].stalled=1;
-    }
-}
-    /*stage->rs1_value= cpu->regs[stage->rs1];
-    stage->rs2_value= cpu->regs[stage->rs2];
-    cpu->regs_valid[stage->rd]--; */
-    }
-
-     //HALT
-    if(strcmp(stage->opcode, "HALT") == 0) 
-    {
-    if(!strcmp(rob.entry[front].operation,"HALT") && rob.tag[front]=='c' && !strcmp(me.instruction_info.instruction.instruction_string," ")){
-            dequeue_rob();
-            cpu->halt=1;}
-        stage->arithmetic_instr = 0;
-        cpu->stage[F].stalled = 1;
-        cpu->stage[F].pc = 0;
-        strcpy(cpu->stage[F].opcode, "");
-        cpu->ex_halt = 1;
-    }
-    if(!strcmp(rob.entry[front].operation,"HALT"))
-            rob.tag[front] = 'c';
-
-    //BZ and BNZ
-    if(strcmp(stage->opcode, "BZ") == 0 || strcmp(stage->opcode, "BNZ") == 0) 
-    {
-      stage->arithmetic_instr = 0;
-        if((cpu->stage[WB].arithmetic_instr == 1) || (cpu->stage[MEM].arithmetic_instr == 1)) 
-        {
-         stage->stalled = 1;
-        } 
-        else
-        {
-        stage->stalled = 0;
-        }
-    }
-
-
-    /* Copy data from decode latch to execute latch*/
-    cpu->stage[EX] = cpu->stage[DRF];
-
-    if(ENABLE_DEBUG_MESSAGES)
-    {
-      print_stage_content("Decode/RF", stage);
-  }
-  
-  }
-  
-  else
-   {  
-   if(ENABLE_DEBUG_MESSAGES)
-   {
-      print_stage_content("Decode/RF", stage);
-     }
-  } 
-  return 0;
-}
-
-void dispatch_and_issue(){
-  if(!iq_full()){ //ONCE JUMP IS DISPATCHED, FLUSH DRF AND FETCH AND STOP FETCHING BCUZ NO POINT
-    if(stage_will_write(&d) & !d.stalled){
-      d.instruction_info.cod = s.cycle +1;
-      if(!strcmp(d.instruction_info.operation,"HALT")){
-        PC = 9999;
-        stage_init(&f);
-        goto NO_MORE;
-      }
-      if(!strcmp(d.instruction_info.operation,"LOAD")||!strcmp(d.instruction_info.operation,"STORE")){
-        enqueue_lsq(&d);
-      }
-
-      if(!strcmp(d.instruction_info.operation,"BZ") || !strcmp(d.instruction_info.operation,"BNZ") || !strcmp(d.instruction_info.operation,"JUMP") || !strcmp(d.instruction_info.operation,"JAL")){
-        d.instruction_info.dest.zero.status = false;
-        enqueue_cfq(&d);
-      }
-
-      if(is_arthmetic(&d)){
-        d.instruction_info.dest.zero.status = false;
-        for(int i=0;i<=31;i++){
-          if(!strcmp(d.instruction_info.dest.name,prf.P[i].name))
-            prf.P[i].zero = d.instruction_info.dest.zero;
-        }
-      }
-      enqueue_iq(&d); 
-      NO_MORE:
-      enqueue_rob(&d);  
-      ins_init(&d.instruction_info);
-      dv=0;
-      dfetched=false;
-      flagfetched=0;
-    }
-   //  read_broadcasted_reg_lsq();
-    // read_broadcasted_reg_iq();
-  }
-}
-struct InstructionInfo get_ins_iq(int i){
-  return iq.ins[i];
-}
-
-struct InstructionInfo get_int_from_iq(){
-  struct InstructionInfo i;
-  for(int i=0;i<=IQ_SIZE-1;i++){
-    if(!strcmp(iq.ins[i].operation,"BZ") || !strcmp(iq.ins[i].operation,"BNZ")){
-      if(iq.ins[i].dest.zero.status && !iq.ins[i].issued){
-        iq.ins[i].issued = true;
-        return get_ins_iq(i);
-      }
-      else goto E;
-    }
-    if(iq.ins[i].src1.status && iq.ins[i].src2.status && iq_has_int(i) && !iq.ins[i].issued){
-      iq.ins[i].issued = true;
-      return get_ins_iq(i);
-    }
-    struct InstructionInfo get_mul_from_iq(){
+struct InstructionInfo get_mul_from_iq(){
   struct InstructionInfo i;
-  for(int i=0;i<=IQ_SIZE-1;i++){
-    if(!strcmp(iq.ins[i].operation,"BZ") || !strcmp(iq.ins[i].operation,"BNZ"))
-      goto E;
-
+  for(int i=0;i<=IQ_SIZE-1 && !sim_config.fu_pool;i++){    //  THE POOL ISSUES MUL ITSELF
     if(iq.ins[i].src1.status && iq.ins[i].src2.status && iq_has_mul(i) && !iq.ins[i].issued){
-      // return dequeue_iq(i);
       iq.ins[i].issued = true;
       return get_ins_iq(i);
     }
-  E:
-  ;
   }
   ins_init(&i);
   return i;
@@ -824,9 +809,7 @@ struct InstructionInfo get_int_from_iq(){
 
 struct InstructionInfo get_div_from_iq(){
   struct InstructionInfo i;
-  for(int i=0;i<=IQ_SIZE-1;i++){
-    if(!strcmp(iq.ins[i].operation,"BZ") || !strcmp(iq.ins[i].operation,"BNZ")) // BRANCH IS FOUND, IGNORE AND GOTO NEXT INSTRUCTIONS
-      continue;
+  for(int i=0;i<=IQ_SIZE-1 && !sim_config.fu_pool;i++){    //  THE POOL ISSUES DIV ITSELF
     if(iq.ins[i].src1.status && iq.ins[i].src2.status && iq_has_div(i) &&!iq.ins[i].issued){
       iq.ins[i].issued = true;
       return get_ins_iq(i);
@@ -835,248 +818,416 @@ struct InstructionInfo get_div_from_iq(){
   ins_init(&i);
   return i;
 }
-void forward_data_to_iq(struct Stage* from, struct Queue* to){
+
+void forward_data_to_iq(struct InstructionInfo* from){
+  HOST_TIMER_SCOPE(HT_IQ_BROADCAST);
   for(int i=0;i<=IQ_SIZE-1;i++){
-    if(!strcmp(to->ins[i].src1.name,from->instruction_info.dest.name)){
-      to->ins[i].src1.value = from->instruction_info.dest.value;
-      to->ins[i].src1.status = true;
-    }
-    if(!strcmp(to->ins[i].src2.name,from->instruction_info.dest.name)){
-      to->ins[i].src2.value = from->instruction_info.dest.value;
-      to->ins[i].src2.status = true;
-    }
+    wake(&iq.ins[i].src1, &from->dest);
+    wake(&iq.ins[i].src2, &from->dest);
   }
 }
 
-void forward_data_to_lsq(struct Stage* from, struct Queue* to){
+void forward_data_to_lsq(struct InstructionInfo* from){
+  HOST_TIMER_SCOPE(HT_LSQ_BROADCAST);
   for(int i=0;i<=LSQ_SIZE-1;i++){
-    if(!strcmp(to->ins[i].src1.name,from->instruction_info.dest.name)){
-      to->ins[i].src1.value = from->instruction_info.dest.value;
-      to->ins[i].src1.status = true;
+    wake(&lsq.ins[i].src1, &from->dest);
+    wake(&lsq.ins[i].src2, &from->dest);
+  }
+}
+
+void update_rob_tag(struct InstructionInfo* ins){
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] != 'u' && rob.entry[i].cod == ins->cod){
+      rob.tag[i]='e';
+      return;
     }
-    if(!strcmp(to->ins[i].src2.name,from->instruction_info.dest.name)){
-      to->ins[i].src2.value = from->instruction_info.dest.value;
-      to->ins[i].src2.status = true;
+  }
+}
+
+static void complete_rob_entry(struct InstructionInfo* ins){
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] != 'u' && rob.entry[i].cod == ins->cod){
+      rob.entry[i] = *ins;
+      rob.tag[i] = 'c';
+      return;
     }
   }
 }
-void load_bypass(struct InstructionInfo* ins){
-  int place=-1;
-  int top;
-  int load=-1;
-  struct InstructionInfo temp;
+
+/*
+ * An instruction finished: its ROB entry is complete and its result goes to
+ * the PRF and to every consumer still waiting for it, wherever it is.
+ */
+static void write_result(struct InstructionInfo* ins){
+  complete_rob_entry(ins);
+  if(!instruction_will_write(ins))
+    return;
+  prf.P[phys_index(ins->dest.name)] = ins->dest;
+  forward_data_to_iq(ins);
+  forward_data_to_lsq(ins);
+  for(int w=db_head;w<db_size;w++){
+    wake(&db[w].instruction_info.src1, &ins->dest);
+    wake(&db[w].instruction_info.src2, &ins->dest);
+  }
+}
+
+static void set_address(struct InstructionInfo* ins){   //  THE LSQ AND ROB ENTRIES LEARN THE ADDRESS THE INT FU COMPUTED
   for(int i=0;i<=LSQ_SIZE-1;i++){
-    if(lsq.ins[i].cod == ins->cod)
-      place = i;
-  }
-  if(place!=-1){
-  temp = lsq.ins[place];
-  for(int i=place-1;i>=0;i--){
-    if(!strcmp(lsq.ins[i].operation,"LOAD") && lsq.ins[i].target_address!=-1){
-      load = i;
+    if(lsq.ins[i].cod == ins->cod && !is_empty(&lsq.ins[i]))
+      lsq.ins[i].target_address = ins->target_address;
+  }
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] != 'u' && rob.entry[i].cod == ins->cod)
+      rob.entry[i].target_address = ins->target_address;
+  }
+}
+
+/*
+ * The INT FU finishes in one cycle: an arithmetic result, the address of a
+ * LOAD/STORE/FADD/SWAP, or the outcome of a control instruction.
+ */
+static void complete_int(){
+  struct InstructionInfo* ins = &in.instruction_info;
+  char* op = ins->operation;
+  if(!strcmp(op,"LOAD") || !strcmp(op,"STORE") || is_atomic(op)){
+    ins->target_address = (!strcmp(op,"STORE") ? ins->src2.value : ins->src1.value) + ins->literal;
+    set_address(ins);
+    if(!strcmp(op,"STORE")){
+      int load_pc;
+      int victim = stq_resolve_store(ins->cod, ins->target_address, &load_pc);
+      if(victim != -1){
+        if(sim_config.store_sets)
+          md_violation(ins->PC, load_pc);
+        replay_load(victim);
+      }
     }
   }
-  if(load!=-1){
-    for(int i=place;i>load;i--){
-      lsq.ins[i] = lsq.ins[i-1];
+  else if(!strcmp(op,"BZ") || !strcmp(op,"BNZ")){
+    complete_rob_entry(ins);
+    resolve_branch(ins);
+    dequeue_cfq(ins->cod);
+  }
+  else if(!strcmp(op,"JUMP") || !strcmp(op,"JAL")){
+    if(!strcmp(op,"JAL")){
+      ins->dest.value = ins->PC + 4;
+      ins->dest.status = true;
     }
-    lsq.ins[load+1] = temp;
+    write_result(ins);
+    resolve_jump(ins);
+    dequeue_cfq(ins->cod);
   }
   else{
-    top = 0;
-    for(int k=place;k>top;k--){
-      lsq.ins[k] = lsq.ins[k-1];
-    }
-    lsq.ins[top] = temp;
+    compute_fu_result(ins);
+    write_result(ins);
   }
+  stage_init(&in);
 }
+
+void resolve_branch(struct InstructionInfo* ins){   //  CHECK BZ/BNZ AGAINST ITS PREDICTION, FLUSH YOUNGER ON A MISPREDICT
+  bool taken = ins->src1.zero.bit;
+  if(!strcmp(ins->operation,"BNZ"))
+    taken = !taken;
+  if(bp_resolve(ins->cod, ins->PC, ins->PC + ins->literal, taken)){
+    if(sim_config.profile)
+      prof_mispredicted(ins->PC);
+    flush_due_to_branch(ins->cod);
+  }
 }
 
-void load_bypass1(int x,struct InstructionInfo* ins){
-  ins->dest.value = lsq.ins[x].src1.value;
-  for(int i=0;i<=ROB_SIZE-1;i++){
-    if(rob.entry[i].cod == ins->cod){
-      rob.entry[i].dest = ins->dest;
-      rob.tag[i] = 'c'; 
-    }
+void resolve_jump(struct InstructionInfo* ins){   //  CHECK JUMP/JAL AGAINST THE BTB/RAS TARGET, FLUSH YOUNGER ON A MISPREDICT
+  if(bp_resolve_target(ins->cod, ins->PC, ins->src1.value + ins->literal)){
+    if(sim_config.profile)
+      prof_mispredicted(ins->PC);
+    flush_due_to_branch(ins->cod);
   }
-  for(int i=0;i<=31;i++){
-    if(!strcmp(prf.P[i].name,ins->dest.name))
-      prf.P[i] = ins->dest;
-  }
-  for(int i=0;i<LSQ_SIZE-1;i++){
-    if(!strcmp(ins->dest.name,lsq.ins[i].src1.name))
-      lsq.ins[i].src1=ins->dest;
-    if(!strcmp(ins->dest.name,lsq.ins[i].src2.name))
-      lsq.ins[i].src2=ins->dest;
-  }
-  for(int i=0;i<IQ_SIZE-1;i++){
-    if(!strcmp(ins->dest.name,iq.ins[i].src1.name))
-      iq.ins[i].src1=ins->dest;
-    if(!strcmp(ins->dest.name,iq.ins[i].src2.name))
-      iq.ins[i].src2=ins->dest;
-  }
-  if(!strcmp(ins->dest.name,d.instruction_info.src1.name))
-    d.instruction_info.src1 = ins->dest;
-  if(!strcmp(ins->dest.name,d.instruction_info.src2.name))
-    d.instruction_info.src2 = ins->dest;
-  dequeue_lsq(ins);
-}
-void update_from_mem(){   //  UPDATE FROM MEM STAGE TO PRF, ROB AND UPDATE PRECISE STATE IF IT WAS BEFORE ANY BRANCH
-  for(int i=0;i<=ROB_SIZE-1;i++){
-    if(me.instruction_info.cod == rob.entry[i].cod){
-      rob.entry[i].dest.status=true;
-      rob.entry[i].dest.value = me.instruction_info.dest.value;
-      rob.tag[i]='c';
-    }
+}
+
+void checkpoint_init(){
+  for(int i=0;i<RENAME_CHECKPOINTS;i++)
+    ckpt[i].cod = -1;
+}
+
+int free_checkpoint(bool load){   //  A LOAD NEVER TAKES ONE OF THE CFQ_SIZE SLOTS KEPT FOR CONTROL INSTRUCTIONS
+  for(int i=load ? CFQ_SIZE : 0;i<(load ? RENAME_CHECKPOINTS : CFQ_SIZE);i++){
+    if(ckpt[i].cod == -1)
+      return i;
   }
-  void update_rob_tag(struct InstructionInfo* ins){
-  for(int i=0;i<=ROB_SIZE-1;i++){
-    if(rob.entry[i].cod == ins->cod){
-      rob.tag[i]='e';
-      return;
-    }
+  return -1;
+}
+
+/*
+ * Saves the rename map for a control instruction entering the CFQ, or for
+ * a LOAD that may issue past unresolved STOREs, as rename left it for that
+ * instruction. Returns false when no slot is free; a LOAD then issues
+ * non-speculatively.
+ */
+bool take_checkpoint(struct Stage* s, struct RenameMap* map){
+  bool load = !strcmp(s->instruction_info.operation,"LOAD");
+  int i = free_checkpoint(load);
+  if(i == -1)
+    return false;
+  ckpt[i].cod = s->instruction_info.cod;
+  ckpt[i].load = load;
+  ckpt[i].rob_index = (rear == -1 || rear == ROB_SIZE-1) ? 0 : rear + 1;    //  ENQUEUED IN THE ROB RIGHT AFTER THE CFQ
+  memcpy(ckpt[i].renamed,map->renamed,sizeof(map->renamed));
+  memcpy(ckpt[i].latest,map->latest,sizeof(map->latest));
+  return true;
+}
+
+bool has_checkpoint(int cod){
+  for(int i=0;i<RENAME_CHECKPOINTS;i++){
+    if(ckpt[i].cod == cod)
+      return true;
   }
+  return false;
 }
-void read_broadcasted_reg_iq(){
-  for(int i=0;i<=IQ_SIZE-1;i++){
-    for(int j=0;j<=31;j++){
-      if(!strcmp(iq.ins[i].src1.name,prf.P[j].name))
-        iq.ins[i].src1=prf.P[j];
 
-      if(!strcmp(iq.ins[i].src2.name,prf.P[j].name))
-        iq.ins[i].src2=prf.P[j];
+void release_checkpoint(int cod){
+  for(int i=0;i<RENAME_CHECKPOINTS;i++){
+    if(ckpt[i].cod == cod)
+      ckpt[i].cod = -1;
+  }
+}
+
+static void free_pr(const char* name){   //  RETURN A PHYSICAL REGISTER TO THE FREE LIST
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(!strcmp(prf.P[k].name,name)){
+      prf.renamed[k][0] = '\0';
+      prf.latest[k] = false;
     }
   }
 }
 
-void read_broadcasted_reg_lsq(){
-  for(int i=0;i<=LSQ_SIZE-1;i++){
-    for(int j=0;j<=31;j++){
-      if(!strcmp(lsq.ins[i].src1.name,prf.P[j].name))
-        lsq.ins[i].src1=prf.P[j];
+static void free_up_pr(struct InstructionInfo* ins){
+  if(instruction_will_write(ins))
+    free_pr(ins->dest.name);
+}
 
-      if(!strcmp(lsq.ins[i].src2.name,prf.P[j].name))
-        lsq.ins[i].src2=prf.P[j];
-    }
+static void squash_queue(struct InstructionInfo* q, int size, int* q_rear, int cod){   //  KEEP ONLY ENTRIES OLDER THAN cod, IN ORDER
+  int n=0;
+  for(int i=0;i<size;i++){
+    if(!is_empty(&q[i]) && q[i].cod <= cod)
+      q[n++] = q[i];
   }
+  for(int i=n;i<size;i++)
+    ins_init(&q[i]);
+  *q_rear = n-1;
+}
 
+static void squash_stage(struct Stage* st, int cod){
+  if(st->instruction_info.cod > cod)
+    stage_init(st);
 }
-for(int i=0;i<=ROB_SIZE-1;i++){
 
-    if(in.instruction_info.cod == rob.entry[i].cod && (!strcmp(in.instruction_info.operation,"JAL") || !strcmp(in.instruction_info.operation,"JUMP"))){ //IF INT WAS JUMP OR JAL
-      rob.entry[i].dest = in.instruction_info.dest;
-      rob.tag[i]='c';
-      }
+int rob_tid_of(int cod){   //  SMT THREAD OF THE ROB ENTRY WITH THE GIVEN cod
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] != 'u' && rob.entry[i].cod == cod)
+      return rob.tid[i];
+  }
+  return decode_tid;
+}
 
-    if(in.instruction_info.cod == rob.entry[i].cod && !strcmp(in.instruction_info.operation,"BZ")){ //IF INT WAS BZ
-      rob.entry[i].dest = in.instruction_info.dest;
-      dequeue_cfq(in.instruction_info.cod);
-      rob.tag[i]='c';
-    }
+int rob_entries_of(int tid){
+  int n = 0;
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] != 'u' && rob.tid[i] == tid)
+      n++;
+  }
+  return n;
+}
 
-    if(in.instruction_info.cod == rob.entry[i].cod && !strcmp(in.instruction_info.operation,"BNZ")){  //IF INT WAS BNZ
-      rob.entry[i].dest = in.instruction_info.dest;
-      dequeue_cfq(in.instruction_info.cod);
-      rob.tag[i]='c';
-    }
+void count_thread_entries(int* icount, int* rob_count){   //  PER THREAD, UNISSUED IQ/LSQ ENTRIES AND ROB ENTRIES
+  for(int t=0;t<SMT_MAX_THREADS;t++){
+    icount[t] = 0;
+    rob_count[t] = rob_entries_of(t);
   }
+  for(int i=0;i<=IQ_SIZE-1;i++){
+    if(!is_empty(&iq.ins[i]))
+      icount[rob_tid_of(iq.ins[i].cod)]++;
+  }
+  for(int i=0;i<=LSQ_SIZE-1;i++){
+    if(!is_empty(&lsq.ins[i]) && !lsq.ins[i].issued && lsq.ins[i].target_address != -1
+       && strcmp(lsq.ins[i].operation,"FENCE"))
+      icount[rob_tid_of(lsq.ins[i].cod)]++;   //  UNTIL ITS ADDRESS IS KNOWN A LOAD/STORE IS COUNTED IN THE IQ
+  }
+}
 
-  if((!strcmp(in.instruction_info.operation,"STORE") || !strcmp(in.instruction_info.operation,"LOAD")) && in.instruction_info.target_address!=-1 ){   //IF INTFU HAS LOAD OR STORE AND ADDRESS HAS BEEN CALCULATED
-    in.instruction_info.issued = false;
-    for(int i=0;i<=31;i++){
-      if(rob.entry[i].cod == in.instruction_info.cod){
-        if(rob.tag[i]!='c')
-        rob.tag[i] = 'w';
+/*
+ * A flush also drops the younger instructions of the other threads. Their
+ * rename maps may still point at the registers those instructions had just
+ * renamed; the newest surviving writer in the ROB becomes the mapping again,
+ * or the architectural register when there is none. Runs with tid resident.
+ */
+void repair_rename_map(int tid){
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(prf.renamed[k][0] == '\0')
+      prf.latest[k] = false;
+  }
+  if(front == -1)
+    return;
+  for(int i=front;;i=(i == ROB_SIZE-1) ? 0 : i + 1){
+    if(rob.tid[i] == tid && instruction_will_write(&rob.entry[i])){
+      int k = phys_index(rob.entry[i].dest.name);
+      for(int j=0;j<=PRF_SIZE-1;j++){
+        if(!strcmp(prf.renamed[j],prf.renamed[k]))
+          prf.latest[j] = false;
       }
+      prf.latest[k] = true;
     }
-    for(int i=0;i<=31;i++){
-        if(lsq.ins[i].cod == in.instruction_info.cod)
-          lsq.ins[i]=in.instruction_info;
-      }
-    dequeue_iq(&in.instruction_info);
+    if(i == rear)
+      break;
   }
 }
-for(int j=0;j<=ROB_SIZE-1;j++){
-      if(rob.entry[j].cod == b_cod && b_cod!=0){
-        st = j;
-      }
-    }
-    if(st!=0){
-      int max = arthmetic_cod_i(&rob.entry[st-1]);
-      for(int j=st-2;j>=0;j--){
-        if(arthmetic_cod_i(&rob.entry[j]) > max)
-          max=arthmetic_cod_i(&rob.entry[j]);
-      }
-      // ALRDY_THERE:
-      if(max!=0){
-        for(int k=0;k<=ROB_SIZE-1;k++){
-          if(rob.entry[k].cod == max && rob.tag[k] == 'c'){
-            iq.ins[i].dest.zero = rob.entry[k].dest.zero;
-            iq.ins[i].dest.zero.status = true;
-            return;
-          }
-        }
-      }
-      //  ROB FUNCTIONS
 
-void commit_to_arf(){   //  TO COMMIT FROM HEAD OF ROB TO ARCHITECTURAL REGISTER FILE
-  for(int k=0;k<=31;k++){
-    if(!strcmp(prf.P[k].name,rob.entry[front].dest.name) && strcmp(rob.entry[front].operation,"STORE")){
-      prf.P[k] = rob.entry[front].dest;
-      for(int i=0;i<=15;i++){
-        if(!strcmp(prf.renamed[k],rf.R[i].name)){
-          rf.R[i].value =prf.P[k].value;
-          if(is_arithmetic_i(&rob.entry[front]))
-            rf.R[i].zero.bit = prf.P[k].zero.bit; ///////////////////REVIEW
-        }
+/*
+ * Recovers from a mispredicted control instruction with the given cod. The
+ * rename map saved when it entered the CFQ is restored in one step; ROB, IQ,
+ * LSQ and FU entries are squashed by age instead of being walked one by one.
+ */
+void flush_due_to_branch(int cod){
+  struct RenameCheckpoint* c = NULL;
+  int owner = 0;
+  for(int i=0;i<RENAME_CHECKPOINTS;i++){
+    if(ckpt[i].cod == cod)
+      c = &ckpt[i];
+  }
+  if(!c){     //  DISPATCH GUARANTEES ONE FOR EVERY CONTROL INSTRUCTION AND SPECULATIVE LOAD
+    fprintf(stderr, "APEX_Error : No rename checkpoint to recover cod %d\n", cod);
+    exit(1);
+  }
+
+  if(sim_config.threads > 1){   //  THE CHECKPOINT IS THE OWNER THREAD'S MAP
+    owner = rob_tid_of(cod);
+    smt_flush_begin(owner);
+    smt_enter(owner, &rf, prf.latest);
+  }
+  memcpy(prf.latest,c->latest,sizeof(prf.latest));
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(c->renamed[k][0] == '\0')
+      prf.renamed[k][0] = '\0';
+  }
+
+  if(front != -1 && rear != c->rob_index){    //  DROP EVERYTHING AFTER THE OWNER, FREEING WHAT IT RENAMED
+    int i = c->rob_index;
+    do{
+      i = (i == ROB_SIZE-1) ? 0 : i + 1;
+      if(sim_config.threads > 1)
+        smt_squashed(rob.tid[i], rob.entry[i].PC);
+      if(sim_config.profile)
+        prof_squashed(rob.entry[i].PC);
+      free_up_pr(&rob.entry[i]);
+      ins_init(&rob.entry[i]);
+      rob.tag[i] = 'u';
+    }while(i != rear);
+    rear = c->rob_index;
+  }
+  for(int w=db_head;w<db_size;w++)      //  RENAMED, NOT DISPATCHED YET
+    free_up_pr(&db[w].instruction_info);
+  for(int k=0;k<=PRF_SIZE-1;k++){
+    if(prf.renamed[k][0] == '\0')
+      prf.latest[k] = false;
+  }
+
+  squash_queue(iq.ins,IQ_SIZE,&iq_rear,cod);
+  squash_queue(lsq.ins,LSQ_SIZE,&lsq_rear,cod);
+  squash_stage(&in,cod);
+  squash_stage(&m1,cod);
+  squash_stage(&m2,cod);
+  squash_stage(&d1,cod);
+  squash_stage(&d2,cod);
+  squash_stage(&d3,cod);
+  squash_stage(&d4,cod);
+  squash_stage(&me,cod);
+  fu_squash_younger(cod);
+  stq_squash_younger(cod);
+  if(sim_config.store_sets)
+    md_squash_younger(cod);
+  if(sim_config.l1d)
+    squash_parked(cod);
+  stage_init(&d);
+  db_head = db_size = 0;
+  fetch_bundle.size = decode_bundle.size = 0;
+  fetch_buffer.count = 0;
+  fetch_ready = 0;
+  fetch_miss_line = -1;
+  fetch_halted = false;
+  frontend_squashed = true;
+
+  for(int i=0;i<RENAME_CHECKPOINTS;i++){
+    if(ckpt[i].cod > cod && ckpt[i].load)
+      release_checkpoint(ckpt[i].cod);
+    else if(ckpt[i].cod > cod)
+      dequeue_cfq(ckpt[i].cod);
+  }
+
+  if(sim_config.threads > 1){
+    smt_leave(&rf, prf.latest);
+    for(int t=0;t<sim_config.threads;t++){
+      if(smt_flush_end(t)){
+        smt_enter(t, &rf, prf.latest);
+        repair_rename_map(t);
+        smt_leave(&rf, prf.latest);
       }
-      break;
     }
   }
-  if(is_arithmetic_i(&rob.entry[front]))
-    last_arthmetic = rob.entry[front];
 }
+
+void cfq_init(){
+  for(int i=0;i<=CFQ_SIZE-1;i++){
+    ins_init(&cfq.entry[i]);
+    cfq.tag[i] = 'u';
+  }
+  cf_rear = -1;
+}
+
+bool cfq_full(){
+  return cf_rear == CFQ_SIZE-1;
+}
+
+void enqueue_cfq(struct Stage* s){
+  if(cfq_full())
+    return;
+  cfq.entry[++cf_rear] = s->instruction_info;
+  cfq.tag[cf_rear] = 'w';
+}
+
 void dequeue_cfq(int cod){
-  if(cf_front == -1 && cf_rear == -1){
+  release_checkpoint(cod);
+  for(int i=0;i<=cf_rear;i++){
+    if(cfq.entry[i].cod != cod)
+      continue;
+    for(int j=i;j<cf_rear;j++){
+      cfq.entry[j] = cfq.entry[j+1];
+      cfq.tag[j] = cfq.tag[j+1];
+    }
+    ins_init(&cfq.entry[cf_rear]);
+    cfq.tag[cf_rear--] = 'u';
     return;
   }
-  int place;
-  for(int i=0;i<7;i++){
-    if(cfq.entry[i].cod == cod)
-      place = i;
-  }
-  for(int i=place;i<7;i++){
-    cfq.entry[i]=cfq.entry[i+1];
-    cfq.p_s[i] = cfq.p_s[i+1];
-    cfq.tag[i] = cfq.tag[i+1];
-  }
+}
+
+bool iq_full(){
+  return iq_rear == IQ_SIZE-1;
+}
 
-  cfq.tag[7] = 'u';
-  ins_init(&cfq.entry[7]);
-  phy_reg_init(&cfq.p_s[7]);
+bool lsq_full_if_mem(struct InstructionInfo* ins){
+  return is_memory(ins->operation) && lsq_rear == LSQ_SIZE-1;
 }
 
 void enqueue_iq(struct Stage* s){
-  if(iq_front==0 && iq_rear==IQ_SIZE-1){
+  if(iq_full())
     return;
-  }
-  if(iq_front==-1)
-    iq_front=0;
-  iq_rear=iq_rear+1;
-  iq.ins[iq_rear]=s->instruction_info;
+  iq.ins[++iq_rear]=s->instruction_info;
 }
 
 void enqueue_lsq(struct Stage* s){
-  if(lsq_front==0 && lsq_rear==LSQ_SIZE-1){
+  if(lsq_rear == LSQ_SIZE-1)
     return;
-  }
-  if(lsq_front==-1)
-    lsq_front=0;
   lsq.ins[++lsq_rear]=s->instruction_info;
 }
+
 int enqueue_rob(struct Stage* s){
-  if((front == 0 && rear ==  ROB_SIZE -1) || (front == rear+1)){
+  if(no_rob_slot()){
     return 0;
   }
   else{
@@ -1088,30 +1239,259 @@ int enqueue_rob(struct Stage* s){
       rear = rear + 1;
     rob.entry[rear] = s->instruction_info;
     rob.tag[rear]='w';
+    rob.tid[rear] = decode_tid;
     return 1;
   }
 }
 
 struct InstructionInfo get_ins_lsq(int i){  //GET INSTRUCITON FROM LSQ
+  if(sim_config.profile)
+    prof_issued(lsq.ins[i].cod);
   return lsq.ins[i];
 }
 
+/*
+ * A LOAD may issue unless the youngest older STORE to its address has no
+ * data yet, or an older STORE address is still unknown and the LOAD has no
+ * checkpoint to replay from.
+ */
+bool load_can_issue(struct InstructionInfo* ins){
+  int store_cod;
+  bool unresolved;
+  int found = stq_search(ins->cod, ins->target_address, &store_cod, &unresolved);
+  if(unresolved && !(sim_config.mem_spec && has_checkpoint(ins->cod)))
+    return false;
+  if(unresolved && sim_config.store_sets && md_must_wait(ins->cod))    //  PREDICTED TO DEPEND ON AN UNRESOLVED STORE
+    return false;
+  if(found == STQ_FORWARD){
+    for(int k=0;k<=LSQ_SIZE-1;k++){
+      if(lsq.ins[k].cod == store_cod && !lsq.ins[k].src1.status)
+        return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * FADD/SWAP leave the LSQ only at the ROB head, so every older STORE has
+ * written memory and no younger LOAD has read it. The read-modify-write is
+ * done here in one step and then holds the memory stage for atomic_latency
+ * more cycles, plus the time to get the L1D line writable on a miss.
+ */
+void execute_atomic(APEX_CPU* cpu, struct InstructionInfo* ins){
+  int old = dm_read(&cpu->data_memory, ins->target_address);
+  dm_write(&cpu->data_memory, ins->target_address, !strcmp(ins->operation,"FADD") ? old + ins->src2.value : ins->src2.value);
+  ins->dest.value = old;
+  ins->dest.status = true;
+  mem_busy = sim_config.atomic_latency;
+  if(sim_config.l1d && dm_valid(ins->target_address)){
+    long ready = cache_access(&l1d, ins->target_address * 4, true, cpu->clock);
+    mem_busy += ready == -1 ? 1 : ready - cpu->clock - 1;
+  }
+  sync_atomics++;
+}
+
+bool sync_port_busy(){   //  COUNTS DOWN THE CYCLES AN ATOMIC OR FENCE STILL OWNS THE PORT
+  if(mem_busy == 0)
+    return false;
+  mem_busy--;
+  sync_busy_cycles++;
+  return true;
+}
+
+void sync_print_stats(){
+  printf("=======SYNCHRONIZATION========\n");
+  printf(" | Atomics             | %lu |\n",sync_atomics);
+  printf(" | Fences              | %lu |\n",sync_fences);
+  printf(" | Memory stage cycles | %lu |\n",sync_busy_cycles);
+  printf(" | LOADs held back     | %lu |\n",sync_blocked_loads);
+}
+
+/*
+ * Reads from the youngest older STORE to the address, else from memory. A
+ * wrong-path LOAD may compute any address; it reads 0 instead of raising
+ * the data memory fault, which only a committed access may do.
+ */
+void execute_load(APEX_CPU* cpu, struct InstructionInfo* ins){
+  int store_cod;
+  int source = -1;
+  bool unresolved;
+  ins->dest.value = dm_valid(ins->target_address) ? dm_read(&cpu->data_memory, ins->target_address) : 0;
+  if(stq_search(ins->cod, ins->target_address, &store_cod, &unresolved) == STQ_FORWARD){
+    for(int k=0;k<=LSQ_SIZE-1;k++){
+      if(lsq.ins[k].cod == store_cod){
+        ins->dest.value = lsq.ins[k].src1.value;
+        source = store_cod;
+      }
+    }
+  }
+  ins->dest.status = true;
+  stq_load_issued(ins->cod, ins->PC, ins->target_address, source, unresolved);
+}
+
+/*
+ * A STORE resolved to the address a younger LOAD already read past it.
+ * Everything younger than the LOAD is squashed through the LOAD's
+ * checkpoint and the LOAD goes back into the LSQ to execute again.
+ */
+void replay_load(int cod){
+  flush_due_to_branch(cod);
+  stq_retire_load(cod);
+  if(sim_config.store_sets)
+    md_replayed();
+  if(sim_config.l1d)
+    squash_parked(cod - 1);   //  THE LOAD ITSELF MAY STILL BE WAITING ON ITS MISS
+  if(me.instruction_info.cod == cod)
+    stage_init(&me);
+  for(int i=0;i<=ROB_SIZE-1;i++){
+    if(rob.tag[i] == 'u' || rob.entry[i].cod != cod)
+      continue;
+    struct Stage replay;
+    rob.entry[i].dest.status = false;
+    rob.entry[i].issued = false;
+    rob.tag[i] = 'w';
+    replay.instruction_info = rob.entry[i];
+    replay.instruction_info.src1.status = true;   //  THE ADDRESS IS KNOWN, NOTHING LEFT TO WAIT FOR
+    replay.instruction_info.src2.status = true;
+    enqueue_lsq(&replay);     //  LEFT THE LSQ WHEN IT ISSUED, EVERYTHING STILL THERE IS OLDER
+    prf.P[phys_index(rob.entry[i].dest.name)].status = false;
+    bp_replay(cod, rob.entry[i].PC + 4);
+  }
+}
+
+static bool init_l1(struct Cache* c, struct CacheConfig* cfg){   //  THE L2 IF THERE IS ONE, ELSE STRAIGHT TO DRAM
+  if(!cache_init(c, cfg))
+    return false;
+  c->next = sim_config.l2 ? &l2 : NULL;
+  c->mem = (!sim_config.l2 && sim_config.dram) ? &dram : NULL;
+  return true;
+}
+
+bool memory_hierarchy_init(){   //  L1I/L1D, THEN THE OPTIONAL SHARED L2 AND DRAM BEHIND WHATEVER LEVEL IS LAST
+  if(sim_config.dram && !dram_init(&dram, &sim_config.dram_cfg))
+    return false;
+  if(sim_config.l2){
+    if(!cache_init(&l2, &sim_config.l2_cfg))
+      return false;
+    l2.mem = sim_config.dram ? &dram : NULL;
+  }
+  if(sim_config.l1i && !init_l1(&l1i, &sim_config.l1i_cfg))
+    return false;
+  pf_init();
+  return !sim_config.l1d || init_l1(&l1d, &sim_config.l1d_cfg);
+}
+
+void memory_hierarchy_free(){
+  if(sim_config.l1i)
+    cache_free(&l1i);
+  if(sim_config.l1d)
+    cache_free(&l1d);
+  if(sim_config.l2)
+    cache_free(&l2);
+  if(sim_config.dram)
+    dram_free(&dram);
+}
+
+void memory_hierarchy_print_stats(){
+  if(sim_config.l1i){
+    cache_print_stats(&l1i);
+    printf("=======FETCH BUFFER========\n");
+    printf(" | Slots              | %d |\n",sim_config.fetch_buffer);
+    printf(" | I-cache stalls     | %lu |\n",icache_stall_cycles);
+    printf(" | Buffer full        | %lu |\n",fetch_buffer_full_cycles);
+    printf(" | Decode starved     | %lu |\n",decode_starved_cycles);
+  }
+  if(sim_config.l1d)
+    cache_print_stats(&l1d);
+  if(sim_config.l1d && sim_config.prefetch != PF_NONE)
+    pf_print_stats(&l1d);
+  if(sim_config.l2)
+    cache_print_stats(&l2);
+  if(sim_config.dram)
+    dram_print_stats(&dram);
+}
+
+/*
+ * The L1D only models timing, the value was already read by execute_load.
+ * A LOAD that misses leaves the memory stage and waits in parked until its
+ * line arrives, so younger LSQ entries keep using the port meanwhile. STOREs
+ * never wait, the write is absorbed once the line is allocated.
+ */
+void l1d_access(APEX_CPU* cpu){
+  struct InstructionInfo* ins = &me.instruction_info;
+  bool store = !strcmp(ins->operation,"STORE");
+  if(!store && strcmp(ins->operation,"LOAD"))
+    return;
+  if(!dm_valid(ins->target_address))    //  WRONG PATH, NOTHING TO CACHE
+    return;
+  unsigned long useful = l1d.pf_useful;
+  long ready = cache_access(&l1d, ins->target_address * 4, store, cpu->clock);
+  bool hit = ready != -1 && ready <= cpu->clock + 1;     //  DONE WITHIN THE MEMORY STAGE
+  if(!store && sim_config.prefetch != PF_NONE)
+    pf_train(&l1d, ins->PC, ins->target_address * 4, !hit, l1d.pf_useful != useful, cpu->clock);
+  if(store || hit)
+    return;
+  parked[parked_count] = *ins;
+  parked_ready[parked_count++] = ready;
+  stage_init(&me);
+}
+
+void take_filled_load(APEX_CPU* cpu){   //  OLDEST PARKED LOAD WHOSE LINE HAS ARRIVED ENTERS THE MEMORY STAGE
+  int oldest = -1;
+  for(int i=0;i<parked_count;i++){
+    if(parked_ready[i] == -1)     //  RETRY THE MISS NOW THAT AN MSHR MAY BE FREE
+      parked_ready[i] = cache_access(&l1d, parked[i].target_address * 4, false, cpu->clock);
+    if(parked_ready[i] != -1 && parked_ready[i] <= cpu->clock && (oldest == -1 || parked[i].cod < parked[oldest].cod))
+      oldest = i;
+  }
+  if(oldest == -1)
+    return;
+  me.instruction_info = parked[oldest];
+  parked[oldest] = parked[--parked_count];
+  parked_ready[oldest] = parked_ready[parked_count];
+}
+
+void squash_parked(int cod){
+  for(int i=0;i<parked_count;){
+    if(parked[i].cod > cod){
+      parked[i] = parked[--parked_count];
+      parked_ready[i] = parked_ready[parked_count];
+    }
+    else
+      i++;
+  }
+}
+
+static bool at_rob_head(int cod){
+  return front != -1 && rob.entry[front].cod == cod;
+}
+
 struct InstructionInfo get_ins_from_lsq(){  //GET INSTRUCTION FROM LSQ AFTER CHECKING
-  struct InstructionInfo ins; 
+  struct InstructionInfo ins;
   bool load_go = true;
-  for(int i=0;i<=LSQ_SIZE-1;i++){
-    if(!strcmp(lsq.ins[i].operation,"STORE")){
-      if(lsq.ins[i].src1.status && lsq.ins[i].src2.status && lsq.ins[i].target_address!=-1 && !lsq.ins[i].issued && (rob.entry[front].cod==lsq.ins[i].cod)){
+  bool sync_older = false;    //  AN OLDER FADD/SWAP/FENCE HAS NOT ISSUED YET
+  for(int i=0;i<=lsq_rear;i++){
+    if(is_sync(lsq.ins[i].operation)){   //  AT THE ROB HEAD EVERY OLDER STORE HAS WRITTEN MEMORY
+      if(lsq.ins[i].src1.status && lsq.ins[i].src2.status && lsq.ins[i].target_address!=-1 && !lsq.ins[i].issued && at_rob_head(lsq.ins[i].cod)){
+        lsq.ins[i].issued = true;
+        return get_ins_lsq(i);
+      }
+      if(!lsq.ins[i].issued)
+        sync_older = true;
+    }
+    else if(!strcmp(lsq.ins[i].operation,"STORE")){
+      if(lsq.ins[i].src1.status && lsq.ins[i].src2.status && lsq.ins[i].target_address!=-1 && !lsq.ins[i].issued && at_rob_head(lsq.ins[i].cod)){
         lsq.ins[i].issued = true;
         return get_ins_lsq(i);
       }
     }
     else{
       if(lsq.ins[i].src1.status && lsq.ins[i].src2.status && lsq.ins[i].target_address!=-1 && !lsq.ins[i].issued){
-        for(int k=i-1;k>=0;k--){
-          if(!strcmp(lsq.ins[k].operation,"STORE") && lsq.ins[k].target_address==-1)
-            load_go=false;
+        if(sync_older){   //  YOUNGER LOADS WAIT FOR THE FENCE OR ATOMIC
+          sync_blocked_loads++;
+          goto NEXT;
         }
+        load_go = load_can_issue(&lsq.ins[i]);
         if(load_go){
           lsq.ins[i].issued = true;
           return get_ins_lsq(i);
@@ -1128,6 +1508,26 @@ struct InstructionInfo get_ins_from_lsq(){  //GET INSTRUCTION FROM LSQ AFTER CHE
   return ins;
 }
 
+static int next_pc_of(struct InstructionInfo* ins){   //  WHERE THE CORE WENT AFTER IT, FROM THE OPERANDS IT RESOLVED WITH
+  if(!strcmp(ins->operation,"JUMP") || !strcmp(ins->operation,"JAL"))
+    return ins->src1.value + ins->literal;
+  if(!strcmp(ins->operation,"BZ"))
+    return ins->src1.zero.bit ? ins->PC + ins->literal : ins->PC + 4;
+  if(!strcmp(ins->operation,"BNZ"))
+    return ins->src1.zero.bit ? ins->PC + 4 : ins->PC + ins->literal;
+  return ins->PC + 4;
+}
+
+void check_rob_head(){   //  RETIRE THE ROB HEAD IN THE REFERENCE MODEL AND COMPARE
+  struct CommitRecord c;
+  c.pc = rob.entry[front].PC;
+  c.dest_value = rob.entry[front].dest.value;
+  c.mem_address = rob.entry[front].target_address;
+  c.store_data = rob.entry[front].src1.value;
+  c.next_pc = next_pc_of(&rob.entry[front]);
+  checker_retire(&c);
+}
+
 void dequeue_rob(){
   struct InstructionInfo ins;
   ins_init(&ins);
@@ -1135,6 +1535,19 @@ void dequeue_rob(){
     return;
   }
   else{
+    if(sim_config.checker)
+      check_rob_head();
+    if(sim_config.threads > 1)
+      smt_retired(rob.tid[front]);
+    if(sim_config.profile)
+      prof_committed(rob.entry[front].cod, rob.entry[front].PC);
+    rob_committed++;
+    if(!strcmp(rob.entry[front].operation,"LOAD")){
+      stq_retire_load(rob.entry[front].cod);
+      if(sim_config.store_sets)
+        md_retire_load(rob.entry[front].cod);
+      release_checkpoint(rob.entry[front].cod);
+    }
     rob.entry[front] = ins;
     rob.tag[front]='u';
     if(front == rear){
@@ -1151,680 +1564,312 @@ void dequeue_rob(){
 }
 
 void dequeue_lsq(struct InstructionInfo* ins){    //  DEQUEUE THE INSTRUCTION PASSED AS THE ARGUMENT
-  int place;
-  int last;
-  for(int i=0;i<=LSQ_SIZE-1;i++){
-    if(ins->cod == lsq.ins[i].cod){
-      place =i;
-      ins_init(&lsq.ins[i]);
-    }
-  }
-  for(int i=place;i<=LSQ_SIZE-2;i++)
-    lsq.ins[i]=lsq.ins[i+1];
-  ins_init(&lsq.ins[LSQ_SIZE-1]);
-  for(int i=LSQ_SIZE-1;i>=0;i--){
-    if(!strcmp(lsq.ins[i].instruction.instruction_string," "))
-      last = i;
+  for(int i=0;i<=lsq_rear;i++){
+    if(ins->cod != lsq.ins[i].cod)
+      continue;
+    for(int j=i;j<lsq_rear;j++)
+      lsq.ins[j]=lsq.ins[j+1];
+    ins_init(&lsq.ins[lsq_rear--]);
+    return;
   }
-  lsq_rear=last-1;
 }
 
 void dequeue_iq(struct InstructionInfo* ins){     //  DEQUEUE THE INSTRUCTION PASSED AS THE ARGUMENT
-  int place=-1;
-  int last;
-  for(int i=0;i<=IQ_SIZE-1;i++){
-    if(ins->cod == iq.ins[i].cod){
-      place = i;
-      ins_init(&iq.ins[i]);
-    }
-  }
-  if(place==-1)
+  for(int i=0;i<=iq_rear;i++){
+    if(ins->cod != iq.ins[i].cod)
+      continue;
+    for(int j=i;j<iq_rear;j++)
+      iq.ins[j]=iq.ins[j+1];
+    ins_init(&iq.ins[iq_rear--]);
     return;
-  for(int i=place;i<=IQ_SIZE-2;i++)
-    iq.ins[i]=iq.ins[i+1];
-  ins_init(&iq.ins[IQ_SIZE-1]);
-  for(int i=IQ_SIZE-1;i>=0;i--){
-    if(!strcmp(iq.ins[i].instruction.instruction_string," "))
-      last =i;
   }
-  iq_rear=last-1;
 }
-bool all_done(){
-  bool done = true;
-  for(int i=0;i<LSQ_SIZE-1;i++){
-    if(strcmp(lsq.ins[i].instruction.instruction_string," "))
-      done = false;
-  }
 
-  for(int i=0;i<IQ_SIZE-1;i++){
-    if(strcmp(iq.ins[i].instruction.instruction_string," "))
-      done = false;
-  }
+/*
+ * Nothing left anywhere and fetch has run off the code: a program without
+ * HALT ends this way. A redirect fetch has not taken yet still moves the PC.
+ */
+bool all_done(APEX_CPU* cpu){
+  if(front != -1 || db_size || strcmp(cpu->stage[DRF].opcode,"") || bp_redirect_pending())
+    return false;
+  if(sim_config.l1i && fetch_buffer.count)
+    return false;
+  return fetch_halted || !in_code(cpu, cpu->pc);
+}
 
-  for(int i=0;i<ROB_SIZE-1;i++){
-    if(strcmp(rob.entry[i].instruction.instruction_string," "))
-      done = false;
-  }
-  }
-  bool no_rob_slot(){
- if((front == 0 && rear ==   ROB_SIZE -1) || (front == rear+1))
-  return true;
- return false;
+bool no_rob_slot(){
+  if((front == 0 && rear ==   ROB_SIZE -1) || (front == rear+1))
+    return true;
+  return false;
 }
+
 void iq_init(){ //INITIALIZE ISSUE QUEUE
-  for(int i=0;i<=IQ_SIZE-1;i++){
+  for(int i=0;i<=LSQ_SIZE-1;i++){
     ins_init(&iq.ins[i]);
   }
-  iq_front=-1;
   iq_rear=-1;
 }
 
-void lsq_init(){  //INITIALIZE LSQ 
+void lsq_init(){  //INITIALIZE LSQ
   for(int i=0;i<=LSQ_SIZE-1;i++){
     ins_init(&lsq.ins[i]);
   }
-  lsq_front = -1;
   lsq_rear = -1;
 }
+
 void clear_rob(){   //CLEAR ROB
   struct InstructionInfo ins;
   ins_init(&ins);
   for(int i=0;i<=ROB_SIZE-1;i++){
     rob.entry[i]=ins;
     rob.tag[i]='u';
+    rob.tid[i]=0;
   }
   front = -1;
   rear = -1;
 }
 
-/*
- *  Execute Stage of APEX Pipeline implementation
- */
-int execute(APEX_CPU* cpu)
-{
-  CPU_Stage* stage = &cpu->stage[EX];
-  if (!stage->busy && !stage->stalled) 
-  {
-    for(int i=0;i<=ROB_SIZE-1;i++){
-        if(d4.instruction_info.cod == rob.entry[i].cod){    //UPDATE ROB DEST ENTRY AND CHANGE TAG IF IT INSTRUCTION HAS DESTINATION  
-          rob.entry[i].dest = d4.instruction_info.dest;
-          rob.tag[i]='c';
-        }
-      }
-      for(int i=0;i<=ROB_SIZE-1;i++){
-        if(m2.instruction_info.cod == rob.entry[i].cod){    //UPDATE ROB DEST ENTRY AND CHANGE TAG IF IT INSTRUCTION HAS DESTINATION  
-          rob.entry[i].dest = m2.instruction_info.dest;
-          rob.tag[i]='c';
-        }
-      }
-      if(!in.stalled){
-    if(stage_is_ready(&in)){
-      in.instruction_info = get_int_from_iq();
-      if(stage_will_write(&in)){
-        dequeue_iq(&in.instruction_info);
-        change_dest_to_invalid(&in);
-        update_rob_tag(&in.instruction_info);
-      }
-    }
-    else if(!strcmp(op,"JAL")){
-      in.instruction_info.dest.value = in.instruction_info.PC + 4;
-      in.instruction_info.target_address = in.instruction_info.src1.value + in.instruction_info.literal - 4;
-      flush_due_to_branch(in.instruction_info.cod);
-      if(stage_will_write(&d1)){
-          dequeue_iq(&d1.instruction_info);
-          update_rob_tag(&d1.instruction_info);
-        }
-        for(int i=0;i<=ROB_SIZE-1;i++){
-        if(in.instruction_info.cod == rob.entry[i].cod && strcmp(in.instruction_info.operation,"LOAD") && strcmp(in.instruction_info.operation,"STORE")){   //UPDATE ROB DEST ENTRY AND CHANGE TAG IF IT INSTRUCTION HAS DESTINATION  
-          rob.entry[i].dest = in.instruction_info.dest;
-          rob.tag[i]='c';
-        }
-      }
-    if (strcmp(stage->opcode, "STORE") == 0) 
-    {
-    stage->mem_address = stage->rs2_value + stage->imm;
-    }
+void commit_to_arf(){   //  TO COMMIT FROM HEAD OF ROB TO ARCHITECTURAL REGISTER FILE
+  struct InstructionInfo* ins = &rob.entry[front];
+  if(instruction_will_write(ins))
+    rf.R[ins->rd].value = ins->dest.value;
+  if(is_arithmetic_i(ins))
+    rf.zero = ins->dest.zero;
+}
 
-    if (strcmp(stage->opcode, "LOAD") == 0) 
-   {
-   	cpu->regs_valid[stage->rd]--;
-    stage->mem_address = stage->imm+stage->rs1_value;
+struct InstructionInfo get_fu_op_from_iq(int cls){    //  OLDEST READY IQ ENTRY OF THE GIVEN FU CLASS
+  struct InstructionInfo i;
+  for(int i=0;i<=IQ_SIZE-1;i++){
+    if(fu_class_of(iq.ins[i].operation) != cls)
+      continue;
+    if(iq.ins[i].src1.status && iq.ins[i].src2.status && !iq.ins[i].issued){
+      iq.ins[i].issued = true;
+      return get_ins_iq(i);
     }
-
-  if (strcmp(stage->opcode, "JUMP") == 0) 
-  { 
-  	//strcpy(cpu->stage[DRF].opcode, "");
-    //strcpy(cpu->stage[F].opcode, "");
-  	
-    stage->buffer = stage->rs1_value + stage->imm;
-  	//printf("\nJUMP pc: %d\n", stage->buffer);
-  }
-  
-  //bz
-  if (strcmp(stage->opcode, "BZ") == 0)
-  { 
-    if(cpu->zero==1)
-    {
-      stage->mem_address = stage->pc + stage->imm;
-      cpu->zero=0;
-    } 
-    else
-     {
-       stage->mem_address = 0;
-     }
-  }
-  
-  if (strcmp(stage->opcode, "BNZ") == 0) 
-  { 
-    if(!cpu->zero)
-    {
-      stage->mem_address = stage->pc + stage->imm;
-    } 
-    else 
-    {
-          stage->mem_address = 0;
-      }
   }
+  ins_init(&i);
+  return i;
+}
 
-    if (strcmp(stage->opcode, "MOVC") == 0) 
-    {
-      stage->buffer = stage->imm;
-      cpu->buff[stage->rd]=stage->buffer;
-      cpu->buff_valid[stage->rd]++;
-    }
-  
-  if (strcmp(stage->opcode, "ADD") == 0) 
-  {
-   // printf(" RS1 %d  RS2 %d\n", stage->rs1_value ,stage->rs2_value);
-    stage->buffer = stage->rs1_value + stage->rs2_value;
-    cpu->buff[stage->rd]=stage->buffer;
-    cpu->buff_valid[stage->rd]++;
-  //  printf(" Add After exec %d\n",stage->buffer);
-    if(stage->buffer==0)
-       cpu->zero=1;
-     else
-       cpu->zero=0;   
+void issue_to_fu_pool(){   //  SELECT FROM THE IQ FOR EVERY UNIT THAT HAS A FREE UNIT AND PORT THIS CYCLE
+  for(int cls=0;cls<FU_NUM_CLASSES;cls++){
+    while(fu_can_issue(cls)){
+      struct InstructionInfo ins = get_fu_op_from_iq(cls);
+      if(!strcmp(ins.instruction.instruction_string," "))
+        break;
+      int slot = fu_issue(cls,ins.cod);
+      dequeue_iq(&ins);
+      update_rob_tag(&ins);
+      fu_ins[slot] = ins;
     }
-  
-  if (strcmp(stage->opcode, "SUB") == 0) 
-  {
-    stage->buffer = stage->rs1_value - stage->rs2_value;
-    cpu->buff[stage->rd]=stage->buffer;
-    cpu->buff_valid[stage->rd]++;
+  }
+}
 
-    if(stage->buffer==0)
-      cpu->zero=1;
-    else
-       cpu->zero=0; 
-    }
-  
-  if (strcmp(stage->opcode, "AND") == 0) 
-  {
-    stage->buffer = stage->rs2_value & stage->rs1_value;
-    cpu->buff[stage->rd]=stage->buffer;
-    cpu->buff_valid[stage->rd]++;
+void compute_fu_result(struct InstructionInfo* ins){
+  int a = ins->src1.value;
+  int b = ins->src2.value;
+  char* op = ins->operation;
+  if(!strcmp(op,"MOVC"))
+    ins->dest.value = ins->literal;
+  else if(!strcmp(op,"ADD"))
+    ins->dest.value = a + b;
+  else if(!strcmp(op,"SUB"))
+    ins->dest.value = a - b;
+  else if(!strcmp(op,"MUL"))
+    ins->dest.value = a * b;
+  else if(!strcmp(op,"DIV"))
+    ins->dest.value = b ? a / b : 0;
+  else if(!strcmp(op,"AND"))
+    ins->dest.value = a & b;
+  else if(!strcmp(op,"OR"))
+    ins->dest.value = a | b;
+  else if(!strcmp(op,"XOR"))
+    ins->dest.value = a ^ b;
+  else{
+    fprintf(stderr, "APEX_Error : No function unit computes %s (pc %d)\n", op, ins->PC);
+    exit(1);
   }
-  
-  if (strcmp(stage->opcode, "OR") == 0) 
-  {
-    stage->buffer = stage->rs2_value | stage->rs1_value;
-    cpu->buff[stage->rd]=stage->buffer;
-    cpu->buff_valid[stage->rd]++;
+  ins->dest.status = true;
+  if(strcmp(op,"MOVC")){
+    ins->dest.zero.bit = ins->dest.value == 0;
+    ins->dest.zero.status = true;
   }
-  
-  if (strcmp(stage->opcode, "XOR") == 0) 
-  {
-    stage->buffer = stage->rs2_value ^ stage->rs1_value;
-    cpu->buff[stage->rd]=stage->buffer;
-    cpu->buff_valid[stage->rd]++;
+}
+
+void complete_fu_ops(){   //  WRITE BACK EVERYTHING THE POOL FINISHED THIS CYCLE, SAME AS THE FIXED UNITS
+  int slot;
+  while(fu_complete(&slot)){
+    compute_fu_result(&fu_ins[slot]);
+    write_result(&fu_ins[slot]);
+  }
+}
+
+static void issue(struct Stage* fu, struct InstructionInfo ins){
+  fu->instruction_info = ins;
+  if(stage_will_write(fu)){
+    dequeue_iq(&ins);
+    update_rob_tag(&ins);
   }
+}
 
-  if (strcmp(stage->opcode, "MUL") == 0) 
+/*
+ *  Execute Stage of APEX Pipeline implementation
+ *
+ *  Results of the last cycle are broadcast first, so a consumer they wake
+ *  can be selected in the same cycle.
+ */
+int execute(APEX_CPU* cpu)
+{
+  HOST_TIMER_SCOPE(HT_EXECUTE);
+  if(stage_will_write(&in))
+    complete_int();
+  if(stage_will_write(&m2)){
+    compute_fu_result(&m2.instruction_info);
+    write_result(&m2.instruction_info);
+  }
+  m2 = m1;
+  stage_init(&m1);
+  if(stage_will_write(&d4)){
+    compute_fu_result(&d4.instruction_info);
+    write_result(&d4.instruction_info);
+  }
+  d4 = d3;
+  d3 = d2;
+  d2 = d1;
+  stage_init(&d1);
+
+  if(sim_config.fu_pool){
+    complete_fu_ops();
+    issue_to_fu_pool();
+  }
+  issue(&in, get_int_from_iq());
+  if(!sim_config.fu_pool){
+    issue(&m1, get_mul_from_iq());
+    issue(&d1, get_div_from_iq());
+  }
+
+  if(trace)
   {
-    if(stage->mul_flag==0)
-    {
-      cpu->stage[F].stalled=1;
-      cpu->stage[DRF].stalled=1;
-      cpu->stage[F].busy=1;
-      cpu->stage[DRF].busy=1;
-      stage->nop=1;
-    }
-    
-    if(stage->mul_flag==1)
+    print_fu_content("INT FU", &in);
+    if(!sim_config.fu_pool)
     {
-      stage->buffer = stage->rs1_value * stage->rs2_value;
-      cpu->stage[F].stalled=0;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].busy=0;
-      cpu->stage[DRF].busy=0;
-      stage->nop=0;
-      cpu->buff[stage->rd]=stage->buffer;
-      cpu->buff_valid[stage->rd]++;
-    }
-    stage->mul_flag=1;
-    if(stage->buffer==0)
-      cpu->zero=1;
-    else
-      cpu->zero=0;
-    }
-
-    if(strcmp(stage->opcode, "HALT") == 0)
-     {
-       stage->flush=1;
-       cpu->stage[DRF].pc = 0;
-       strcpy(cpu->stage[DRF].opcode, "");
-       cpu->stage[DRF].stalled = 1;
-       cpu->stage[F].stalled = 1;
-       strcpy(cpu->stage[F].opcode, "");
-       cpu->stage[F].pc = 0;
-       cpu->ex_halt=1;
+      print_fu_content("MUL FU", &m1);
+      print_fu_content("DIV FU", &d1);
     }
-
-    /* Copy data from Execute latch to Memory latch*/
-    cpu->stage[MEM] = cpu->stage[EX];
-
-    if(ENABLE_DEBUG_MESSAGES)
-     {
-      print_stage_content("Execute", stage);
-     }
   }
-  
-  else
-  {
-   cpu->stage[MEM] = cpu->stage[EX];
-  if(ENABLE_DEBUG_MESSAGES)
-   {
-      printf("Execute        : EMPTY\n");
-    } 
-  } 
   return 0;
 }
 
 /*
  *  Memory Stage of APEX Pipeline implementation
+ *
+ *  One LSQ entry per cycle. A LOAD, FADD or SWAP completes the cycle after
+ *  it was taken; STORE and FENCE retire from the ROB head right away.
  */
 int memory(APEX_CPU* cpu)
 {
-  if(!me.stalled){
-    if(stage_is_ready(&me)){
-      me.instruction_info = get_ins_from_lsq();
-      if(!strcmp(me.instruction_info.operation,"STORE"))
-        dequeue_rob();
+  HOST_TIMER_SCOPE(HT_MEMORY);
+  if(stage_will_write(&me)){
+    if(!strcmp(me.instruction_info.operation,"LOAD") || is_atomic(me.instruction_info.operation))
+      write_result(&me.instruction_info);
+    stage_init(&me);
+  }
+
+  bool port_free = !sync_port_busy();
+  if(sim_config.l1d && port_free)
+    take_filled_load(cpu);    //  A FINISHED MISS USES THE PORT AHEAD OF THE LSQ
+  if(port_free && stage_is_ready(&me)){
+    me.instruction_info = get_ins_from_lsq();
+    if(stage_will_write(&me)){
+      char* op = me.instruction_info.operation;
+      if(!strcmp(op,"LOAD"))
+        execute_load(cpu, &me.instruction_info);
+      if(is_atomic(op))
+        execute_atomic(cpu, &me.instruction_info);
       dequeue_lsq(&me.instruction_info);
-      for(int i=0;i<=31;i++){
-        if(rob.entry[i].cod == me.instruction_info.cod && me.instruction_info.cod!=-1)
-          rob.tag[i] = 'e';
-      }
-    }
-  CPU_Stage* stage = &cpu->stage[MEM];
-  if (!stage->busy && !stage->stalled && stage->nop==0) 
-  {
-
-	if (strcmp(stage->opcode, "JUMP") == 0) 
- 	{
-
-	if(stage->buffer != 0) 
-      {
-        cpu->pc =stage->buffer;
-         cpu->stage[DRF].pc = 0;
-         strcpy(cpu->stage[DRF].opcode, "");
-         strcpy(cpu->stage[EX].opcode, "");
-         cpu->stage[EX].pc = 0;
-        if((stage->buffer-4000) < 0) 
-        {
-          cpu->ins_completed = (cpu->ins_completed + ((stage->buffer-4000)/4))-1;
-        }
-
-        else
-        {
-          cpu->ins_completed = (cpu->ins_completed + ((stage->buffer-4000)/4)-cpu->ins_completed - 1);
-        }
-
-        if(cpu->ex_halt) 
-        {
-          cpu->ex_halt = 0;
-          cpu->stage[F].stalled =0;
-        }
-      }
-	}
-
-
-
-    /* Store */
-    if (strcmp(stage->opcode, "STORE") == 0) 
-    {
-    cpu->data_memory[stage->mem_address] = stage->rs1_value;
-    for(int i=0;i<=31;i++){
-          if(rob.entry[i].cod == me.instruction_info.cod && me.instruction_info.cod!=-1)
-            rob.tag[i] = 'e';
-        }
-        dequeue_lsq(&me.instruction_info);
-        if(!strcmp(me.instruction_info.operation,"STORE"))
-          dequeue_rob();
-        if(stage_will_write(&me))
-          mv++;
-    }
-  
-    /* LOAD */
-    if (strcmp(stage->opcode, "LOAD") == 0) 
-    {
-
-    	stage->buffer= cpu->data_memory[stage->mem_address];
-       cpu->buff[stage->rd]=stage->buffer;
-    	cpu->regs_valid[stage->rd]++;
-    	cpu->buff_valid[stage->rd]++;
-
-      
-     // when store is in DRF
-     // if(strcmp(cpu->stage[DRF].opcode, "STORE")==0)
-      //{
-      //cpu->buff_valid[stage->rd]++;
-      //}
-    }
-
-    if (strcmp(stage->opcode, "BZ") == 0) 
-    {
-      if(stage->mem_address != 0) 
-      {
-        cpu->pc =stage->mem_address;
-        if((strcmp(cpu->stage[EX].opcode, "ADD") == 0) || (strcmp(cpu->stage[EX].opcode, "SUB") == 0) || (strcmp(cpu->stage[EX].opcode, "MUL") == 0) || (strcmp(cpu->stage[EX].opcode, "AND") == 0) || (strcmp(cpu->stage[EX].opcode, "OR") == 0) || (strcmp(cpu->stage[EX].opcode, "XOR") == 0) || (strcmp(cpu->stage[EX].opcode, "MOVC") == 0) || (strcmp(cpu->stage[EX].opcode, "LOAD") == 0))
-        {
-          cpu->regs_valid[cpu->stage[EX].rd]++;
-        }
-         cpu->stage[DRF].pc = 0;
-         strcpy(cpu->stage[DRF].opcode, "");
-         strcpy(cpu->stage[EX].opcode, "");
-         cpu->stage[EX].pc = 0;
-        if(stage->imm < 0) 
-        {
-          cpu->ins_completed = (cpu->ins_completed + (stage->imm/4))-1;
-        }
-
-        else
-        {
-          cpu->ins_completed = (cpu->ins_completed - (stage->imm/4));
-        }
-
-        if(cpu->ex_halt) 
-        {
-          cpu->ex_halt = 0;
-          cpu->stage[F].stalled =0;
-        }
+      update_rob_tag(&me.instruction_info);
+      if(!strcmp(op,"FENCE")){
+        sync_fences++;
+        mem_busy = sim_config.fence_latency;
+        dequeue_rob();
       }
-    }
-  
-    if (strcmp(stage->opcode, "BNZ") == 0) 
-    {
-      if(stage->mem_address != 0) 
-      {
-        cpu->pc =stage->mem_address;
-
-           if((strcmp(cpu->stage[EX].opcode, "ADD") == 0) || (strcmp(cpu->stage[EX].opcode, "SUB") == 0) || (strcmp(cpu->stage[EX].opcode, "MUL") == 0) || (strcmp(cpu->stage[EX].opcode, "AND") == 0) || (strcmp(cpu->stage[EX].opcode, "OR") == 0) || (strcmp(cpu->stage[EX].opcode, "XOR") == 0) || (strcmp(cpu->stage[EX].opcode, "MOVC") == 0) || (strcmp(cpu->stage[EX].opcode, "LOAD") == 0)) 
-           {
-              cpu->regs_valid[cpu->stage[EX].rd]++;
-           }
-
-         cpu->stage[DRF].pc = 0;
-         strcpy(cpu->stage[DRF].opcode, "");
-         strcpy(cpu->stage[EX].opcode, "");
-         cpu->stage[EX].pc = 0;
-
-        if(stage->imm < 0) 
-        {
-          cpu->ins_completed = (cpu->ins_completed + (stage->imm/4))-1;
-        }
-
-        else
-        {
-          cpu->ins_completed = (cpu->ins_completed - (stage->imm/4));
-        }
-
-        if(cpu->ex_halt) 
-        {
-          cpu->ex_halt = 0;
-          cpu->stage[F].stalled =0;
-        }
+      if(!strcmp(op,"STORE")){
+        dm_write(&cpu->data_memory, me.instruction_info.target_address, me.instruction_info.src1.value);
+        stq_retire_store(me.instruction_info.cod);
+        rob.entry[front] = me.instruction_info;   //  THE CHECKER READS ADDRESS AND DATA FROM THE HEAD
+        dequeue_rob();
       }
+      if(sim_config.l1d)
+        l1d_access(cpu);
     }
-
-  if(strcmp(stage->opcode, "HALT") == 0) 
-  {
-      cpu->stage[EX].pc = 0;
-      strcpy(cpu->stage[EX].opcode, "");
-      cpu->stage[DRF].pc = 0;
-      strcpy(cpu->stage[DRF].opcode, "");
-      cpu->stage[EX].stalled = 1;
-      cpu->stage[DRF].stalled = 1;
-      strcpy(cpu->stage[F].opcode, "");
-      cpu->stage[F].stalled = 1;
-      cpu->stage[F].pc = 0;
-      cpu->ex_halt=1;
-    }
-
-    /* Copy data from decode latch to execute latch*/
-    cpu->stage[WB] = cpu->stage[MEM];
-
-    if (ENABLE_DEBUG_MESSAGES) 
-    {
-      print_stage_content("Memory", stage);
-    }
-    dequeue_lsq(&me.instruction_info);
-    for(int i=0;i<=31;i++){
-          if(rob.entry[i].cod == me.instruction_info.cod && me.instruction_info.cod!=-1)
-            rob.tag[i] = 'e';
-        }
-        if(!strcmp(me.instruction_info.operation,"STORE"))
-          dequeue_rob();
-        if(stage_will_write(&me))
-          mv++;
   }
-  
-   else
-   {
-   cpu->stage[WB] = cpu->stage[MEM];
-    if(ENABLE_DEBUG_MESSAGES)
-    {
-       printf("Memory         : EMPTY\n");
-      } 
+  if (trace)
+  {
+    print_fu_content("Memory", &me);
   }
   return 0;
 }
 
 /*
  *  Writeback Stage of APEX Pipeline implementation
+ *
+ *  Commits up to sim_config.commit_width completed instructions from the
+ *  ROB head to the architectural register file.
  */
 int writeback(APEX_CPU* cpu)
 {
-  /*if(instruction_will_write(&rob.entry[front])){
-        if(rob.entry[front].dest.status && rob.tag[front] == 'c'){*/
-  CPU_Stage* stage = &cpu->stage[WB];
-  COMMIT:
-      if(instruction_will_write(&rob.entry[front])){
-        if(rob.entry[front].dest.status && rob.tag[front] == 'c'){
-          commit++;
-          if(!strcmp(committed_instructions_list[0].instruction.instruction_string," "))
-            committed_instructions_list[0] = rob.entry[front];
-          else if(!strcmp(committed_instructions_list[1].instruction.instruction_string," "))
-            committed_instructions_list[1] = rob.entry[front];
-          commit_to_arf();
-          committed_instructions+=1;
-          free_up_pr(&rob.entry[front]);  
-          dequeue_rob();
-          if(commit<2){
-            goto COMMIT;
-          }
-        }
-      }
-    commit=0;
-  if (!stage->busy && !stage->stalled && stage->nop==0 && (strcmp(stage->opcode, "")!=0)) 
-  {
-    /* Update register file */
-    if (strcmp(stage->opcode, "MOVC") == 0) 
-    {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0;  
-    }
-  
-  if (strcmp(stage->opcode, "LOAD") == 0) 
-  {
-    if(!strcmp(in.instruction_info.operation,"LOAD")){
-      if(bypass_condition(&in.instruction_info)){   //CONDITION TO BYPASS THE STORE IN LSQ AND GO FIRST IN MEM
-        load_bypass(&in.instruction_info);
-      }
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-      
-    }
-  
-  
-  if (strcmp(stage->opcode, "ADD") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-  }
-  
-  if (strcmp(stage->opcode, "SUB") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-  }
-  
-  if (strcmp(stage->opcode, "AND") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-  }
-  
-  if (strcmp(stage->opcode, "OR") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-  }
-  
-  if (strcmp(stage->opcode, "XOR") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-    cpu->regs_valid[stage->rd]++;
-    cpu->stage[DRF].stalled=0;
-    cpu->stage[F].stalled=0; 
-    cpu->buff_valid[stage->rd]--;
-    }
-  
-  if (strcmp(stage->opcode, "MUL") == 0) 
-  {
-      cpu->regs[stage->rd] = stage->buffer;
-      cpu->regs_valid[stage->rd]++;
-      cpu->stage[DRF].stalled=0;
-      cpu->stage[F].stalled=0; 
-      cpu->buff_valid[stage->rd]--;
-  }
-
-    if(strcmp(stage->opcode, "HALT") == 0) 
-    {
-        cpu->ins_completed = cpu->code_memory_size - 1;
-        cpu->stage[EX].pc = 0;
-        strcpy(cpu->stage[EX].opcode, "");
-        cpu->stage[DRF].pc = 0;
-        strcpy(cpu->stage[DRF].opcode, "");
-        cpu->stage[EX].stalled = 1;
-        cpu->stage[DRF].stalled = 1;
-        cpu->stage[F].stalled = 1;
-        strcpy(cpu->stage[F].opcode, "");
-        cpu->stage[F].pc = 0;
-        cpu->stage[MEM].pc = 0;
-        strcpy(cpu->stage[MEM].opcode, "");
-        cpu->stage[MEM].stalled = 1;
-        cpu->ex_halt=1;
-    }
-  
-    cpu->ins_completed++;
-
-    if (ENABLE_DEBUG_MESSAGES) 
+  HOST_TIMER_SCOPE(HT_WRITEBACK);
+  for(int n=0;n<sim_config.commit_width && front != -1 && rob.tag[front] == 'c';n++){
+    struct InstructionInfo* ins = &rob.entry[front];
+    bool halt = !strcmp(ins->operation,"HALT");
+    if (trace)
     {
-      print_stage_content("Writeback", stage);
+      printf("%-15s: pc(%d) ", "Commit", ins->PC);
+      print_instruction_after_rename(ins);
+      printf("\n");
+    }
+    if(!strcmp(ins->operation,"LOAD") && !dm_valid(ins->target_address))
+      dm_read(&cpu->data_memory, ins->target_address);    //  RECORDS THE FAULT
+    if(sim_config.threads > 1)
+      smt_enter(rob.tid[front], &rf, prf.latest);
+    commit_to_arf();
+    free_up_pr(ins);
+    if(sim_config.threads > 1)
+      smt_leave(&rf, prf.latest);
+    dequeue_rob();
+    if(halt && sim_config.threads == 1){
+      cpu->halt = 1;
+      break;
     }
   }
-  
-   else
-  {
-   
-  if(ENABLE_DEBUG_MESSAGES)
-   {
-      printf("Writeback      : EMPTY\n");
-    } 
-  }
   return 0;
 }
 
-display_lsq();
-display_isq();
-display_rob();
-
-void display(APEX_CPU* cpu)                      // Display Register values
-  {
-    for(int i=0; i<16; i++)
-    {
-    printf("\nR%d = %d",i,cpu->regs[i]);
-    }
-  }
-  
-void valid(APEX_CPU* cpu)
-  {
-    for(int i=0;i<16;i++)
-    {
-      cpu->regs_valid[i]=2;
-    }
-  }
-    
-
-void validAll(APEX_CPU* cpu)
-{
-  for(int i=0;i<16;i++)
-  {
-    cpu->regs_valid[i]=1;
-  }
+void print_instruction_after_rename(struct InstructionInfo* ins){
+  char buf[64];
+  int n = snprintf(buf, sizeof(buf), "%s", ins->operation);
+  if(instruction_will_write(ins))
+    n += snprintf(buf + n, sizeof(buf) - n, ",%s", ins->dest.name);
+  if(ins->src1.name[0])
+    n += snprintf(buf + n, sizeof(buf) - n, ",%s", ins->src1.name);
+  if(ins->src2.name[0])
+    n += snprintf(buf + n, sizeof(buf) - n, ",%s", ins->src2.name);
+  if(!strcmp(ins->operation,"MOVC") || !strcmp(ins->operation,"LOAD") || !strcmp(ins->operation,"STORE") || is_control(ins->operation))
+    snprintf(buf + n, sizeof(buf) - n, ",#%d", ins->literal);
+  printf("%-26s", buf);
 }
 
-void dispRegValue(APEX_CPU* cpu)
-{
-  for(int i=0;i<16;i++)
-  {
-    printf("\n\tR%d || Value = %d",i,cpu->regs[i]);
+void display_isq(){
+  printf("\n    Issue Queue\n");
+  printf("\n------------------------");
+  for(int i=iq_rear;i>=0;i--){
+    printf("\n%2d | ",i);
+    print_instruction_after_rename(&iq.ins[i]);
+    printf(" |");
   }
+  printf("\n------------------------\n");
 }
 
-/*void dispRegValid(APEX_CPU* cpu)
-{
-  for(int i=0;i<16;i++)
-  {
-    printf("\n\tR%d || Validity = %d",i,cpu->regs_valid[i]);
-  }
-}*/
-
-void dispMem(APEX_CPU* cpu)
-{
-  for(int i=0;i<100;i++)
-  {
-    printf("\n\tMEM_Value[%d] || Value=%d\n",i,cpu->data_memory[i]);
-  }
-}
 void display_lsq(){
   printf("\n    Load-Store Queue\n");
   printf("\n------------------------");
@@ -1837,6 +1882,7 @@ void display_lsq(){
   }
   printf("\n------------------------\n");
 }
+
 void display_rob(){
   printf("\n\t\t    ROB\t\n");
   printf("\n-----------------------------------------------------------");
@@ -1855,8 +1901,9 @@ void display_rob(){
       if(i==rear)
         printf("\t<-TAIL");
   }
-  printf("\n-----------------------------------------------------------");
+  printf("\n-----------------------------------------------------------\n");
 }
+
 void rob_entry_print(struct InstructionInfo* ins){
   printf("|");
   if(strcmp(ins->instruction.instruction_string," ")){
@@ -1866,56 +1913,171 @@ void rob_entry_print(struct InstructionInfo* ins){
     printf("%26s",ins->instruction.instruction_string);
 }
 
+/*
+ * End of cycle view of the ROB for the profiler: entries that completed
+ * this cycle, and the head if it is still there.
+ */
+static void profile_rob(){
+  if(front == -1)
+    return;
+  int i = front;
+  while(1){
+    if(rob.tag[i] == 'c')
+      prof_completed(rob.entry[i].cod, rob.entry[i].PC);
+    if(i == rear)
+      break;
+    i = (i == ROB_SIZE-1) ? 0 : i + 1;
+  }
+  prof_head_blocked(rob.entry[front].PC);
+}
+
+static void interval_counters(struct IntervalCounters* c){   //  A MERGED ACCESS IS A MISS HERE, SO MISS RATE = 1 - HIT RATE
+  memset(c, 0, sizeof(*c));
+  c->committed = rob_committed;
+  if(sim_config.l1i){
+    c->l1i_accesses = l1i.accesses;
+    c->l1i_misses = l1i.misses + l1i.merged;
+  }
+  if(sim_config.l1d){
+    c->l1d_accesses = l1d.accesses;
+    c->l1d_misses = l1d.misses + l1d.merged;
+  }
+  if(sim_config.l2){
+    c->l2_accesses = l2.accesses;
+    c->l2_misses = l2.misses + l2.merged;
+  }
+  c->icache_stalls = icache_stall_cycles;
+  c->fetch_buffer_full = fetch_buffer_full_cycles;
+  c->decode_starved = decode_starved_cycles;
+  c->iq_full = dispatch_iq_full;
+  c->memory_busy = sync_busy_cycles;
+}
+
+static void interval_tick(APEX_CPU* cpu){   //  AFTER THE CLOCK ADVANCED, cpu->clock CYCLES ARE DONE
+  int rob_count = (front == -1) ? 0 : (rear - front + ROB_SIZE) % ROB_SIZE + 1;
+  interval_cycle(rob_count, iq_rear + 1, lsq_rear + 1);
+  if(cpu->clock % sim_config.interval == 0){
+    struct IntervalCounters c;
+    interval_counters(&c);
+    interval_write(cpu->clock, &c);
+  }
+}
+
 /*
  *  APEX CPU simulation loop
  */
 int APEX_cpu_run(APEX_CPU* cpu)
 {
-  //valid(cpu);
-  while (1) 
+  trace = ENABLE_DEBUG_MESSAGES && cpu->sim && !strcmp(cpu->sim, "display");
+  if (trace)
+  {
+    printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode", "rd", "rs1", "rs2", "imm");
+    for (int i = 0; i < cpu->code_memory_size; ++i)
+    {
+      printf("%-9s %-9d %-9d %-9d %-9d\n",
+             cpu->code_memory[i].opcode,
+             cpu->code_memory[i].rd,
+             cpu->code_memory[i].rs1,
+             cpu->code_memory[i].rs2,
+             cpu->code_memory[i].imm);
+    }
+  }
+  if (sim_config.threads > 1)
+    smt_start(&rf, prf.latest);
+  ht_init();
+  while (1)
   {
-    /* All the instructions committed, so exit */
-   // printf("INS Complete  %d \n",cpu->ins_completed );
-   // printf("Mem size %d\n",cpu->code_memory_size );
-    if (cpu->ins_completed == cpu->code_memory_size || cpu->clock==cpu->no_cycles) 
+    /* HALT committed or nothing left to run, so exit */
+    if (cpu->halt || cpu->clock == cpu->no_cycles || (sim_config.threads == 1 && all_done(cpu)))
     {
-     // printf("Inside here  \n");
-     // printf("\n%d==%d || %d==%d\n",cpu->ins_completed, cpu->code_memory_size, cpu->clock, cpu->no_cycles);
+      if (sim_config.checker && cpu->clock != cpu->no_cycles && !checker_finish())
+      {
+        printf("(apex) >> Simulation stopped by lockstep checker");
+        break;
+      }
       printf("(apex) >> Simulation Complete");
       break;
     }
 
+    if (sim_config.threads > 1 && smt_all_halted() && front == -1)
+    {
+      printf("(apex) >> Simulation Complete");
+      break;
+    }
 
+    if (sim_config.checker && checker_has_failed())
+    {
+      printf("(apex) >> Simulation stopped by lockstep checker");
+      break;
+    }
 
-    if(ENABLE_DEBUG_MESSAGES)
+    if(trace)
     {
       printf("--------------------------------\n");
       printf("Clock Cycle #: %d\n", cpu->clock);
       printf("--------------------------------\n");
     }
-  
-  // printf("\n\n\n============================REGISTER VALID=========================");
-  // dispRegValid(cpu);
-  
+
+    if(sim_config.profile)
+      prof_clock(cpu->clock);
     writeback(cpu);
     memory(cpu);
     execute(cpu);
     decode(cpu);
     fetch(cpu);
+    if(sim_config.fu_pool)
+      fu_tick();
+    if(sim_config.profile)
+      profile_rob();
+    if(trace)
+    {
+      display_isq();
+      display_lsq();
+      display_rob();
+    }
     cpu->clock++;
-}
+    if(sim_config.interval)
+      interval_tick(cpu);
+  }
+  if (sim_config.interval)
+  {
+    struct IntervalCounters c;
+    interval_counters(&c);
+    interval_close(cpu->clock, &c);
+  }
   printf("\n");
+  printf("=======PIPELINE========\n");
+  printf(" | Cycles    | %d |\n", cpu->clock);
+  printf(" | Committed | %lu |\n", rob_committed);
+  printf(" | IPC       | %.3f |\n", cpu->clock ? (double)rob_committed / cpu->clock : 0.0);
   printf("=====REGISTER VALUE============\n");
-  for(int i=0;i<16;i++)
-  {printf("\n");
-  printf(" | Register[%d] | Value=%d | status=%s | \n",i,cpu->regs[i],(cpu->regs_valid[i])?"Valid" : "Invalid");
-      
-  }
-printf("=======DATA MEMORY===========\n");
-
-  for(int i=0;i<99;i++)
+  for(int i=0;i<ARF_SIZE;i++)
   {
-  printf(" | MEM[%d] | Value=%d | \n",i,cpu->data_memory[i]);
+    printf(" | Register[%d] | Value=%d | status=%s | \n",i,rf.R[i].value,(find_mapping(i) == -1)?"Valid" : "Invalid");
+  }
+  printf("=======DATA MEMORY===========\n");
+  dm_print(&cpu->data_memory);
+  if (sim_config.checker)
+    checker_print_stats();
+  if (sim_config.bp_type != BP_NONE || sim_config.btb_bits)
+    bp_print_stats();
+  if (sim_config.fu_pool)
+    fu_print_stats();
+  if (sim_config.mem_spec)
+    stq_print_stats();
+  if (sim_config.mem_spec && sim_config.store_sets)
+    md_print_stats();
+  if (sim_config.l1d || sim_config.l1i)
+    memory_hierarchy_print_stats();
+  if (sync_atomics || sync_fences)
+    sync_print_stats();
+  if (sim_config.threads > 1)
+  {
+    smt_print_registers(&rf, prf.latest);
+    smt_print_stats(cpu->clock);
   }
+  ht_print_stats(cpu->clock);
+  if (sim_config.profile && !prof_write(sim_config.profile, cpu->clock))
+    fprintf(stderr, "APEX_Error : Unable to write the profile to %s\n", sim_config.profile);
   return 0;
-  }
\ No newline at end of file
+}
@@ -1,4 +1,3 @@
-
 #ifndef _APEX_CPU_H_
 #define _APEX_CPU_H_
 /**
@@ -9,6 +8,9 @@
  *  Gaurav Kothari (gkothar1@binghamton.edu)
  *  State University of New York, Binghamton
  */
+#include <stdbool.h>
+
+#include "datamem.h"
 
 enum
 {
@@ -20,6 +22,12 @@ enum
   NUM_STAGES
 };
 
+#define ROB_SIZE 32
+#define IQ_SIZE 16
+#define LSQ_SIZE 32
+#define PRF_SIZE 32
+#define ARF_SIZE 16
+
 /* Format of an APEX instruction  */
 typedef struct APEX_Instruction
 {
@@ -30,48 +38,93 @@ typedef struct APEX_Instruction
   int imm;        // Literal Value
 } APEX_Instruction;
 
+/* Zero flag carried with the register its producer writes */
+struct Flags{
+  bool bit;         // Result was zero
+  bool status;      // Valid, the producer has completed
+};
+
 struct Register{
-  char name[3];
+  char name[4];     // R0-R15 or P0-P31, empty when the operand is unused
   int value;
-  int status;
+  bool status;      // Value is valid
   struct Flags zero;
 };
 
 struct RegisterFile{
-  struct Register R[16];
+  struct Register R[ARF_SIZE];
+  struct Flags zero;    // Zero flag of the last committed ADD/SUB/MUL/DIV
 };
 
 struct PhysicalRF{
-  struct Register P[32];
-  char renamed[32][4];
-  bool latest[32];
+  struct Register P[PRF_SIZE];
+  char renamed[PRF_SIZE][4];    // Architectural register it holds, empty when free
+  bool latest[PRF_SIZE];        // Newest mapping of that architectural register
+};
+
+/* Printable form of an instruction, " " for an empty entry */
+struct InstructionText{
+  char instruction_string[64];
+};
+
+/* An instruction after rename, as it moves through the IQ, LSQ, ROB and function units */
+struct InstructionInfo{
+  struct InstructionText instruction;
+  char operation[8];
+  int cod;                // Dispatch order, -1 for an empty entry
+  int PC;
+  int rd;                 // Architectural fields as fetched
+  int rs1;
+  int rs2;
+  int literal;
+  struct Register src1;   // BZ/BNZ read the zero flag of src1's producer
+  struct Register src2;
+  struct Register dest;
+  bool issued;
+  int target_address;     // LOAD/STORE/FADD/SWAP address, -1 until computed
+};
+
+/* Latch of a function unit or the memory stage, and the renamed instruction in Decode/RF */
+struct Stage{
+  struct InstructionInfo instruction_info;
+  bool stalled;
+};
+
+#define CFQ_SIZE 8
+#define LOAD_CHECKPOINTS 8
+#define RENAME_CHECKPOINTS (CFQ_SIZE + LOAD_CHECKPOINTS)    // The first CFQ_SIZE are kept for control instructions
+
+/* Control flow queue, unresolved BZ/BNZ/JUMP/JAL in dispatch order */
+struct CFQ{
+  struct InstructionInfo entry[CFQ_SIZE];
+  char tag[CFQ_SIZE];     // 'u' free, 'w' waiting for the INT FU
+};
+
+/* Rename map right after a control instruction or speculative LOAD is renamed, before the younger slots of its bundle */
+struct RenameMap{
+  char renamed[PRF_SIZE][4];
+  bool latest[PRF_SIZE];
+};
+
+/* Rename state saved when a control instruction enters the CFQ, or a LOAD that may be replayed is dispatched */
+struct RenameCheckpoint{
+  int cod;                // Owner, -1 when the slot is free
+  bool load;              // Owner is a LOAD, not a CFQ entry
+  int rob_index;          // ROB slot of the owner, everything after it up to rear is younger
+  char renamed[PRF_SIZE][4];    // Speculative rename map; an empty name is a free physical register
+  bool latest[PRF_SIZE];
 };
 
 struct ReorderBuffer{
-  struct InstructionInfo entry[32];
-  char tag[32];
+  struct InstructionInfo entry[ROB_SIZE];
+  char tag[ROB_SIZE];     // 'u' free, 'w' dispatched, 'e' issued, 'c' complete
+  int tid[ROB_SIZE];      // SMT thread of each entry
 };
 
 typedef struct Queue{
-  struct InstructionInfo ins[32];
-  struct InstructionInfo get_ins_lsq(int);
-  struct InstructionInfo get_ins_from_lsq();
-  struct InstructionInfo get_div_from_iq();
-  struct InstructionInfo get_int_from_iq();
-  struct InstructionInfo get_mul_from_iq();
-  struct InstructionInfo get_ins_iq(int);
-  struct Queue iq[16];
-  struct Queue lsq[32];
+  struct InstructionInfo ins[LSQ_SIZE];   // In dispatch order, the IQ uses the first IQ_SIZE
 }Queue;
 
-// Boolean Type Functions
-bool iq_full();
-bool lsq_full_if_mem();
-bool no_rob_slot(); 
-bool iq_has_int(int);
-bool iq_has_mul(int);
-bool iq_has_div(int);
-
 /* Model of CPU stage latch */
 typedef struct CPU_Stage
 {
@@ -81,43 +134,107 @@ typedef struct CPU_Stage
   int rs2;        // Source-2 Register Address
   int rd;       // Destination Register Address
   int imm;        // Literal Value
-  int rs1_value;  // Source-1 Register Value
-  int rs2_value;  // Source-2 Register Value
-  int buffer;   // Latch to hold some value
-  int mem_address;  // Computed Memory Address
   int busy;       // Flag to indicate, stage is performing some action
   int stalled;    // Flag to indicate, stage is stalled
-  int mul_flag;       
-  int nop;      // flag for printing nop
-  int temp_pc;
-  int flush;
-  int arithmetic_instr;
-  int bubble;
-  struct CPU_Stage* next;
-  struct CPU_Stage* prev;
-  int CPU_Stage* enqueue_rob);
+} CPU_Stage;
+
+/* Model of APEX CPU */
+typedef struct APEX_CPU
+{
+  /* Clock cycles elasped */
+  int clock;
+
+  /* Current program counter */
+  int pc;
+
+  /* In-order frontend latches, only F and DRF are used */
+  CPU_Stage stage[NUM_STAGES];
+
+  /* Code Memory where instructions are stored */
+  APEX_Instruction* code_memory;
+  int code_memory_size;
+
+  /* Data Memory */
+  struct DataMemory data_memory;
+
+  int no_cycles;        // Cycles to simulate
+  const char* sim;      // "simulate" or "display"
+  int halt;             // HALT committed
+} APEX_CPU;
+
+// Boolean Type Functions
+bool iq_full();
+bool lsq_full_if_mem(struct InstructionInfo*);
+bool no_rob_slot();
+bool cfq_full();
+bool dispatch_one(int);
+bool iq_has_int(int);
+bool iq_has_mul(int);
+bool iq_has_div(int);
+bool all_done(APEX_CPU*);
+
+// InstructionInfo Type Functions
+struct InstructionInfo get_ins_lsq(int);
+struct InstructionInfo get_ins_from_lsq();
+struct InstructionInfo get_div_from_iq();
+struct InstructionInfo get_int_from_iq();
+struct InstructionInfo get_mul_from_iq();
+struct InstructionInfo get_ins_iq(int);
+struct InstructionInfo get_fu_op_from_iq(int);
+
 // VOID TYPE FUNCTIONS
 void rob_entry_print(struct InstructionInfo*);
 void display_rob();
-void display_prf();
-void print_stage_content_after_rename(struct Stage*);
 void print_instruction_after_rename(struct InstructionInfo*);
 void display_isq();
 void display_lsq();
 void iq_init();
 void lsq_init();
+void cfq_init();
 void enqueue_iq(struct Stage*);
 void enqueue_lsq(struct Stage*);
-void forward_data_to_lsq(struct Stage*, struct Queue*);
-void forward_data_to_iq(struct Stage*, struct Queue*);
-void read_broadcasted_reg_iq();
-void read_broadcasted_reg_lsq();
+int enqueue_rob(struct Stage*);
+void enqueue_cfq(struct Stage*);
+void dequeue_cfq(int);
+void forward_data_to_lsq(struct InstructionInfo*);
+void forward_data_to_iq(struct InstructionInfo*);
 void update_rob_tag(struct InstructionInfo*);
 void clear_rob();
-void clear_cfq();
+void checkpoint_init();
+int free_checkpoint(bool);
+bool take_checkpoint(struct Stage*, struct RenameMap*);
+void release_checkpoint(int);
+void flush_due_to_branch(int);
+void link_bundle_sources(int);
+void dispatch_and_issue();
+bool has_checkpoint(int);
+bool load_can_issue(struct InstructionInfo*);
+void execute_load(APEX_CPU*, struct InstructionInfo*);
+void execute_atomic(APEX_CPU*, struct InstructionInfo*);
+bool sync_port_busy();
+void sync_print_stats();
+void replay_load(int);
+int fetch_into_buffer(APEX_CPU*, int);
+bool memory_hierarchy_init();
+void memory_hierarchy_free();
+void memory_hierarchy_print_stats();
+void l1d_access(APEX_CPU*);
+void take_filled_load(APEX_CPU*);
+void squash_parked(int);
+void issue_to_fu_pool();
+void complete_fu_ops();
+void compute_fu_result(struct InstructionInfo*);
+void check_rob_head();
+void resolve_branch(struct InstructionInfo*);
+void resolve_jump(struct InstructionInfo*);
+void commit_to_arf();
 void dequeue_rob();
 void dequeue_iq(struct InstructionInfo*);
 void dequeue_lsq(struct InstructionInfo*);
+int rob_tid_of(int);
+int rob_entries_of(int);
+void count_thread_entries(int*, int*);
+void repair_rename_map(int);
 
 
 APEX_Instruction*
@@ -147,4 +264,4 @@ memory(APEX_CPU* cpu);
 int
 writeback(APEX_CPU* cpu);
 
-#endif
\ No newline at end of file
+#endif
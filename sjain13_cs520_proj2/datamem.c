@@ -0,0 +1,74 @@
+/*
+ *  datamem.c
+ *  Sparse data memory, pages allocated on first write
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "datamem.h"
+
+void dm_init(struct DataMemory* m){
+  memset(m,0,sizeof(*m));
+}
+
+void dm_free(struct DataMemory* m){
+  for(int p=0;p<DM_NUM_PAGES;p++)
+    free(m->page[p]);
+  dm_init(m);
+}
+
+bool dm_valid(int address){
+  return address >= 0 && address < DM_SIZE;
+}
+
+static void fault(struct DataMemory* m, int address){   //  REPORT ONLY THE FIRST BAD ADDRESS
+  if(!m->fault){
+    fprintf(stderr, "APEX_Error : Data address %d out of range (0-%d)\n", address, DM_SIZE - 1);
+    m->fault_address = address;
+  }
+  m->fault = true;
+}
+
+int dm_read(struct DataMemory* m, int address){
+  if(!dm_valid(address)){
+    fault(m,address);
+    return 0;
+  }
+  int* page = m->page[address >> DM_PAGE_BITS];
+  return page ? page[address & (DM_PAGE_WORDS - 1)] : 0;
+}
+
+void dm_write(struct DataMemory* m, int address, int value){
+  if(!dm_valid(address)){
+    fault(m,address);
+    return;
+  }
+  int** page = &m->page[address >> DM_PAGE_BITS];
+  if(!*page){
+    if(!value)
+      return;       //  AN UNTOUCHED PAGE ALREADY READS AS 0
+    *page = calloc(DM_PAGE_WORDS,sizeof(int));
+    if(!*page){
+      fprintf(stderr, "APEX_Error : Out of memory for data page %d\n", address >> DM_PAGE_BITS);
+      exit(1);
+    }
+    m->pages++;
+  }
+  (*page)[address & (DM_PAGE_WORDS - 1)] = value;
+}
+
+void dm_print(struct DataMemory* m){   //  NON-ZERO WORDS OF THE ALLOCATED PAGES, IN ADDRESS ORDER
+  for(int p=0;p<DM_NUM_PAGES;p++){
+    if(!m->page[p])
+      continue;
+    for(int i=0;i<DM_PAGE_WORDS;i++){
+      if(m->page[p][i])
+        printf(" | MEM[%d] | Value=%d | \n",(p << DM_PAGE_BITS) + i,m->page[p][i]);
+    }
+  }
+  printf(" | Pages touched | %d of %d |\n",m->pages,DM_NUM_PAGES);
+  if(m->fault)
+    printf(" | Out of range access | address %d |\n",m->fault_address);
+}
@@ -42,6 +42,7 @@ create_APEX_instruction(APEX_Instruction* ins, char* buffer)
   char* token = strtok(buffer, ",");
   int token_num = 0;
   char tokens[6][128];
+  memset(ins, 0, sizeof(*ins));
   while (token != NULL) {
     strcpy(tokens[token_num], token);
     token_num++;
@@ -103,11 +104,23 @@ create_APEX_instruction(APEX_Instruction* ins, char* buffer)
     ins->rs2 = get_num_from_string(tokens[3]);
   }
   
+   if(strcmp(ins->opcode, "DIV")==0) {
+    ins->rd = get_num_from_string(tokens[1]);
+    ins->rs1 = get_num_from_string(tokens[2]);
+    ins->rs2 = get_num_from_string(tokens[3]);
+  }
+  
   if(strcmp(ins->opcode, "JUMP")==0) {
 	  ins->rs1 = get_num_from_string(tokens[1]); 
 	  ins->imm = get_num_from_string(tokens[2]);  
   }
   
+  if(strcmp(ins->opcode, "JAL")==0) {    // rd <- pc + 4, jump to rs1 + imm
+	  ins->rd = get_num_from_string(tokens[1]);
+	  ins->rs1 = get_num_from_string(tokens[2]);
+	  ins->imm = get_num_from_string(tokens[3]);
+  }
+  
   if(strcmp(ins->opcode, "BZ")==0) {
 	  ins->imm = get_num_from_string(tokens[1]);  
   }
@@ -120,6 +133,17 @@ create_APEX_instruction(APEX_Instruction* ins, char* buffer)
 	    
   }
   
+  if(strcmp(ins->opcode, "FADD")==0 || strcmp(ins->opcode, "SWAP")==0) {   // rd <- MEM[rs1], MEM[rs1] <- rd + rs2 / rs2
+    ins->rd = get_num_from_string(tokens[1]);
+    ins->rs1 = get_num_from_string(tokens[2]);
+    ins->rs2 = get_num_from_string(tokens[3]);
+    ins->imm = 0;
+  }
+  
+  if(strcmp(ins->opcode, "FENCE")==0) {
+	    
+  }
+  
   
   
   
@@ -0,0 +1,428 @@
+/*
+ *  functional.c
+ *  Instruction-at-a-time functional model of the APEX ISA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "functional.h"
+
+static const char* func_op_names[FUNC_NUM_OPS] = {
+  "NOP", "MOVC", "ADD", "SUB", "MUL", "DIV", "AND", "OR", "XOR",
+  "LOAD", "STORE", "BZ", "BNZ", "JUMP", "JAL", "HALT",
+  "FADD", "SWAP", "FENCE"
+};
+
+int func_decode_opcode(const char* opcode){   //  UNKNOWN OPCODES RETIRE WITHOUT ANY EFFECT
+  for(int i=1;i<FUNC_NUM_OPS;i++){
+    if(!strcmp(opcode,func_op_names[i]))
+      return i;
+  }
+  return FUNC_NOP;
+}
+
+const char* func_op_name(int op){
+  if(op < 0 || op >= FUNC_NUM_OPS)
+    return "?";
+  return func_op_names[op];
+}
+
+static bool reg_ok(int r){
+  return r >= 0 && r < FUNC_NUM_REGS;
+}
+
+/*
+ * Only the fields the parser fills in for an opcode are meaningful, the
+ * rest of the code memory entry is left uninitialized, so copy just those.
+ */
+static bool func_decode(struct FuncInstruction* to, APEX_Instruction* from){
+  memset(to,0,sizeof(*to));
+  to->op = func_decode_opcode(from->opcode);
+  switch(to->op){
+    case FUNC_MOVC:
+      to->rd = from->rd;
+      to->imm = from->imm;
+      return reg_ok(to->rd);
+    case FUNC_ADD: case FUNC_SUB: case FUNC_MUL: case FUNC_DIV:
+    case FUNC_AND: case FUNC_OR: case FUNC_XOR:
+      to->rd = from->rd;
+      to->rs1 = from->rs1;
+      to->rs2 = from->rs2;
+      return reg_ok(to->rd) && reg_ok(to->rs1) && reg_ok(to->rs2);
+    case FUNC_LOAD:
+      to->rd = from->rd;
+      to->rs1 = from->rs1;
+      to->imm = from->imm;
+      return reg_ok(to->rd) && reg_ok(to->rs1);
+    case FUNC_STORE:
+      to->rs1 = from->rs1;
+      to->rs2 = from->rs2;
+      to->imm = from->imm;
+      return reg_ok(to->rs1) && reg_ok(to->rs2);
+    case FUNC_BZ: case FUNC_BNZ:
+      to->imm = from->imm;
+      return true;
+    case FUNC_JUMP:
+      to->rs1 = from->rs1;
+      to->imm = from->imm;
+      return reg_ok(to->rs1);
+    case FUNC_JAL:
+      to->rd = from->rd;
+      to->rs1 = from->rs1;
+      to->imm = from->imm;
+      return reg_ok(to->rd) && reg_ok(to->rs1);
+    case FUNC_FADD: case FUNC_SWAP:
+      to->rd = from->rd;
+      to->rs1 = from->rs1;
+      to->rs2 = from->rs2;
+      return reg_ok(to->rd) && reg_ok(to->rs1) && reg_ok(to->rs2);
+    default:
+      return true;
+  }
+}
+
+bool func_init(struct FuncState* st, APEX_Instruction* code_memory, int code_memory_size){
+  memset(st,0,sizeof(*st));
+  st->code = malloc(sizeof(*st->code) * code_memory_size);
+  if(!st->code)
+    return false;
+  st->code_size = code_memory_size;
+  for(int i=0;i<code_memory_size;i++){
+    if(!func_decode(&st->code[i],&code_memory[i])){
+      fprintf(stderr, "APEX_Error : Register out of range in instruction %d (%s)\n", i, code_memory[i].opcode);
+      func_free(st);
+      return false;
+    }
+  }
+  st->pc = 4000;
+  return true;
+}
+
+void func_free(struct FuncState* st){
+  free(st->code);
+  st->code = NULL;
+  free(st->threaded);
+  st->threaded = NULL;
+  dm_free(&st->data_memory);
+  st->code_size = 0;
+}
+
+static bool mem_ok(int address){
+  return dm_valid(address);
+}
+
+/*
+ * Retires the instruction at st->pc and reports its architectural effects.
+ * Returns false once the model has halted or faulted.
+ */
+bool func_step(struct FuncState* st, struct FuncRetire* r){
+  int index = (st->pc - 4000) / 4;
+  if(st->halted || st->fault)
+    return false;
+  if(st->pc < 4000 || (st->pc - 4000) % 4 || index >= st->code_size){
+    st->fault = true;
+    return false;
+  }
+
+  struct FuncInstruction* ins = &st->code[index];
+  int* R = st->regs;
+  int next_pc = st->pc + 4;
+
+  memset(r,0,sizeof(*r));
+  r->pc = st->pc;
+  r->op = ins->op;
+  r->rd = ins->rd;
+
+  switch(ins->op){
+    case FUNC_MOVC:
+      r->value = ins->imm;
+      r->writes_reg = true;
+      break;
+    case FUNC_ADD:
+      r->value = R[ins->rs1] + R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_SUB:
+      r->value = R[ins->rs1] - R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_MUL:
+      r->value = R[ins->rs1] * R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_DIV:
+      if(R[ins->rs2] == 0){
+        st->fault = true;
+        return false;
+      }
+      r->value = R[ins->rs1] / R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_AND:
+      r->value = R[ins->rs1] & R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_OR:
+      r->value = R[ins->rs1] | R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_XOR:
+      r->value = R[ins->rs1] ^ R[ins->rs2];
+      r->writes_reg = true;
+      break;
+    case FUNC_LOAD:
+      r->is_mem = true;
+      r->mem_address = R[ins->rs1] + ins->imm;
+      if(!mem_ok(r->mem_address)){
+        st->fault = true;
+        return false;
+      }
+      r->value = dm_read(&st->data_memory,r->mem_address);
+      r->writes_reg = true;
+      break;
+    case FUNC_STORE:
+      r->is_mem = true;
+      r->mem_address = R[ins->rs2] + ins->imm;
+      r->store_data = R[ins->rs1];
+      if(!mem_ok(r->mem_address)){
+        st->fault = true;
+        return false;
+      }
+      dm_write(&st->data_memory,r->mem_address,r->store_data);
+      break;
+    case FUNC_BZ:
+      if(st->zero)
+        next_pc = st->pc + ins->imm;
+      break;
+    case FUNC_BNZ:
+      if(!st->zero)
+        next_pc = st->pc + ins->imm;
+      break;
+    case FUNC_JUMP:
+      next_pc = R[ins->rs1] + ins->imm;
+      break;
+    case FUNC_JAL:
+      r->value = st->pc + 4;
+      r->writes_reg = true;
+      next_pc = R[ins->rs1] + ins->imm;
+      break;
+    case FUNC_HALT:
+      st->halted = true;
+      break;
+    case FUNC_FADD: case FUNC_SWAP:   //  OLD VALUE TO rd, NEW VALUE IS THE STORE DATA
+      r->is_mem = true;
+      r->mem_address = R[ins->rs1];
+      if(!mem_ok(r->mem_address)){
+        st->fault = true;
+        return false;
+      }
+      r->value = dm_read(&st->data_memory,r->mem_address);
+      r->store_data = ins->op == FUNC_FADD ? r->value + R[ins->rs2] : R[ins->rs2];
+      r->writes_reg = true;
+      dm_write(&st->data_memory,r->mem_address,r->store_data);
+      break;
+    default:
+      break;
+  }
+
+  if(r->writes_reg)
+    R[ins->rd] = r->value;
+  if(ins->op == FUNC_ADD || ins->op == FUNC_SUB || ins->op == FUNC_MUL || ins->op == FUNC_DIV)
+    st->zero = (r->value == 0);
+
+  st->pc = next_pc;
+  st->retired++;
+  return true;
+}
+
+static struct FuncThreaded* threaded_at(struct FuncState* st, int pc){   //  THE ENTRY PAST THE END FOR A PC OUTSIDE THE CODE
+  if(pc < 4000 || (pc - 4000) % 4 || (pc - 4000) / 4 >= st->code_size)
+    return &st->threaded[st->code_size];
+  return &st->threaded[(pc - 4000) / 4];
+}
+
+static bool func_translate(struct FuncState* st, const void* const* labels, const void* bad_pc){
+  int n = st->code_size;
+  st->threaded = malloc(sizeof(*st->threaded) * (n + 1));
+  if(!st->threaded)
+    return false;
+  for(int i=0;i<=n;i++){
+    struct FuncThreaded* t = &st->threaded[i];
+    memset(t,0,sizeof(*t));
+    t->handler = bad_pc;
+    t->next_pc = 4000 + 4 * (i + 1);
+    t->target_pc = -1;
+  }
+  for(int i=0;i<n;i++){
+    struct FuncInstruction* ins = &st->code[i];
+    struct FuncThreaded* t = &st->threaded[i];
+    t->handler = labels[ins->op];
+    t->rd = ins->rd;
+    t->rs1 = ins->rs1;
+    t->rs2 = ins->rs2;
+    t->imm = ins->imm;
+    if(ins->op == FUNC_BZ || ins->op == FUNC_BNZ){    //  TAKEN TARGET IS FIXED, CHAIN IT NOW
+      t->target_pc = 4000 + 4 * i + ins->imm;
+      t->target = threaded_at(st,t->target_pc);
+    }
+  }
+  return true;
+}
+
+/*
+ * Fast-forward: retires up to max instructions with the same architectural
+ * results as func_step, stopping early at HALT or a fault, and returns how
+ * many retired. The first call translates the code into threaded code;
+ * every handler then jumps straight to the next one with a computed goto.
+ * BZ/BNZ hold a pointer to their taken target and JUMP/JAL to the last
+ * target they went to, so control transfers chain without a lookup.
+ */
+unsigned long func_run(struct FuncState* st, unsigned long max){
+  if(st->halted || st->fault || max == 0)
+    return 0;
+#if defined(__GNUC__)
+  static const void* const labels[FUNC_NUM_OPS] = {
+    [FUNC_NOP] = &&op_nop, [FUNC_MOVC] = &&op_movc, [FUNC_ADD] = &&op_add, [FUNC_SUB] = &&op_sub,
+    [FUNC_MUL] = &&op_mul, [FUNC_DIV] = &&op_div, [FUNC_AND] = &&op_and, [FUNC_OR] = &&op_or,
+    [FUNC_XOR] = &&op_xor, [FUNC_LOAD] = &&op_load, [FUNC_STORE] = &&op_store, [FUNC_BZ] = &&op_bz,
+    [FUNC_BNZ] = &&op_bnz, [FUNC_JUMP] = &&op_jump, [FUNC_JAL] = &&op_jal, [FUNC_HALT] = &&op_halt,
+    [FUNC_FADD] = &&op_fadd, [FUNC_SWAP] = &&op_swap, [FUNC_FENCE] = &&op_nop
+  };
+  if(!st->threaded && !func_translate(st,labels,&&op_bad_pc)){
+    struct FuncRetire r;
+    unsigned long n = 0;
+    while(n < max && func_step(st,&r))
+      n++;
+    return n;
+  }
+
+  struct FuncThreaded* const end = &st->threaded[st->code_size];
+  struct FuncThreaded* ip = threaded_at(st,st->pc);
+  int* R = st->regs;
+  bool zero = st->zero;
+  unsigned long left = max;
+  int bad_pc = (ip == end) ? st->pc : -1;   //  PC THAT LED PAST THE CODE, IF IT WAS NOT A FALL THROUGH
+  int address;
+  int target;
+
+/* Retire the handler's instruction and go to the next one */
+#define FUNC_DISPATCH(next) do{ ip = (next); if(--left == 0) goto out; goto *ip->handler; }while(0)
+
+  goto *ip->handler;
+
+op_nop:
+  FUNC_DISPATCH(ip + 1);
+op_movc:
+  R[ip->rd] = ip->imm;
+  FUNC_DISPATCH(ip + 1);
+op_add:
+  R[ip->rd] = R[ip->rs1] + R[ip->rs2];
+  zero = R[ip->rd] == 0;
+  FUNC_DISPATCH(ip + 1);
+op_sub:
+  R[ip->rd] = R[ip->rs1] - R[ip->rs2];
+  zero = R[ip->rd] == 0;
+  FUNC_DISPATCH(ip + 1);
+op_mul:
+  R[ip->rd] = R[ip->rs1] * R[ip->rs2];
+  zero = R[ip->rd] == 0;
+  FUNC_DISPATCH(ip + 1);
+op_div:
+  if(R[ip->rs2] == 0)
+    goto fault;
+  R[ip->rd] = R[ip->rs1] / R[ip->rs2];
+  zero = R[ip->rd] == 0;
+  FUNC_DISPATCH(ip + 1);
+op_and:
+  R[ip->rd] = R[ip->rs1] & R[ip->rs2];
+  FUNC_DISPATCH(ip + 1);
+op_or:
+  R[ip->rd] = R[ip->rs1] | R[ip->rs2];
+  FUNC_DISPATCH(ip + 1);
+op_xor:
+  R[ip->rd] = R[ip->rs1] ^ R[ip->rs2];
+  FUNC_DISPATCH(ip + 1);
+op_load:
+  address = R[ip->rs1] + ip->imm;
+  if(!mem_ok(address))
+    goto fault;
+  R[ip->rd] = dm_read(&st->data_memory,address);
+  FUNC_DISPATCH(ip + 1);
+op_store:
+  address = R[ip->rs2] + ip->imm;
+  if(!mem_ok(address))
+    goto fault;
+  dm_write(&st->data_memory,address,R[ip->rs1]);
+  FUNC_DISPATCH(ip + 1);
+op_bz:
+  if(!zero)
+    FUNC_DISPATCH(ip + 1);
+  if(ip->target == end)
+    bad_pc = ip->target_pc;
+  FUNC_DISPATCH(ip->target);
+op_bnz:
+  if(zero)
+    FUNC_DISPATCH(ip + 1);
+  if(ip->target == end)
+    bad_pc = ip->target_pc;
+  FUNC_DISPATCH(ip->target);
+op_jump:
+  target = R[ip->rs1] + ip->imm;
+  if(target != ip->target_pc){
+    ip->target_pc = target;
+    ip->target = threaded_at(st,target);
+  }
+  if(ip->target == end)
+    bad_pc = target;
+  FUNC_DISPATCH(ip->target);
+op_jal:
+  target = R[ip->rs1] + ip->imm;
+  if(target != ip->target_pc){
+    ip->target_pc = target;
+    ip->target = threaded_at(st,target);
+  }
+  if(ip->target == end)
+    bad_pc = target;
+  R[ip->rd] = ip->next_pc;      //  AFTER READING rs1, rd MAY BE THE SAME REGISTER
+  FUNC_DISPATCH(ip->target);
+op_fadd:
+  address = R[ip->rs1];
+  if(!mem_ok(address))
+    goto fault;
+  target = dm_read(&st->data_memory,address);
+  dm_write(&st->data_memory,address,target + R[ip->rs2]);
+  R[ip->rd] = target;
+  FUNC_DISPATCH(ip + 1);
+op_swap:
+  address = R[ip->rs1];
+  if(!mem_ok(address))
+    goto fault;
+  target = dm_read(&st->data_memory,address);
+  dm_write(&st->data_memory,address,R[ip->rs2]);
+  R[ip->rd] = target;
+  FUNC_DISPATCH(ip + 1);
+op_halt:
+  st->halted = true;
+  ip++;
+  left--;
+  goto out;
+op_bad_pc:
+fault:
+  st->fault = true;
+
+out:
+  st->pc = (ip == end && bad_pc != -1) ? bad_pc : 4000 + 4 * (int)(ip - st->threaded);
+  st->zero = zero;
+  st->retired += max - left;
+  return max - left;
+#undef FUNC_DISPATCH
+#else
+  struct FuncRetire r;
+  unsigned long n = 0;
+  while(n < max && func_step(st,&r))
+    n++;
+  return n;
+#endif
+}
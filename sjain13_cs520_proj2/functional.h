@@ -0,0 +1,95 @@
+#ifndef _APEX_FUNCTIONAL_H_
+#define _APEX_FUNCTIONAL_H_
+/**
+ *  functional.h
+ *  Instruction-at-a-time functional model of the APEX ISA
+ *
+ *  Executes code memory with architectural semantics only (no timing),
+ *  used as the reference for the lockstep checker.
+ */
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "datamem.h"
+
+#define FUNC_NUM_REGS 16
+
+enum
+{
+  FUNC_NOP,
+  FUNC_MOVC,
+  FUNC_ADD,
+  FUNC_SUB,
+  FUNC_MUL,
+  FUNC_DIV,
+  FUNC_AND,
+  FUNC_OR,
+  FUNC_XOR,
+  FUNC_LOAD,
+  FUNC_STORE,
+  FUNC_BZ,
+  FUNC_BNZ,
+  FUNC_JUMP,
+  FUNC_JAL,
+  FUNC_HALT,
+  FUNC_FADD,
+  FUNC_SWAP,
+  FUNC_FENCE,
+  FUNC_NUM_OPS
+};
+
+/* Pre-decoded instruction, opcode string resolved once at load time */
+struct FuncInstruction{
+  int op;
+  int rd;
+  int rs1;
+  int rs2;
+  int imm;
+};
+
+/* Threaded code for func_run, one entry per instruction plus one past the end */
+struct FuncThreaded{
+  const void* handler;      // Label in func_run
+  int rd;
+  int rs1;
+  int rs2;
+  int imm;
+  int next_pc;              // PC of the following instruction, written by JAL
+  struct FuncThreaded* target;    // BZ/BNZ taken path, last JUMP/JAL target
+  int target_pc;            // PC of target for JUMP/JAL, -1 before the first
+};
+
+/* Architectural state of the functional model */
+struct FuncState{
+  struct FuncInstruction* code;
+  struct FuncThreaded* threaded;  // Built by the first func_run
+  int code_size;
+  int pc;
+  int regs[FUNC_NUM_REGS];
+  bool zero;                 // Zero flag of the last arithmetic instruction
+  struct DataMemory data_memory;
+  bool halted;
+  bool fault;                // Bad PC or data address, model cannot continue
+  unsigned long retired;
+};
+
+/* Architectural effects of one retired instruction */
+struct FuncRetire{
+  int pc;
+  int op;
+  bool writes_reg;
+  int rd;
+  int value;
+  bool is_mem;
+  int mem_address;
+  int store_data;
+};
+
+bool func_init(struct FuncState*, APEX_Instruction*, int);
+void func_free(struct FuncState*);
+bool func_step(struct FuncState*, struct FuncRetire*);
+unsigned long func_run(struct FuncState*, unsigned long);
+int func_decode_opcode(const char*);
+const char* func_op_name(int);
+
+#endif
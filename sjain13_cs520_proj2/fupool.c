@@ -0,0 +1,175 @@
+/*
+ *  fupool.c
+ *  Functional unit pool: unit occupancy, issue ports and completion timing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "fupool.h"
+#include "config.h"
+
+struct FuOp{
+  bool valid;
+  int cls;
+  int cod;
+  unsigned long done;     // Cycle the result is available
+};
+
+static const char* fu_names[FU_NUM_CLASSES] = { "INT", "MUL", "DIV" };
+static const char* fu_letters = "IMD";               //  Port map letter of each class
+
+static unsigned long unit_free[FU_NUM_CLASSES][FU_MAX_UNITS];    // First cycle the unit accepts a new operation
+static bool port_used[FU_MAX_PORTS];
+static struct FuOp ops[FU_MAX_INFLIGHT];
+static unsigned long fu_cycle = 0;
+
+static unsigned long issued[FU_NUM_CLASSES];
+static unsigned long busy_cycles[FU_NUM_CLASSES];
+
+int fu_class_of(const char* op){   //  -1 FOR OPERATIONS THAT DO NOT GO THROUGH THE POOL
+  if(!strcmp(op,"MUL"))
+    return FU_MUL;
+  if(!strcmp(op,"DIV"))
+    return FU_DIV;
+  if(!strcmp(op,"ADD") || !strcmp(op,"SUB") || !strcmp(op,"AND") || !strcmp(op,"OR")
+     || !strcmp(op,"XOR") || !strcmp(op,"EX-OR") || !strcmp(op,"MOVC"))
+    return FU_INT;
+  return -1;
+}
+
+/*
+ * count:latency[:p|u], e.g. "2:3:u" for two unpipelined 3-cycle units.
+ */
+bool fu_parse_class(int cls, const char* value){
+  struct FuClass* c = &sim_config.fu[cls];
+  char mode = 'p';
+  int n = sscanf(value,"%d:%d:%c",&c->count,&c->latency,&mode);
+  if(n < 2 || (mode != 'p' && mode != 'u'))
+    return false;
+  c->pipelined = mode == 'p';
+  return c->count >= 1 && c->count <= FU_MAX_UNITS && c->latency >= 1 && c->latency <= 64;
+}
+
+/*
+ * Comma separated ports, each listing the classes it serves, e.g. "IM,ID"
+ * for two ports that both take INT and one of MUL or DIV.
+ */
+bool fu_parse_ports(const char* value){
+  int p = 0;
+  sim_config.port_mask[0] = 0;
+  for(const char* s=value;*s;s++){
+    if(*s == ','){
+      if(!sim_config.port_mask[p] || ++p == FU_MAX_PORTS)
+        return false;
+      sim_config.port_mask[p] = 0;
+      continue;
+    }
+    const char* l = strchr(fu_letters,*s);
+    if(!l)
+      return false;
+    sim_config.port_mask[p] |= 1 << (l - fu_letters);
+  }
+  if(!sim_config.port_mask[p])
+    return false;
+  sim_config.ports = p + 1;
+  return true;
+}
+
+void fu_init(){
+  memset(unit_free,0,sizeof(unit_free));
+  memset(port_used,0,sizeof(port_used));
+  memset(ops,0,sizeof(ops));
+  memset(issued,0,sizeof(issued));
+  memset(busy_cycles,0,sizeof(busy_cycles));
+  fu_cycle = 0;
+}
+
+static int free_port(int cls){
+  for(int p=0;p<sim_config.ports;p++){
+    if(!port_used[p] && (sim_config.port_mask[p] & (1 << cls)))
+      return p;
+  }
+  return -1;
+}
+
+static int free_unit(int cls){
+  for(int u=0;u<sim_config.fu[cls].count;u++){
+    if(unit_free[cls][u] <= fu_cycle)
+      return u;
+  }
+  return -1;
+}
+
+bool fu_can_issue(int cls){   //  A UNIT OF THIS CLASS AND A PORT SERVING IT ARE BOTH FREE THIS CYCLE
+  return free_unit(cls) != -1 && free_port(cls) != -1;
+}
+
+/*
+ * Starts an operation of class cls for the instruction with the given cod.
+ * Returns the slot to hand to the caller's instruction copy, -1 when no
+ * unit or port is free.
+ */
+int fu_issue(int cls, int cod){
+  int u = free_unit(cls);
+  int p = free_port(cls);
+  if(u == -1 || p == -1)
+    return -1;
+  for(int i=0;i<FU_MAX_INFLIGHT;i++){
+    if(ops[i].valid)
+      continue;
+    struct FuClass* c = &sim_config.fu[cls];
+    ops[i].valid = true;
+    ops[i].cls = cls;
+    ops[i].cod = cod;
+    ops[i].done = fu_cycle + c->latency;
+    unit_free[cls][u] = fu_cycle + (c->pipelined ? 1 : c->latency);
+    port_used[p] = true;
+    issued[cls]++;
+    return i;
+  }
+  return -1;
+}
+
+bool fu_complete(int* slot){   //  OLDEST OPERATION WHOSE RESULT IS READY THIS CYCLE, FALSE WHEN THERE IS NONE
+  int best = -1;
+  for(int i=0;i<FU_MAX_INFLIGHT;i++){
+    if(ops[i].valid && ops[i].done <= fu_cycle && (best == -1 || ops[i].cod < ops[best].cod))
+      best = i;
+  }
+  if(best == -1)
+    return false;
+  ops[best].valid = false;
+  *slot = best;
+  return true;
+}
+
+void fu_squash_younger(int cod){
+  for(int i=0;i<FU_MAX_INFLIGHT;i++){
+    if(ops[i].valid && ops[i].cod > cod)
+      ops[i].valid = false;
+  }
+}
+
+void fu_tick(){   //  END OF CYCLE: ACCOUNT OCCUPANCY AND FREE THE PORTS
+  for(int cls=0;cls<FU_NUM_CLASSES;cls++){
+    for(int u=0;u<sim_config.fu[cls].count;u++){
+      if(unit_free[cls][u] > fu_cycle)
+        busy_cycles[cls]++;
+    }
+  }
+  memset(port_used,0,sizeof(port_used));
+  fu_cycle++;
+}
+
+void fu_print_stats(){
+  printf("=======FUNCTIONAL UNITS========\n");
+  for(int cls=0;cls<FU_NUM_CLASSES;cls++){
+    struct FuClass* c = &sim_config.fu[cls];
+    printf(" | %-3s | %d x %d cycle%s %s | issued %lu | utilization %.2f%% |\n",
+           fu_names[cls],c->count,c->latency,c->latency == 1 ? "" : "s",c->pipelined ? "pipelined" : "unpipelined",
+           issued[cls],
+           fu_cycle ? 100.0 * busy_cycles[cls] / (fu_cycle * c->count) : 0.0);
+  }
+}
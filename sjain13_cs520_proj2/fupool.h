@@ -0,0 +1,45 @@
+#ifndef _APEX_FUPOOL_H_
+#define _APEX_FUPOOL_H_
+/**
+ *  fupool.h
+ *  Pool of functional units with per-class count, latency and issue ports
+ *
+ *  Every class (INT, MUL, DIV) has sim_config-selected number of units, a
+ *  latency and whether a unit is pipelined (accepts a new operation every
+ *  cycle) or busy for the whole latency. Issue goes through ports; each
+ *  port can start one operation per cycle of the classes in its mask.
+ *  Operations are identified by the slot returned from fu_issue(), the
+ *  caller keeps the instruction itself.
+ */
+#include <stdbool.h>
+
+enum
+{
+  FU_INT,
+  FU_MUL,
+  FU_DIV,
+  FU_NUM_CLASSES
+};
+
+#define FU_MAX_UNITS 8
+#define FU_MAX_PORTS 8
+#define FU_MAX_INFLIGHT 64
+
+struct FuClass{
+  int count;
+  int latency;
+  bool pipelined;
+};
+
+void fu_init();
+bool fu_parse_class(int, const char*);
+bool fu_parse_ports(const char*);
+int fu_class_of(const char*);
+bool fu_can_issue(int);
+int fu_issue(int, int);
+bool fu_complete(int*);
+void fu_squash_younger(int);
+void fu_tick();
+void fu_print_stats();
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ *  hosttimer.c
+ *  Host time spent in each part of the simulator, for profiling the simulator itself
+ */
+#include "hosttimer.h"
+
+#if ENABLE_HOST_TIMERS && defined(__GNUC__)
+
+#include <stdio.h>
+
+unsigned long long ht_ticks[HT_NUM_TIMERS];
+
+static const char* names[HT_NUM_TIMERS] = {
+  "Fetch      ", "Decode     ", " Dispatch  ", "Execute    ", "Memory     ", "Writeback  ",
+  " IQ bcast  ", " LSQ bcast "
+};
+static unsigned long long start_ticks;
+static double start_ns;
+
+static double wall_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void ht_init(){
+  for(int t=0;t<HT_NUM_TIMERS;t++)
+    ht_ticks[t] = 0;
+  start_ticks = ht_now();
+  start_ns = wall_ns();
+}
+
+/*
+ * Ticks are converted with the rate measured between ht_init() and now,
+ * so a TSC that does not tick at the nominal frequency is still right.
+ */
+void ht_print_stats(int cycles){
+  double elapsed = wall_ns() - start_ns;
+  unsigned long long ticks = ht_now() - start_ticks;
+  double ns_per_tick = ticks ? elapsed / ticks : 0;
+
+  printf("=======HOST TIME (NS PER CYCLE)========\n");
+  for(int t=0;t<HT_NUM_TIMERS;t++)
+    printf(" | %s | %.1f |\n", names[t], cycles ? ht_ticks[t] * ns_per_tick / cycles : 0);
+  printf(" | Total       | %.1f |\n", cycles ? elapsed / cycles : 0);
+}
+
+#endif
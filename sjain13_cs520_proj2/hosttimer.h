@@ -0,0 +1,76 @@
+#ifndef _APEX_HOSTTIMER_H_
+#define _APEX_HOSTTIMER_H_
+/**
+ *  hosttimer.h
+ *  Host time spent in each part of the simulator, for profiling the simulator itself
+ *
+ *  HOST_TIMER_SCOPE(HT_x) at the top of a function body adds the host time
+ *  from there to the end of the block to timer HT_x, whichever return the
+ *  block leaves by. Time is read with rdtsc on x86 and converted to ns
+ *  against the wall clock over the whole run; elsewhere it is the
+ *  monotonic clock directly. Timers nest: dispatch and the broadcast
+ *  loops are also counted in the stage that runs them.
+ *
+ *  Off unless built with ENABLE_HOST_TIMERS=1 (make HOST_TIMERS=1); then
+ *  every macro expands to nothing and the simulator pays nothing.
+ */
+#ifndef ENABLE_HOST_TIMERS
+#define ENABLE_HOST_TIMERS 0
+#endif
+
+enum
+{
+  HT_FETCH,
+  HT_DECODE,
+  HT_DISPATCH,
+  HT_EXECUTE,
+  HT_MEMORY,
+  HT_WRITEBACK,
+  HT_IQ_BROADCAST,
+  HT_LSQ_BROADCAST,
+  HT_NUM_TIMERS
+};
+
+#if ENABLE_HOST_TIMERS && defined(__GNUC__)
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+struct HostTimerScope{
+  int timer;
+  unsigned long long start;
+};
+
+extern unsigned long long ht_ticks[HT_NUM_TIMERS];
+
+static inline unsigned long long ht_now(){
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline void ht_stop(struct HostTimerScope* s){
+  ht_ticks[s->timer] += ht_now() - s->start;
+}
+
+#define HOST_TIMER_SCOPE(t) \
+  struct HostTimerScope ht_scope __attribute__((cleanup(ht_stop))) = { (t), ht_now() }
+
+void ht_init();
+void ht_print_stats(int);
+
+#else
+
+#define HOST_TIMER_SCOPE(t)
+#define ht_init()
+#define ht_print_stats(cycles)
+
+#endif
+
+#endif
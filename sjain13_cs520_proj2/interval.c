@@ -0,0 +1,73 @@
+/*
+ *  interval.c
+ *  Interval statistics, one CSV row every sim_config.interval cycles
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "interval.h"
+
+static FILE* fp = NULL;
+static char buffer[1 << 16];        // Rows go out in large writes
+static struct IntervalCounters last;
+static int last_cycle = 0;
+static unsigned long rob_sum = 0;
+static unsigned long iq_sum = 0;
+static unsigned long lsq_sum = 0;
+
+bool interval_open(const char* path){
+  fp = fopen(path, "w");
+  if(!fp)
+    return false;
+  setvbuf(fp, buffer, _IOFBF, sizeof(buffer));
+  memset(&last, 0, sizeof(last));
+  last_cycle = 0;
+  rob_sum = iq_sum = lsq_sum = 0;
+  fprintf(fp, "cycle,ipc,committed,rob,iq,lsq,l1i_miss_rate,l1d_miss_rate,l2_miss_rate,"
+              "icache_stalls,fetch_buffer_full,decode_starved,iq_full,memory_busy\n");
+  return true;
+}
+
+void interval_cycle(int rob, int iq, int lsq){
+  rob_sum += rob;
+  iq_sum += iq;
+  lsq_sum += lsq;
+}
+
+static double rate(unsigned long misses, unsigned long accesses){
+  return accesses ? (double)misses / accesses : 0.0;
+}
+
+/*
+ * Row for the cycles since the previous one, cycle is the number of cycles
+ * simulated so far.
+ */
+void interval_write(int cycle, const struct IntervalCounters* now){
+  int cycles = cycle - last_cycle;
+  if(!fp || cycles <= 0)
+    return;
+  unsigned long committed = now->committed - last.committed;
+  fprintf(fp, "%d,%.4f,%lu,%.2f,%.2f,%.2f,%.4f,%.4f,%.4f,%lu,%lu,%lu,%lu,%lu\n",
+          cycle, (double)committed / cycles, committed,
+          (double)rob_sum / cycles, (double)iq_sum / cycles, (double)lsq_sum / cycles,
+          rate(now->l1i_misses - last.l1i_misses, now->l1i_accesses - last.l1i_accesses),
+          rate(now->l1d_misses - last.l1d_misses, now->l1d_accesses - last.l1d_accesses),
+          rate(now->l2_misses - last.l2_misses, now->l2_accesses - last.l2_accesses),
+          now->icache_stalls - last.icache_stalls,
+          now->fetch_buffer_full - last.fetch_buffer_full,
+          now->decode_starved - last.decode_starved,
+          now->iq_full - last.iq_full,
+          now->memory_busy - last.memory_busy);
+  last = *now;
+  last_cycle = cycle;
+  rob_sum = iq_sum = lsq_sum = 0;
+}
+
+void interval_close(int cycle, const struct IntervalCounters* now){
+  if(!fp)
+    return;
+  interval_write(cycle, now);
+  fclose(fp);
+  fp = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef _APEX_INTERVAL_H_
+#define _APEX_INTERVAL_H_
+/**
+ *  interval.h
+ *  Interval statistics, one CSV row every sim_config.interval cycles
+ *
+ *  The core adds its ROB, IQ and LSQ occupancy every cycle and hands over
+ *  its cumulative counters at the end of every interval; a row holds the
+ *  averages and deltas over that interval only, so phases of the program
+ *  show up as changes between rows. The last, possibly shorter, interval
+ *  is written when the file is closed.
+ */
+#include <stdbool.h>
+
+/* Counters of the core, cumulative since the start of the run */
+struct IntervalCounters{
+  unsigned long committed;
+  unsigned long l1i_accesses;
+  unsigned long l1i_misses;
+  unsigned long l1d_accesses;
+  unsigned long l1d_misses;
+  unsigned long l2_accesses;
+  unsigned long l2_misses;
+  unsigned long icache_stalls;      // Fetch waiting for the I-cache
+  unsigned long fetch_buffer_full;
+  unsigned long decode_starved;     // Decode found the fetch buffer empty
+  unsigned long iq_full;            // Dispatch refused by a full IQ
+  unsigned long memory_busy;        // Memory stage held by an atomic or FENCE
+};
+
+bool interval_open(const char*);
+void interval_cycle(int, int, int);
+void interval_write(int, const struct IntervalCounters*);
+void interval_close(int, const struct IntervalCounters*);
+
+#endif
@@ -2,15 +2,28 @@
 #include <stdlib.h>
 
 #include "cpu.h"
+#include "config.h"
 
 int
 main(int argc, char const* argv[])
 {
-  if (argc != 4) {
-    fprintf(stderr, "APEX_Help : Usage %s <input_file>\n", argv[0]);
+  if (argc < 4) {
+    fprintf(stderr, "APEX_Help : Usage %s <input_file> <simulate|display> <cycles> [key=value ...]\n", argv[0]);
+    config_print_usage();
     exit(1);
   }
 
+  config_init();
+  for (int i = 4; i < argc; ++i) {
+    if (!config_parse_option(argv[i])) {
+      fprintf(stderr, "APEX_Error : Unknown option %s\n", argv[i]);
+      config_print_usage();
+      exit(1);
+    }
+  }
+  if (!config_check())
+    exit(1);
+
   APEX_CPU* cpu = APEX_cpu_init(argv[1]);
   if (!cpu) {
     fprintf(stderr, "APEX_Error : Unable to initialize CPU\n");
@@ -0,0 +1,149 @@
+/*
+ *  memdep.c
+ *  Store-set memory dependence predictor
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "memdep.h"
+#include "storeq.h"
+#include "config.h"
+
+struct PredictedLoad{
+  bool valid;
+  int cod;
+  int store_cod;        // Store the LOAD is predicted to depend on
+  bool counted;
+};
+
+static int* ssit;                           // Store set id per PC, -1 for none
+static int ssit_mask;
+static int lfst[MD_LFST_SIZE];              // cod of the last dispatched store of each set, -1 for none
+static int next_set = 0;
+static unsigned long dispatches = 0;
+static struct PredictedLoad pending[MD_MAX_LOADS];
+
+static unsigned long predicted_dependent = 0;
+static unsigned long violated = 0;
+static unsigned long replayed = 0;
+
+static void clear_tables(){
+  for(int i=0;i<=ssit_mask;i++)
+    ssit[i] = -1;
+  for(int s=0;s<MD_LFST_SIZE;s++)
+    lfst[s] = -1;
+  next_set = 0;
+}
+
+void md_init(){
+  ssit_mask = (1 << sim_config.store_sets) - 1;
+  ssit = malloc(sizeof(int) * (ssit_mask + 1));
+  clear_tables();
+  memset(pending,0,sizeof(pending));
+  dispatches = predicted_dependent = violated = replayed = 0;
+}
+
+void md_free(){
+  free(ssit);
+  ssit = NULL;
+}
+
+static int* entry(int pc){
+  return &ssit[(pc >> 2) & ssit_mask];
+}
+
+static void tick(){   //  FORGET EVERY SET NOW AND THEN SO STALE DEPENDENCES DO NOT SERIALIZE FOREVER
+  if(++dispatches % MD_CLEAR_INTERVAL == 0)
+    clear_tables();
+}
+
+void md_dispatch_store(int cod, int pc){
+  int set = *entry(pc);
+  tick();
+  if(set != -1)
+    lfst[set] = cod;
+}
+
+void md_dispatch_load(int cod, int pc){
+  int set = *entry(pc);
+  tick();
+  if(set == -1 || lfst[set] == -1 || lfst[set] > cod)
+    return;
+  for(int i=0;i<MD_MAX_LOADS;i++){
+    if(pending[i].valid)
+      continue;
+    pending[i] = (struct PredictedLoad){ true, cod, lfst[set], false };
+    return;
+  }
+}
+
+/*
+ * Called when the LOAD with the given cod is considered for issue; true
+ * while the store it is predicted to depend on has no address yet.
+ */
+bool md_must_wait(int cod){
+  for(int i=0;i<MD_MAX_LOADS;i++){
+    if(!pending[i].valid || pending[i].cod != cod)
+      continue;
+    if(!stq_store_unresolved(pending[i].store_cod)){
+      pending[i].valid = false;
+      return false;
+    }
+    if(!pending[i].counted){
+      pending[i].counted = true;
+      predicted_dependent++;
+    }
+    return true;
+  }
+  return false;
+}
+
+void md_violation(int store_pc, int load_pc){   //  MERGE THE TWO INTO ONE STORE SET
+  int* s = entry(store_pc);
+  int* l = entry(load_pc);
+  violated++;
+  if(*s == -1 && *l == -1){
+    *s = *l = next_set;
+    next_set = (next_set + 1) % MD_LFST_SIZE;
+  }
+  else if(*s == -1)
+    *s = *l;
+  else if(*l == -1)
+    *l = *s;
+  else if(*s < *l)
+    *l = *s;
+  else
+    *s = *l;
+}
+
+void md_replayed(){
+  replayed++;
+}
+
+void md_retire_load(int cod){
+  for(int i=0;i<MD_MAX_LOADS;i++){
+    if(pending[i].valid && pending[i].cod == cod)
+      pending[i].valid = false;
+  }
+}
+
+void md_squash_younger(int cod){
+  for(int i=0;i<MD_MAX_LOADS;i++){
+    if(pending[i].valid && pending[i].cod > cod)
+      pending[i].valid = false;
+  }
+  for(int s=0;s<MD_LFST_SIZE;s++){
+    if(lfst[s] > cod)
+      lfst[s] = -1;
+  }
+}
+
+void md_print_stats(){
+  printf("=======MEMORY DEPENDENCE========\n");
+  printf(" | Store set table     | 2^%d entries |\n",sim_config.store_sets);
+  printf(" | Predicted dependent | %lu |\n",predicted_dependent);
+  printf(" | Violated            | %lu |\n",violated);
+  printf(" | Replayed            | %lu |\n",replayed);
+}
@@ -0,0 +1,31 @@
+#ifndef _APEX_MEMDEP_H_
+#define _APEX_MEMDEP_H_
+/**
+ *  memdep.h
+ *  Store-set memory dependence predictor
+ *
+ *  Loads and stores that once caused an ordering violation are put in the
+ *  same store set (SSIT, indexed by PC). Every dispatched store of a set
+ *  becomes the set's last fetched store (LFST); a LOAD dispatched later in
+ *  the same set is predicted dependent on it and is not selected from the
+ *  LSQ until that store's address is known. Other loads still issue
+ *  speculatively.
+ */
+#include <stdbool.h>
+
+#define MD_LFST_SIZE 128
+#define MD_MAX_LOADS 32
+#define MD_CLEAR_INTERVAL 30000     // Dispatches between clearing the SSIT
+
+void md_init();
+void md_free();
+void md_dispatch_store(int, int);
+void md_dispatch_load(int, int);
+bool md_must_wait(int);
+void md_violation(int, int);
+void md_replayed();
+void md_retire_load(int);
+void md_squash_younger(int);
+void md_print_stats();
+
+#endif
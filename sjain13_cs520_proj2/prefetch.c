@@ -0,0 +1,93 @@
+/*
+ *  prefetch.c
+ *  Next-line and PC-indexed stride prefetchers for the L1D
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "prefetch.h"
+#include "config.h"
+
+struct StrideEntry{
+  int pc;               // -1 for an unused entry
+  int last;             // Byte address of the previous access
+  int stride;
+  int confidence;       // Saturates at 3, prefetch from 2
+};
+
+static const char* pf_names[PF_NUM_TYPES] = { "none", "nextline", "stride" };
+static struct StrideEntry table[PF_TABLE_SIZE];
+
+static unsigned long trained = 0;
+static unsigned long triggers = 0;
+
+int pf_parse_type(const char* name){   //  -1 FOR AN UNKNOWN PREFETCHER NAME
+  for(int i=0;i<PF_NUM_TYPES;i++){
+    if(!strcmp(name,pf_names[i]))
+      return i;
+  }
+  return -1;
+}
+
+void pf_init(){
+  for(int i=0;i<PF_TABLE_SIZE;i++)
+    table[i].pc = -1;
+  trained = triggers = 0;
+}
+
+static void issue(struct Cache* c, int address, int step, unsigned long now){   //  degree REQUESTS, THE FIRST distance STEPS AHEAD
+  triggers++;
+  for(int i=0;i<sim_config.pf_degree;i++)
+    cache_prefetch(c, address + step * (sim_config.pf_distance + i), now);
+}
+
+static void train_stride(struct Cache* c, int pc, int address, unsigned long now){
+  struct StrideEntry* e = &table[(pc >> 2) % PF_TABLE_SIZE];
+  if(e->pc != pc){
+    *e = (struct StrideEntry){ pc, address, 0, 0 };
+    return;
+  }
+  int stride = address - e->last;
+  if(stride != 0 && stride == e->stride){
+    if(e->confidence < 3)
+      e->confidence++;
+  }
+  else if(e->confidence > 0)
+    e->confidence--;
+  else
+    e->stride = stride;
+  e->last = address;
+  if(e->confidence >= 2)
+    issue(c, address, e->stride, now);
+}
+
+/*
+ * Called for every LOAD that accessed the L1D at byte address, with whether
+ * it missed and whether it was the first use of a prefetched line.
+ */
+void pf_train(struct Cache* c, int pc, int address, bool miss, bool prefetch_hit, unsigned long now){
+  trained++;
+  if(sim_config.prefetch == PF_STRIDE)
+    train_stride(c, pc, address, now);
+  else if(sim_config.prefetch == PF_NEXTLINE && (miss || prefetch_hit))
+    issue(c, address - address % c->cfg.line_size, c->cfg.line_size, now);
+}
+
+void pf_print_stats(struct Cache* c){
+  printf("=======PREFETCHER========\n");
+  printf(" | Algorithm      | %s, degree %d, distance %d |\n",pf_names[sim_config.prefetch],sim_config.pf_degree,sim_config.pf_distance);
+  printf(" | Loads trained  | %lu |\n",trained);
+  printf(" | Triggers       | %lu |\n",triggers);
+  printf(" | Issued         | %lu |\n",c->pf_issued);
+  printf(" | Dropped        | %lu |\n",c->pf_dropped);
+  printf(" | Useful         | %lu |\n",c->pf_useful);
+  printf(" | Late           | %lu |\n",c->pf_late);
+  printf(" | Evicted unused | %lu |\n",c->pf_useless);
+  if(c->pf_issued)
+    printf(" | Accuracy       | %.2f%% |\n",100.0 * c->pf_useful / c->pf_issued);
+  if(c->pf_useful + c->misses)
+    printf(" | Coverage       | %.2f%% |\n",100.0 * c->pf_useful / (c->pf_useful + c->misses));
+  if(c->pf_useful)
+    printf(" | Timely         | %.2f%% |\n",100.0 * (c->pf_useful - c->pf_late) / c->pf_useful);
+}
@@ -0,0 +1,32 @@
+#ifndef _APEX_PREFETCH_H_
+#define _APEX_PREFETCH_H_
+/**
+ *  prefetch.h
+ *  Data prefetchers trained by the LOADs leaving the LSQ
+ *
+ *  NEXTLINE streams ahead on every L1D miss and every first use of a
+ *  prefetched line. STRIDE keeps a PC-indexed reference prediction table:
+ *  once a LOAD has shown the same address delta twice in a row, the lines
+ *  distance .. distance+degree-1 strides ahead are requested. Prefetches
+ *  are fills into the L1D that never hold up a demand miss.
+ */
+#include <stdbool.h>
+
+#include "cache.h"
+
+enum
+{
+  PF_NONE,
+  PF_NEXTLINE,
+  PF_STRIDE,
+  PF_NUM_TYPES
+};
+
+#define PF_TABLE_SIZE 64        // Stride table entries, direct mapped by PC
+
+int pf_parse_type(const char*);
+void pf_init();
+void pf_train(struct Cache*, int, int, bool, bool, unsigned long);
+void pf_print_stats(struct Cache*);
+
+#endif
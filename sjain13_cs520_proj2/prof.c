@@ -0,0 +1,160 @@
+/*
+ *  prof.c
+ *  Instruction-level profiler, per static PC
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "prof.h"
+
+struct PcProfile{
+  char text[PROF_TEXT];             // Line of the input file
+  unsigned long committed;
+  unsigned long latency;            // Issue to completion, summed over the samples
+  unsigned long samples;
+  unsigned long head_cycles;        // At the ROB head and not committed at the end of the cycle
+  unsigned long mispredicts;
+  unsigned long squashed;
+};
+
+struct InFlight{
+  int cod;                          // -1 when free
+  int issue_cycle;
+};
+
+static struct PcProfile* pcs = NULL;
+static int size = 0;
+static struct InFlight inflight[PROF_WINDOW];
+static int cycle = 0;
+
+static struct PcProfile* at(int pc){
+  int index = (pc - 4000) / 4;
+  if(pc < 4000 || index >= size)
+    return NULL;
+  return &pcs[index];
+}
+
+/*
+ * Code memory has one instruction per line of the input file, so line i
+ * is the text of PC 4000 + 4 * i.
+ */
+bool prof_init(const char* filename, int code_size){
+  FILE* fp = fopen(filename, "r");
+  if(!fp)
+    return false;
+  pcs = calloc(code_size, sizeof(*pcs));
+  if(!pcs){
+    fclose(fp);
+    return false;
+  }
+  size = code_size;
+  char* line = NULL;
+  size_t len = 0;
+  for(int i=0;i<size && getline(&line, &len, fp) != -1;i++){
+    line[strcspn(line,"\r\n")] = '\0';
+    strncpy(pcs[i].text, line, PROF_TEXT - 1);
+  }
+  free(line);
+  fclose(fp);
+  for(int i=0;i<PROF_WINDOW;i++)
+    inflight[i].cod = -1;
+  cycle = 0;
+  return true;
+}
+
+void prof_free(){
+  free(pcs);
+  pcs = NULL;
+  size = 0;
+}
+
+void prof_clock(int now){
+  cycle = now;
+}
+
+void prof_issued(int cod){   //  ONLY THE FIRST ISSUE COUNTS, A LOAD ISSUES AGAIN FROM THE LSQ AND ON A REPLAY
+  struct InFlight* f = &inflight[cod & (PROF_WINDOW - 1)];
+  if(f->cod == cod)
+    return;
+  f->cod = cod;
+  f->issue_cycle = cycle;
+}
+
+void prof_completed(int cod, int pc){
+  struct InFlight* f = &inflight[cod & (PROF_WINDOW - 1)];
+  struct PcProfile* p = at(pc);
+  if(f->cod != cod || !p)
+    return;
+  p->latency += cycle - f->issue_cycle;
+  p->samples++;
+  f->cod = -1;
+}
+
+void prof_committed(int cod, int pc){   //  STORE AND FENCE LEAVE THE ROB WITHOUT BEING MARKED COMPLETE
+  struct PcProfile* p = at(pc);
+  if(!p)
+    return;
+  prof_completed(cod, pc);
+  p->committed++;
+}
+
+void prof_head_blocked(int pc){
+  struct PcProfile* p = at(pc);
+  if(p)
+    p->head_cycles++;
+}
+
+void prof_mispredicted(int pc){
+  struct PcProfile* p = at(pc);
+  if(p)
+    p->mispredicts++;
+}
+
+void prof_squashed(int pc){
+  struct PcProfile* p = at(pc);
+  if(p)
+    p->squashed++;
+}
+
+static int hotter(const void* a, const void* b){   //  ROB HEAD CYCLES, THEN COMMITS, THEN PROGRAM ORDER
+  const struct PcProfile* x = &pcs[*(const int*)a];
+  const struct PcProfile* y = &pcs[*(const int*)b];
+  if(x->head_cycles != y->head_cycles)
+    return x->head_cycles < y->head_cycles ? 1 : -1;
+  if(x->committed != y->committed)
+    return x->committed < y->committed ? 1 : -1;
+  return *(const int*)a - *(const int*)b;
+}
+
+bool prof_write(const char* path, int cycles){
+  FILE* fp = fopen(path, "w");
+  if(!fp)
+    return false;
+  int* order = malloc(sizeof(int) * (size ? size : 1));
+  if(!order){
+    fclose(fp);
+    return false;
+  }
+  for(int i=0;i<size;i++)
+    order[i] = i;
+  qsort(order, size, sizeof(int), hotter);
+
+  fprintf(fp, "APEX profile, %d cycles\n", cycles);
+  fprintf(fp, "%-6s %9s %9s %9s %7s %9s %9s  %s\n",
+          "PC", "Commits", "Avg lat", "ROB head", "Head%", "Mispred", "Squashed", "Instruction");
+  for(int k=0;k<size;k++){
+    struct PcProfile* p = &pcs[order[k]];
+    if(!p->committed && !p->squashed && !p->head_cycles)
+      continue;
+    fprintf(fp, "%-6d %9lu %9.2f %9lu %6.1f%% %9lu %9lu  %s\n",
+            4000 + 4 * order[k], p->committed,
+            p->samples ? (double)p->latency / p->samples : 0.0,
+            p->head_cycles, cycles ? 100.0 * p->head_cycles / cycles : 0.0,
+            p->mispredicts, p->squashed, p->text);
+  }
+  free(order);
+  fclose(fp);
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef _APEX_PROF_H_
+#define _APEX_PROF_H_
+/**
+ *  prof.h
+ *  Instruction-level profiler, per static PC
+ *
+ *  For every instruction of the program the core counts how often it
+ *  committed, the average cycles from its first issue (IQ, or LSQ for
+ *  what skips the IQ) to completion, the cycles it sat at the ROB head
+ *  without committing, how often it was mispredicted and how often it was
+ *  squashed by a younger-path flush. The report is written at exit, hottest
+ *  PC first by ROB head cycles, with the line of the input file next to it.
+ *
+ *  Dynamic instructions are followed by their cod between issue and
+ *  completion in a small table; an entry overwritten before completion
+ *  just loses its latency sample.
+ */
+#include <stdbool.h>
+
+#define PROF_WINDOW 128             // In-flight instructions followed for latency, power of two
+#define PROF_TEXT 64                // Characters of assembly kept per line
+
+bool prof_init(const char*, int);
+void prof_free();
+void prof_clock(int);
+void prof_issued(int);
+void prof_completed(int, int);
+void prof_committed(int, int);
+void prof_head_blocked(int);
+void prof_mispredicted(int);
+void prof_squashed(int);
+bool prof_write(const char*, int);
+
+#endif
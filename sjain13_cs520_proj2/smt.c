@@ -0,0 +1,292 @@
+/*
+ *  smt.c
+ *  Hardware thread contexts, fetch thread selection and per-thread stats
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "smt.h"
+
+struct SmtThread{
+  const char* program;
+  APEX_Instruction* code_memory;
+  int code_memory_size;
+  int pc;                           // Next fetch PC
+  bool halted;                      // HALT dispatched, nothing more to fetch
+  struct RegisterFile rf;           // Architectural registers, stale while the thread is resident
+  bool latest[32];                  // Rename table, stale while the thread is resident
+  int frontend_pc[SMT_FRONTEND_SLOTS];  // Fetched and not yet dispatched, oldest first
+  int frontend_count;
+  int rewind_pc;                    // Oldest PC of the thread squashed by the current flush, -1 for none
+  unsigned long fetched;
+  unsigned long retired;
+  unsigned long fetch_cycles;       // Cycles the thread owned fetch
+  unsigned long rob_full_cycles;    // Dispatch held back by the thread's ROB share
+};
+
+static const char* fetch_names[SMT_NUM_FETCH_POLICIES] = { "rr", "icount" };
+
+static struct SmtThread thread[SMT_MAX_THREADS];
+static int threads = 1;
+static int rob_share;               // ROB entries a thread may hold when partitioned
+static int last_fetch = -1;         // Thread that fetched last, round robin starts after it
+static int resident = 0;            // Thread whose rf and rename table are in the core
+static int saved_resident = 0;      // Restored by smt_leave
+static int flush_owner = -1;
+static int redirect_tid = -1;       // Thread the next branch redirect belongs to
+
+int smt_parse_fetch(const char* name){   //  -1 FOR AN UNKNOWN FETCH POLICY
+  for(int i=0;i<SMT_NUM_FETCH_POLICIES;i++){
+    if(!strcmp(name,fetch_names[i]))
+      return i;
+  }
+  return -1;
+}
+
+/*
+ * Thread 0 runs the program the core was initialised with, the others the
+ * threadN= program or, without one, another copy of the input file. Every
+ * thread starts from the core's initial architectural state.
+ */
+bool smt_init(APEX_CPU* cpu, const char* filename, int rob_size){
+  threads = sim_config.threads;
+  rob_share = rob_size / threads;
+  memset(thread,0,sizeof(thread));
+  for(int t=0;t<threads;t++){
+    struct SmtThread* th = &thread[t];
+    th->program = sim_config.thread_program[t] ? sim_config.thread_program[t] : filename;
+    if(t == 0){
+      th->code_memory = cpu->code_memory;
+      th->code_memory_size = cpu->code_memory_size;
+    }
+    else{
+      th->code_memory = create_code_memory(th->program, &th->code_memory_size);
+      if(!th->code_memory){
+        fprintf(stderr, "APEX_Error : Unable to load %s for thread %d\n", th->program, t);
+        while(--t > 0)
+          free(thread[t].code_memory);
+        return false;
+      }
+    }
+    th->pc = cpu->pc;
+    th->rewind_pc = -1;
+  }
+  last_fetch = -1;
+  resident = saved_resident = 0;
+  flush_owner = redirect_tid = -1;
+  return true;
+}
+
+void smt_start(struct RegisterFile* rf, bool* latest){   //  EVERY THREAD STARTS FROM THE CORE'S INITIAL REGISTERS
+  for(int t=0;t<threads;t++){
+    thread[t].rf = *rf;
+    memcpy(thread[t].latest,latest,sizeof(thread[t].latest));
+  }
+}
+
+void smt_free(APEX_CPU* cpu){   //  THE CORE FREES THREAD 0'S CODE ITSELF
+  cpu->code_memory = thread[0].code_memory;
+  cpu->code_memory_size = thread[0].code_memory_size;
+  for(int t=1;t<threads;t++){
+    free(thread[t].code_memory);
+    thread[t].code_memory = NULL;
+  }
+}
+
+static bool can_fetch(int t, const int* rob_count){
+  if(thread[t].halted || thread[t].frontend_count + MAX_WIDTH > SMT_FRONTEND_SLOTS)
+    return false;
+  return !sim_config.smt_rob_partition || rob_count[t] < rob_share;
+}
+
+/*
+ * Picks the thread that fetches this cycle and loads its PC and code into
+ * the core. icount holds each thread's IQ/LSQ entries that have not issued,
+ * the instructions still in the frontend are added here. Returns -1 when
+ * no thread can fetch.
+ */
+int smt_fetch_begin(APEX_CPU* cpu, int redirect_pc, const int* icount, const int* rob_count){
+  if(redirect_pc != -1 && redirect_tid != -1)
+    thread[redirect_tid].pc = redirect_pc;
+  redirect_tid = -1;
+
+  int pick = -1;
+  int best = 0;
+  for(int i=1;i<=threads;i++){
+    int t = (last_fetch + i) % threads;
+    if(!can_fetch(t,rob_count))
+      continue;
+    if(sim_config.smt_fetch == SMT_FETCH_RR){
+      pick = t;
+      break;
+    }
+    int count = icount[t] + thread[t].frontend_count;
+    if(pick == -1 || count < best){   //  TIES GO TO THE ROUND ROBIN ORDER
+      pick = t;
+      best = count;
+    }
+  }
+  if(pick == -1)
+    return -1;
+
+  last_fetch = pick;
+  thread[pick].fetch_cycles++;
+  cpu->pc = thread[pick].pc;
+  cpu->code_memory = thread[pick].code_memory;
+  cpu->code_memory_size = thread[pick].code_memory_size;
+  return pick;
+}
+
+void smt_fetch_end(APEX_CPU* cpu, int t){
+  thread[t].pc = cpu->pc;
+}
+
+void smt_fetched(int t, struct Bundle* b){
+  struct SmtThread* th = &thread[t];
+  for(int i=0;i<b->size;i++)
+    th->frontend_pc[th->frontend_count++] = b->slot[i].pc;
+  th->fetched += b->size;
+}
+
+void smt_dispatched(int t, int pc){   //  THE FRONTEND IS IN ORDER, DROP EVERYTHING UP TO pc
+  struct SmtThread* th = &thread[t];
+  int n = 0;
+  while(n < th->frontend_count && th->frontend_pc[n] != pc)
+    n++;
+  if(n == th->frontend_count)
+    return;
+  n++;
+  memmove(th->frontend_pc, th->frontend_pc + n, sizeof(int) * (th->frontend_count - n));
+  th->frontend_count -= n;
+}
+
+bool smt_rob_full(int t, int rob_count){
+  if(!sim_config.smt_rob_partition || rob_count < rob_share)
+    return false;
+  thread[t].rob_full_cycles++;
+  return true;
+}
+
+void smt_halt(int t){
+  thread[t].halted = true;
+}
+
+bool smt_all_halted(){
+  for(int t=0;t<threads;t++){
+    if(!thread[t].halted)
+      return false;
+  }
+  return true;
+}
+
+static void make_resident(int t, struct RegisterFile* rf, bool* latest){
+  if(t == resident)
+    return;
+  thread[resident].rf = *rf;
+  memcpy(thread[resident].latest,latest,sizeof(thread[resident].latest));
+  *rf = thread[t].rf;
+  memcpy(latest,thread[t].latest,sizeof(thread[t].latest));
+  resident = t;
+}
+
+void smt_select(int t, struct RegisterFile* rf, bool* latest){   //  RENAME OF THREAD t FOLLOWS
+  make_resident(t,rf,latest);
+}
+
+void smt_enter(int t, struct RegisterFile* rf, bool* latest){    //  BRIEFLY, AROUND A COMMIT OR A FLUSH
+  saved_resident = resident;
+  make_resident(t,rf,latest);
+}
+
+void smt_leave(struct RegisterFile* rf, bool* latest){
+  make_resident(saved_resident,rf,latest);
+}
+
+/*
+ * A flush drops every instruction younger than the owner, whatever its
+ * thread. The owner restarts from the branch redirect; every other thread
+ * that lost instructions refetches from the oldest one it lost.
+ */
+void smt_flush_begin(int owner){
+  flush_owner = owner;
+  redirect_tid = owner;
+  for(int t=0;t<threads;t++)
+    thread[t].rewind_pc = -1;
+}
+
+void smt_squashed(int t, int pc){   //  CALLED OLDEST FIRST FOR EVERY SQUASHED ROB ENTRY
+  if(thread[t].rewind_pc == -1)
+    thread[t].rewind_pc = pc;
+}
+
+bool smt_flush_end(int t){   //  TRUE WHEN THE THREAD LOST RENAMED INSTRUCTIONS AND ITS MAP NEEDS REPAIR
+  struct SmtThread* th = &thread[t];
+  bool renamed = th->rewind_pc != -1;
+  if(t == flush_owner)
+    th->halted = false;       //  A HALT FETCHED ON THE WRONG PATH WAS SQUASHED WITH IT
+  else{
+    if(renamed){
+      th->pc = th->rewind_pc;
+      th->halted = false;     //  A SQUASHED HALT HAS TO BE FETCHED AGAIN
+    }
+    else if(th->frontend_count)
+      th->pc = th->frontend_pc[0];
+  }
+  th->frontend_count = 0;
+  th->rewind_pc = -1;
+  return renamed && t != flush_owner;
+}
+
+void smt_retired(int t){
+  thread[t].retired++;
+}
+
+void smt_print_registers(struct RegisterFile* rf, bool* latest){
+  thread[resident].rf = *rf;
+  memcpy(thread[resident].latest,latest,sizeof(thread[resident].latest));
+  for(int t=0;t<threads;t++){
+    printf("=====REGISTER VALUE (THREAD %d)============\n",t);
+    for(int i=0;i<16;i++)
+      printf(" | Register[%d] | Value=%d |\n",i,thread[t].rf.R[i].value);
+  }
+}
+
+/*
+ * Fairness is Jain's index over the per-thread IPCs, 1 when every thread
+ * got the same throughput and 1/threads when one thread got all of it.
+ */
+void smt_print_stats(int cycles){
+  double ipc[SMT_MAX_THREADS];
+  double sum = 0, sum_sq = 0, lo = 0, hi = 0;
+  for(int t=0;t<threads;t++){
+    ipc[t] = cycles ? (double)thread[t].retired / cycles : 0;
+    sum += ipc[t];
+    sum_sq += ipc[t] * ipc[t];
+    if(t == 0 || ipc[t] < lo)
+      lo = ipc[t];
+    if(t == 0 || ipc[t] > hi)
+      hi = ipc[t];
+  }
+
+  printf("=======SMT========\n");
+  printf(" | Threads     | %d |\n",threads);
+  printf(" | Fetch       | %s |\n",fetch_names[sim_config.smt_fetch]);
+  if(sim_config.smt_rob_partition)
+    printf(" | ROB         | partitioned, %d per thread |\n",rob_share);
+  else
+    printf(" | ROB         | shared |\n");
+  printf(" | Throughput  | %.3f IPC |\n",sum);
+  printf(" | Fairness    | %.3f |\n",sum_sq > 0 ? sum * sum / (threads * sum_sq) : 1.0);
+  printf(" | Min/Max IPC | %.3f |\n",hi > 0 ? lo / hi : 1.0);
+  for(int t=0;t<threads;t++){
+    printf("=======THREAD %d========\n",t);
+    printf(" | Program     | %s |\n",thread[t].program);
+    printf(" | Fetched     | %lu |\n",thread[t].fetched);
+    printf(" | Retired     | %lu |\n",thread[t].retired);
+    printf(" | IPC         | %.3f |\n",ipc[t]);
+    printf(" | Fetch share | %.1f%% |\n",cycles ? 100.0 * thread[t].fetch_cycles / cycles : 0);
+    printf(" | ROB full    | %lu |\n",thread[t].rob_full_cycles);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _APEX_SMT_H_
+#define _APEX_SMT_H_
+/**
+ *  smt.h
+ *  Simultaneous multithreading on the out-of-order core
+ *
+ *  Every hardware thread has its own PC, code memory, architectural
+ *  register file and rename table. The PRF, IQ, LSQ, ROB, functional units
+ *  and data memory are shared. One thread fetches per cycle, picked round
+ *  robin or by ICOUNT (fewest instructions between fetch and issue). The
+ *  ROB is shared, or partitioned so no thread holds more than its share.
+ *
+ *  The global rf and rename map of the core always belong to one resident
+ *  thread; the others are parked here and swapped in around rename, commit
+ *  and branch recovery.
+ *
+ *  Threads fetch straight from their code memory and the checker models a
+ *  single program, so threads>1 is refused with l1i=1 or checker=1 (see
+ *  config_check).
+ */
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "bundle.h"
+#include "config.h"
+
+#define SMT_FRONTEND_SLOTS 32       // Fetched, not yet dispatched PCs tracked per thread
+
+enum{
+  SMT_FETCH_RR,
+  SMT_FETCH_ICOUNT,
+  SMT_NUM_FETCH_POLICIES
+};
+
+int smt_parse_fetch(const char*);
+bool smt_init(APEX_CPU*, const char*, int);
+void smt_free(APEX_CPU*);
+void smt_start(struct RegisterFile*, bool*);
+int smt_fetch_begin(APEX_CPU*, int, const int*, const int*);
+void smt_fetch_end(APEX_CPU*, int);
+void smt_fetched(int, struct Bundle*);
+void smt_dispatched(int, int);
+bool smt_rob_full(int, int);
+void smt_halt(int);
+bool smt_all_halted();
+void smt_select(int, struct RegisterFile*, bool*);
+void smt_enter(int, struct RegisterFile*, bool*);
+void smt_leave(struct RegisterFile*, bool*);
+void smt_flush_begin(int);
+void smt_squashed(int, int);
+bool smt_flush_end(int);
+void smt_retired(int);
+void smt_print_registers(struct RegisterFile*, bool*);
+void smt_print_stats(int);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ *  storeq.c
+ *  Store queue search, store-to-load forwarding and ordering violation detection
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "storeq.h"
+
+struct StoreEntry{
+  bool valid;
+  int cod;
+  int pc;
+  int address;          // -1 until the INT FU computes it
+  int next;             // Next resolved store in the same bucket, -1 at the end
+};
+
+struct IssuedLoad{
+  bool valid;
+  int cod;
+  int pc;
+  int address;
+  int source;           // cod of the store it forwarded from, -1 for memory
+  bool speculative;     // Issued while an older store address was unknown
+};
+
+static struct StoreEntry stores[STQ_SIZE];
+static int bucket[STQ_BUCKETS];
+static struct IssuedLoad loads[STQ_MAX_LOADS];
+
+static unsigned long forwarded = 0;
+static unsigned long speculative_loads = 0;
+static unsigned long violations = 0;
+
+static int hash(int address){
+  return (unsigned)address % STQ_BUCKETS;
+}
+
+void stq_init(){
+  memset(stores,0,sizeof(stores));
+  memset(loads,0,sizeof(loads));
+  for(int b=0;b<STQ_BUCKETS;b++)
+    bucket[b] = -1;
+  forwarded = speculative_loads = violations = 0;
+}
+
+static void unlink_store(int s){   //  TAKE A RESOLVED STORE OUT OF ITS BUCKET
+  int* link = &bucket[hash(stores[s].address)];
+  while(*link != -1){
+    if(*link == s){
+      *link = stores[s].next;
+      return;
+    }
+    link = &stores[*link].next;
+  }
+}
+
+static void remove_store(int s){
+  if(stores[s].address != -1)
+    unlink_store(s);
+  stores[s].valid = false;
+}
+
+void stq_dispatch_store(int cod, int pc){
+  for(int s=0;s<STQ_SIZE;s++){
+    if(stores[s].valid)
+      continue;
+    stores[s].valid = true;
+    stores[s].cod = cod;
+    stores[s].pc = pc;
+    stores[s].address = -1;
+    stores[s].next = -1;
+    return;
+  }
+}
+
+/*
+ * Records the address of the store with the given cod. Returns the cod of
+ * the oldest younger LOAD that already read this address from somewhere
+ * older than this store (an ordering violation the caller must replay),
+ * -1 when there is none; the LOAD's PC goes to *load_pc.
+ */
+int stq_resolve_store(int cod, int address, int* load_pc){
+  for(int s=0;s<STQ_SIZE;s++){
+    if(!stores[s].valid || stores[s].cod != cod)
+      continue;
+    if(stores[s].address == -1){
+      stores[s].address = address;
+      stores[s].next = bucket[hash(address)];
+      bucket[hash(address)] = s;
+    }
+    break;
+  }
+
+  int victim = -1;
+  for(int l=0;l<STQ_MAX_LOADS;l++){
+    struct IssuedLoad* ld = &loads[l];
+    if(ld->valid && ld->cod > cod && ld->address == address && ld->source < cod
+       && (victim == -1 || ld->cod < loads[victim].cod))
+      victim = l;
+  }
+  if(victim == -1)
+    return -1;
+  violations++;
+  *load_pc = loads[victim].pc;
+  return loads[victim].cod;
+}
+
+bool stq_store_unresolved(int cod){
+  for(int s=0;s<STQ_SIZE;s++){
+    if(stores[s].valid && stores[s].cod == cod)
+      return stores[s].address == -1;
+  }
+  return false;
+}
+
+void stq_retire_store(int cod){   //  STORE HAS WRITTEN MEMORY
+  for(int s=0;s<STQ_SIZE;s++){
+    if(stores[s].valid && stores[s].cod == cod)
+      remove_store(s);
+  }
+}
+
+/*
+ * Looks for the youngest store older than the LOAD with the given cod that
+ * writes address. Returns STQ_FORWARD with its cod in *store_cod, or
+ * STQ_MEMORY. *unresolved is set when an older store has no address yet.
+ */
+int stq_search(int cod, int address, int* store_cod, bool* unresolved){
+  int best = -1;
+  *unresolved = false;
+  for(int s=bucket[hash(address)];s!=-1;s=stores[s].next){
+    if(stores[s].cod < cod && stores[s].address == address && (best == -1 || stores[s].cod > stores[best].cod))
+      best = s;
+  }
+  for(int s=0;s<STQ_SIZE;s++){
+    if(stores[s].valid && stores[s].address == -1 && stores[s].cod < cod)
+      *unresolved = true;
+  }
+  if(best == -1)
+    return STQ_MEMORY;
+  *store_cod = stores[best].cod;
+  return STQ_FORWARD;
+}
+
+void stq_load_issued(int cod, int pc, int address, int source, bool speculative){
+  if(source != -1)
+    forwarded++;
+  if(!speculative)    //  ONLY A LOAD THAT PASSED AN UNKNOWN STORE ADDRESS CAN BE VIOLATED
+    return;
+  speculative_loads++;
+  for(int l=0;l<STQ_MAX_LOADS;l++){
+    if(loads[l].valid)
+      continue;
+    loads[l] = (struct IssuedLoad){ true, cod, pc, address, source, speculative };
+    return;
+  }
+}
+
+void stq_retire_load(int cod){   //  LOAD COMMITTED OR IS BEING REPLAYED
+  for(int l=0;l<STQ_MAX_LOADS;l++){
+    if(loads[l].valid && loads[l].cod == cod)
+      loads[l].valid = false;
+  }
+}
+
+void stq_squash_younger(int cod){
+  for(int s=0;s<STQ_SIZE;s++){
+    if(stores[s].valid && stores[s].cod > cod)
+      remove_store(s);
+  }
+  for(int l=0;l<STQ_MAX_LOADS;l++){
+    if(loads[l].valid && loads[l].cod > cod)
+      loads[l].valid = false;
+  }
+}
+
+void stq_print_stats(){
+  printf("=======STORE QUEUE========\n");
+  printf(" | Forwarded loads   | %lu |\n",forwarded);
+  printf(" | Speculative loads | %lu |\n",speculative_loads);
+  printf(" | Violations        | %lu |\n",violations);
+}
@@ -0,0 +1,38 @@
+#ifndef _APEX_STOREQ_H_
+#define _APEX_STOREQ_H_
+/**
+ *  storeq.h
+ *  Address-indexed view of the stores and issued loads in the LSQ
+ *
+ *  Stores are entered at dispatch and get their address when the INT FU
+ *  computes it; resolved stores are hashed by address so a LOAD finds the
+ *  youngest older store to the same address without walking the LSQ.
+ *  Loads issued past a store with an unknown address are remembered until
+ *  they commit, so that store can detect a younger load that already read
+ *  stale data once its address resolves.
+ */
+#include <stdbool.h>
+
+#define STQ_SIZE 32             // One LSQ worth
+#define STQ_MAX_LOADS 32
+#define STQ_BUCKETS 64
+
+/* Outcome of a store queue search for a LOAD */
+enum
+{
+  STQ_MEMORY,                   // No older store to this address, read memory
+  STQ_FORWARD                   // Youngest older store to this address holds the data
+};
+
+void stq_init();
+void stq_dispatch_store(int, int);
+int stq_resolve_store(int, int, int*);
+bool stq_store_unresolved(int);
+void stq_retire_store(int);
+int stq_search(int, int, int*, bool*);
+void stq_load_issued(int, int, int, int, bool);
+void stq_retire_load(int);
+void stq_squash_younger(int);
+void stq_print_stats();
+
+#endif
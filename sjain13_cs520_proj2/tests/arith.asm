@@ -0,0 +1,18 @@
+MOVC,R1,#3
+MOVC,R2,#7
+MUL,R3,R1,R2
+ADD,R4,R3,R1
+MUL,R5,R4,R4
+SUB,R6,R5,R5
+BZ,#8
+MOVC,R7,#99
+MOVC,R8,#1
+XOR,R9,R8,R2
+OR,R10,R9,R1
+AND,R11,R10,R2
+STORE,R11,R1,#0
+STORE,R10,R1,#1
+LOAD,R12,R1,#1
+LOAD,R13,R1,#0
+SUB,R14,R12,R13
+HALT,
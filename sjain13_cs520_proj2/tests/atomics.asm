@@ -0,0 +1,12 @@
+MOVC,R1,#20
+MOVC,R2,#5
+FADD,R3,R1,R2
+FADD,R4,R1,R2
+ADD,R5,R3,R4
+MOVC,R6,#9
+SWAP,R7,R1,R6
+FENCE,
+LOAD,R8,R1,#0
+ADD,R9,R8,R7
+STORE,R9,R1,#4
+HALT,
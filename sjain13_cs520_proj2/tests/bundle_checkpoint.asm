@@ -0,0 +1,11 @@
+MOVC,R3,#7
+MOVC,R4,#3
+MUL,R1,R3,R4
+MUL,R1,R1,R4
+MUL,R1,R1,R4
+SUB,R5,R4,R4
+BZ,#12
+ADD,R1,R4,R4
+HALT,
+ADD,R6,R1,R0
+HALT,
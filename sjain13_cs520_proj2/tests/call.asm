@@ -0,0 +1,12 @@
+MOVC,R1,#0
+MOVC,R2,#4
+MOVC,R3,#1
+MOVC,R5,#4036
+JAL,R6,R5,#0
+SUB,R2,R2,R3
+BNZ,#-8
+DIV,R7,R1,R3
+HALT,
+ADD,R1,R1,R2
+MUL,R4,R1,R3
+JUMP,R6,#0
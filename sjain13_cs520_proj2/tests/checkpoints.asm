@@ -0,0 +1,32 @@
+MOVC,R1,#0
+MOVC,R2,#5
+DIV,R3,R2,R2
+DIV,R3,R3,R3
+DIV,R3,R3,R3
+DIV,R3,R3,R3
+STORE,R2,R3,#9
+LOAD,R4,R1,#10
+LOAD,R5,R1,#11
+LOAD,R6,R1,#12
+LOAD,R7,R1,#13
+LOAD,R8,R1,#14
+LOAD,R9,R1,#15
+LOAD,R10,R1,#16
+LOAD,R11,R1,#17
+LOAD,R4,R1,#18
+LOAD,R5,R1,#19
+LOAD,R6,R1,#20
+LOAD,R7,R1,#21
+LOAD,R8,R1,#22
+LOAD,R9,R1,#23
+LOAD,R10,R1,#24
+LOAD,R11,R1,#25
+LOAD,R4,R1,#26
+LOAD,R5,R1,#27
+SUB,R12,R2,R2
+BZ,#12
+MOVC,R13,#99
+MOVC,R14,#98
+MOVC,R15,#97
+LOAD,R15,R1,#10
+HALT,
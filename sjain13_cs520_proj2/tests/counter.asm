@@ -0,0 +1,11 @@
+MOVC,R1,#50
+MOVC,R2,#1
+MOVC,R3,#0
+MOVC,R10,#40
+ADD,R3,R3,R1
+LOAD,R4,R10,#0
+ADD,R4,R4,R2
+STORE,R4,R10,#0
+SUB,R1,R1,R2
+BNZ,#-20
+HALT,
@@ -0,0 +1,11 @@
+MOVC,R1,#200
+MOVC,R2,#1
+MOVC,R3,#7
+MOVC,R4,#0
+DIV,R3,R3,R2
+SUB,R4,R2,R4
+BZ,#8
+ADD,R5,R5,R2
+SUB,R1,R1,R2
+BNZ,#-20
+HALT,
@@ -0,0 +1,7 @@
+MOVC,R1,#20
+MOVC,R2,#1
+FADD,R3,R1,R2
+FADD,R3,R1,R2
+FADD,R3,R1,R2
+FENCE,
+HALT,
@@ -0,0 +1,11 @@
+MOVC,R1,#30000
+MOVC,R2,#1
+MOVC,R5,#0
+MOVC,R6,#3000
+ADD,R5,R5,R2
+SUB,R6,R6,R2
+BNZ,#-8
+SUB,R1,R1,R2
+BNZ,#-20
+STORE,R5,R2,#10
+HALT,
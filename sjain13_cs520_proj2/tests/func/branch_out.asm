@@ -0,0 +1,4 @@
+MOVC,R1,#0
+ADD,R1,R1,R1
+BZ,#400
+HALT,
@@ -0,0 +1,4 @@
+MOVC,R1,#7
+MOVC,R2,#0
+DIV,R3,R1,R2
+HALT,
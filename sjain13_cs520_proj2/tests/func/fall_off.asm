@@ -0,0 +1,2 @@
+MOVC,R1,#7
+ADD,R1,R1,R1
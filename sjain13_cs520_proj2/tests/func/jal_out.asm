@@ -0,0 +1,7 @@
+MOVC,R1,#4000
+MOVC,R2,#0
+JAL,R3,R1,#12
+ADD,R4,R4,R4
+HALT,
+ADD,R3,R3,R2
+JUMP,R3,#0
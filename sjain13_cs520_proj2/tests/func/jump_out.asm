@@ -0,0 +1,2 @@
+MOVC,R1,#3
+JUMP,R1,#0
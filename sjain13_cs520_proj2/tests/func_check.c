@@ -0,0 +1,117 @@
+/*
+ *  func_check.c
+ *  Checks func_run against func_step on the given programs
+ *
+ *  Each program is run to the end with func_step, then again with func_run
+ *  retiring 1, 3, 7 and an unbounded number of instructions per call. The
+ *  retired count, PC, zero flag, halt/fault state, registers and data
+ *  memory must all agree. With -bench only the unbounded func_run is
+ *  checked, and both engines' rates are printed in MIPS.
+ *
+ *  Usage: func_check [-bench] <input_file> ...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../functional.h"
+
+#define MAX_STEPS 1000000000UL   // Stops a program that never halts
+
+static const unsigned long chunks[] = {1, 3, 7, MAX_STEPS};
+#define CHUNKS (int)(sizeof(chunks) / sizeof(chunks[0]))
+
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long run_step(struct FuncState* st){
+  struct FuncRetire r;
+  unsigned long n = 0;
+  while(n < MAX_STEPS && func_step(st, &r))
+    n++;
+  return n;
+}
+
+static unsigned long run_fast(struct FuncState* st, unsigned long chunk){
+  unsigned long n = 0, k;
+  while(n < MAX_STEPS && (k = func_run(st, chunk < MAX_STEPS - n ? chunk : MAX_STEPS - n)))
+    n += k;
+  return n;
+}
+
+static bool same_memory(struct DataMemory* a, struct DataMemory* b){
+  for(int p=0;p<DM_NUM_PAGES;p++){
+    if(!a->page[p] && !b->page[p])
+      continue;
+    for(int w=p*DM_PAGE_WORDS;w<(p+1)*DM_PAGE_WORDS;w++)
+      if(dm_read(a, w) != dm_read(b, w))
+        return false;
+  }
+  return true;
+}
+
+static bool same_state(struct FuncState* a, struct FuncState* b){
+  return a->retired == b->retired && a->pc == b->pc && a->zero == b->zero &&
+    a->halted == b->halted && a->fault == b->fault &&
+    !memcmp(a->regs, b->regs, sizeof(a->regs)) && same_memory(&a->data_memory, &b->data_memory);
+}
+
+/* Returns false on a mismatch or a program that cannot be loaded */
+static bool check(const char* filename, bool bench){
+  int size;
+  APEX_Instruction* code = create_code_memory(filename, &size);
+  struct FuncState ref, fast;
+  bool ok = true;
+
+  if(!code || !func_init(&ref, code, size)){
+    fprintf(stderr, "APEX_Error : Unable to load %s\n", filename);
+    free(code);
+    return false;
+  }
+  double t = now();
+  unsigned long steps = run_step(&ref);
+  double step_time = now() - t;
+
+  for(int c=bench ? CHUNKS - 1 : 0;c<CHUNKS;c++){
+    if(!func_init(&fast, code, size)){
+      ok = false;
+      break;
+    }
+    t = now();
+    unsigned long runs = run_fast(&fast, chunks[c]);
+    double run_time = now() - t;
+    if(bench)
+      printf("%s : %lu instructions, func_step %.0f MIPS, func_run %.0f MIPS\n", filename, steps,
+        step_time > 0 ? steps / step_time / 1e6 : 0, run_time > 0 ? runs / run_time / 1e6 : 0);
+    if(runs != steps || !same_state(&ref, &fast)){
+      printf("FAIL %s : func_run(%lu) differs from func_step after %lu instructions\n", filename, chunks[c], steps);
+      ok = false;
+    }
+    func_free(&fast);
+  }
+  if(ok && !bench)
+    printf("OK   %s : %lu instructions, pc %d%s\n", filename, steps, ref.pc,
+      ref.fault ? ", fault" : ref.halted ? ", halted" : "");
+  func_free(&ref);
+  free(code);
+  return ok;
+}
+
+int main(int argc, char const* argv[]){
+  bool bench = argc > 1 && !strcmp(argv[1], "-bench");
+  int first = bench ? 2 : 1;
+  int failed = 0;
+
+  if(argc <= first){
+    fprintf(stderr, "APEX_Help : Usage %s [-bench] <input_file> ...\n", argv[0]);
+    return 1;
+  }
+  for(int i=first;i<argc;i++)
+    if(!check(argv[i], bench))
+      failed++;
+  return failed != 0;
+}
@@ -0,0 +1,6 @@
+MOVC,R1,#5
+MOVC,R2,#0
+LOAD,R4,R2,#8
+STORE,R1,R2,#12
+LOAD,R5,R2,#16
+HALT,
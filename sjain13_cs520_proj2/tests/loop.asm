@@ -0,0 +1,15 @@
+MOVC,R1,#5
+MOVC,R2,#1
+MOVC,R3,#0
+ADD,R3,R3,R1
+SUB,R1,R1,R2
+BNZ,#-8
+STORE,R3,R2,#10
+LOAD,R4,R2,#10
+ADD,R5,R4,R4
+MUL,R6,R5,R4
+ADD,R7,R6,R5
+STORE,R7,R4,#1
+LOAD,R8,R4,#1
+LOAD,R9,R8,#-300
+HALT,
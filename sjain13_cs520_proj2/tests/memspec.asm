@@ -0,0 +1,11 @@
+MOVC,R1,#30
+MOVC,R2,#3
+MOVC,R5,#0
+DIV,R3,R1,R2
+MUL,R3,R3,R2
+STORE,R2,R3,#0
+LOAD,R4,R5,#30
+ADD,R6,R4,R2
+STORE,R6,R5,#31
+LOAD,R7,R5,#31
+HALT,
@@ -0,0 +1,15 @@
+MOVC,R1,#6
+MOVC,R2,#1
+MOVC,R5,#4032
+MOVC,R3,#0
+JAL,R6,R5,#0
+SUB,R1,R1,R2
+BNZ,#-8
+HALT,
+SUB,R3,R2,R3
+BZ,#8
+ADD,R4,R4,R2
+ADD,R7,R3,R2
+BNZ,#8
+ADD,R4,R4,R4
+JUMP,R6,#0
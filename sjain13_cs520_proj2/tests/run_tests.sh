@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+#  run_tests.sh
+#  Runs every case in tests/cases and compares the simulator's stdout with
+#  its golden output. Run from the directory holding apex_sim, make test
+#  does. UPDATE=1 rewrites the golden outputs instead of comparing.
+#
+cd "$(dirname "$0")" || exit 1
+sim=../apex_sim
+pass=0
+fail=0
+
+while read -r name program cycles options; do
+  case "$name" in
+    ""|\#*) continue ;;
+  esac
+  out=$(mktemp)
+  # shellcheck disable=SC2086
+  $sim "$program" simulate "$cycles" $options > "$out" 2>/dev/null
+  if [ "$UPDATE" = "1" ]; then
+    mv "$out" "expected/$name.out"
+    echo "UPDATED $name"
+    continue
+  fi
+  if cmp -s "$out" "expected/$name.out"; then
+    pass=$((pass + 1))
+  else
+    fail=$((fail + 1))
+    echo "FAIL $name"
+    diff "expected/$name.out" "$out" | head -20
+  fi
+  rm -f "$out"
+done < cases
+
+[ "$UPDATE" = "1" ] && exit 0
+echo "$pass passed, $fail failed"
+[ "$fail" -eq 0 ]
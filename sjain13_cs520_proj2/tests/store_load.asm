@@ -0,0 +1,6 @@
+MOVC,R1,#7
+MOVC,R2,#0
+STORE,R1,R2,#8
+LOAD,R3,R2,#12
+STORE,R3,R2,#16
+HALT,